@@ -0,0 +1,16 @@
+; r1 = a + b (mod 256) by counting b down to zero, one increment per step
+;
+;   ./cpu_host asm addition.asm addition.bin
+
+        in    r1            ; a
+        in    r2            ; b
+loop:
+        cmp   r2
+        jz    done
+        set   1
+        add   r1, r0        ; r1 += 1
+        set   1
+        sub   r2, r0        ; r2 -= 1
+        jmp   loop
+done:
+        out   r1
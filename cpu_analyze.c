@@ -0,0 +1,371 @@
+#include "cpu_analyze.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TARGET_NONE     (-1)
+#define TARGET_SEVERAL  (-2)
+
+// abstract value of the registers and ZF on entry to an instruction
+typedef struct abstract_state{
+    uint8_t known;
+    uint8_t reg[4];
+    uint8_t zf;
+} stAbstract_state;
+
+static void abstract_set(stAbstract_state *state, int r, uint8_t value, bool known) {
+    state->reg[r] = value;
+    state->known = known ? (state->known | (1 << r)) : (state->known & ~(1 << r));
+}
+
+static void abstract_zf(stAbstract_state *state, int r) {
+    if (state->known & (1 << r)) {
+        state->zf = (state->reg[r] == 0);
+        state->known |= ANALYZE_KNOWN_ZF;
+    }
+    else {
+        state->known &= ~ANALYZE_KNOWN_ZF;
+    }
+}
+
+// Merge a state into the entry of pc, return true if the entry changed
+static bool analyze_join(stCpu_analysis *analysis, int pc, const stAbstract_state *in) {
+    if (!analysis->reachable[pc]) {
+        analysis->reachable[pc] = true;
+        analysis->known[pc] = in->known;
+        memcpy(analysis->reg[pc], in->reg, 4);
+        analysis->zf[pc] = in->zf;
+        return true;
+    }
+    uint8_t known = analysis->known[pc] & in->known;
+    for (int r = 0; r < 4; r++) {
+        if (analysis->reg[pc][r] != in->reg[r]) {
+            known &= ~(1 << r);
+        }
+    }
+    if (analysis->zf[pc] != in->zf) {
+        known &= ~ANALYZE_KNOWN_ZF;
+    }
+    if (known == analysis->known[pc]) {
+        return false;
+    }
+    analysis->known[pc] = known;
+    return true;
+}
+
+static void analyze_target(stCpu_analysis *analysis, int pc, int target) {
+    if (analysis->target[pc] == TARGET_NONE) {
+        analysis->target[pc] = (int16_t)target;
+    }
+    else if (analysis->target[pc] != target) {
+        analysis->target[pc] = TARGET_SEVERAL;
+    }
+}
+
+void cpu_analyze(const stCpu_state *cpu, stCpu_analysis *analysis) {
+    const uint8_t *memory = cpu->memory;
+    bool (*edge)[MEM_SIZE] = calloc(MEM_SIZE, sizeof(*edge));
+    int queue[MEM_SIZE];
+    bool queued[MEM_SIZE] = { false };
+    int head = 0, count = 0;
+
+    memset(analysis, 0, sizeof(*analysis));
+    for (int pc = 0; pc < MEM_SIZE; pc++) {
+        analysis->target[pc] = TARGET_NONE;
+        analysis->store[pc] = TARGET_NONE;
+    }
+    for (int pc = ROM_SIZE - 1; pc >= 0; pc--) {
+        if (memory[pc] != 0) {
+            analysis->length = (size_t)pc + 1;
+            break;
+        }
+    }
+    if (edge == NULL) {
+        return;
+    }
+
+    // reset state: everything zero
+    stAbstract_state reset = { 0x0F | ANALYZE_KNOWN_ZF, { 0, 0, 0, 0 }, 0 };
+    analyze_join(analysis, 0, &reset);
+    queue[0] = 0;
+    queued[0] = true;
+    count = 1;
+
+    while (count > 0) {
+        int pc = queue[head];
+        head = (head + 1) % MEM_SIZE;
+        count--;
+        queued[pc] = false;
+        if (pc >= ROM_SIZE) {
+            analysis->runs_ram = true;
+            continue;
+        }
+
+        uint8_t instruction = memory[pc];
+        int H = (instruction >> 2) & 0x03;
+        int L = instruction & 0x03;
+        int next = (pc + 1) & 0xFF;
+        int successor[2];
+        int successors = 0;
+        stAbstract_state state;
+        state.known = analysis->known[pc];
+        memcpy(state.reg, analysis->reg[pc], 4);
+        state.zf = analysis->zf[pc];
+        bool known_H = (state.known >> H) & 1;
+        bool known_L = (state.known >> L) & 1;
+
+        switch (instruction >> 4) {
+        case mem_to_r0_1:
+        case mem_to_r0_2: {
+            bool ram = (instruction & 0x04) != 0;
+            if (known_L && (ram ? state.reg[L] < ROM_SIZE : state.reg[L] >= ROM_SIZE)) {
+                analysis->faults[pc] = true;
+                break;
+            }
+            // the ROM is never written, a known ROM address reads a constant
+            if (known_L && !ram) abstract_set(&state, 0, memory[state.reg[L]], true);
+            else abstract_set(&state, 0, 0, false);
+            abstract_zf(&state, 0);
+            successor[successors++] = next;
+            break;
+        }
+        case r0_to_ram_1:
+        case r0_to_ram_2:
+            if (!known_L) {
+                analysis->store[pc] = TARGET_SEVERAL;
+            }
+            else if (analysis->store[pc] == TARGET_NONE) {
+                analysis->store[pc] = (int16_t)(state.reg[L] % 128 + 0x80);
+            }
+            else if (analysis->store[pc] != state.reg[L] % 128 + 0x80) {
+                analysis->store[pc] = TARGET_SEVERAL;
+            }
+            abstract_zf(&state, 0);
+            successor[successors++] = next;
+            break;
+        case rx_to_ry:
+            abstract_set(&state, L, state.reg[H], known_H);
+            abstract_zf(&state, L);
+            successor[successors++] = next;
+            break;
+        case set_value_r0:
+            abstract_set(&state, 0, instruction & 0x0F, true);
+            abstract_zf(&state, 0);
+            successor[successors++] = next;
+            break;
+        case add_ry_to_rx:
+        case substract_ry_by_rx:
+            if (known_H && known_L) {
+                bool add = (instruction >> 4) == add_ry_to_rx;
+                int result = add ? state.reg[H] + state.reg[L] : state.reg[H] - state.reg[L];
+                abstract_set(&state, H, (uint8_t)result, true);
+                if (result >= 0 && result <= 0xFF) {
+                    abstract_zf(&state, H);     // overflow leaves ZF alone
+                }
+            }
+            else {
+                abstract_set(&state, H, 0, false);
+                state.known &= ~ANALYZE_KNOWN_ZF;
+            }
+            successor[successors++] = next;
+            break;
+        case shift_left:
+            abstract_set(&state, H, (uint8_t)(state.reg[H] << 4), known_H);
+            successor[successors++] = next;
+            break;
+        case shift_right:
+            abstract_set(&state, H, state.reg[H] >> 4, known_H);
+            successor[successors++] = next;
+            break;
+        case compare_rx_with_zero_1:
+        case compare_rx_with_zero_2:
+            abstract_zf(&state, H);
+            successor[successors++] = next;
+            break;
+        case output_external:
+            break;
+        case input_external:
+            abstract_set(&state, H, 0, false);
+            successor[successors++] = next;
+            break;
+        case condition_jump:
+        case uncondition_jump: {
+            bool conditional = (instruction >> 4) == condition_jump;
+            bool zf_known = (state.known & ANALYZE_KNOWN_ZF) != 0;
+            bool jumps = !conditional || !zf_known || state.zf;
+            bool falls = conditional && (!zf_known || !state.zf);
+            if (falls) {
+                analysis->falls[pc] = true;
+                successor[successors++] = next;
+            }
+            if (jumps) {
+                analysis->taken[pc] = true;
+                if (known_H) {
+                    analyze_target(analysis, pc, state.reg[H]);
+                    successor[successors++] = state.reg[H];
+                }
+                else {
+                    analysis->unresolved[pc] = true;
+                }
+            }
+            break;
+        }
+        }
+
+        for (int i = 0; i < successors; i++) {
+            int to = successor[i];
+            edge[pc][to] = true;
+            if (analyze_join(analysis, to, &state) && !queued[to]) {
+                queue[(head + count) % MEM_SIZE] = to;
+                queued[to] = true;
+                count++;
+            }
+        }
+    }
+
+    // natural loops: an edge to an instruction on the depth-first stack
+    // closes a loop, whose body is what reaches the edge's source without
+    // going through the header
+    enum { NEW, ON_STACK, DONE };
+    uint8_t visit[MEM_SIZE] = { 0 };
+    int stack[MEM_SIZE], next_edge[MEM_SIZE];
+    bool (*back)[MEM_SIZE] = calloc(MEM_SIZE, sizeof(*back));
+    int top = 0;
+    if (back == NULL) {
+        free(edge);
+        return;
+    }
+    stack[0] = 0;
+    next_edge[0] = 0;
+    visit[0] = ON_STACK;
+    while (top >= 0) {
+        int u = stack[top];
+        if (next_edge[top] == MEM_SIZE) {
+            visit[u] = DONE;
+            top--;
+            continue;
+        }
+        int v = next_edge[top]++;
+        if (!edge[u][v]) continue;
+        if (visit[v] == ON_STACK) {
+            back[v][u] = true;
+        }
+        else if (visit[v] == NEW) {
+            visit[v] = ON_STACK;
+            stack[++top] = v;
+            next_edge[top] = 0;
+        }
+    }
+    for (int h = 0; h < MEM_SIZE; h++) {
+        bool body[MEM_SIZE] = { false };
+        int work[MEM_SIZE], n = 0;
+        body[h] = true;
+        for (int t = 0; t < MEM_SIZE; t++) {
+            if (back[h][t] && !body[t]) {
+                body[t] = true;
+                work[n++] = t;
+            }
+        }
+        if (n == 0 && !back[h][h]) continue;
+        while (n > 0) {
+            int v = work[--n];
+            for (int u = 0; u < MEM_SIZE; u++) {
+                if (edge[u][v] && !body[u]) {
+                    body[u] = true;
+                    work[n++] = u;
+                }
+            }
+        }
+        analysis->loop_header[h] = true;
+        analysis->loops++;
+        for (int pc = 0; pc < MEM_SIZE; pc++) {
+            analysis->loop_depth[pc] += body[pc];
+            analysis->loop_size[h] += body[pc];
+        }
+    }
+    free(back);
+    free(edge);
+}
+
+static const char *const gOpcode_names[16] = {
+    "mem_to_r0", "mem_to_r0", "r0_to_ram", "r0_to_ram",
+    "rx_to_ry", "set_value_r0", "add_ry_to_rx", "substract_ry_by_rx",
+    "shift_left", "shift_right", "compare_rx_with_zero", "compare_rx_with_zero",
+    "output_external", "input_external", "condition_jump", "uncondition_jump",
+};
+
+int cpu_analysis_write(const stCpu_analysis *analysis, const stCpu_state *cpu, FILE *f) {
+    const uint8_t *memory = cpu->memory;
+    int reachable = 0;
+
+    for (size_t pc = 0; pc < analysis->length; pc++) {
+        reachable += analysis->reachable[pc];
+    }
+    fprintf(f, "reachable: %d of %zu ROM bytes%s\n", reachable, analysis->length,
+            analysis->runs_ram ? ", some path runs into RAM" : "");
+
+    fprintf(f, "jumps:\n");
+    for (int pc = 0; pc < ROM_SIZE; pc++) {
+        uint8_t opcode = memory[pc] >> 4;
+        if (!analysis->reachable[pc] || (opcode != condition_jump && opcode != uncondition_jump)) {
+            continue;
+        }
+        fprintf(f, "  0x%02X %s r%d", pc, gOpcode_names[opcode], (memory[pc] >> 2) & 0x03);
+        if (analysis->target[pc] >= 0) fprintf(f, " -> 0x%02X", analysis->target[pc]);
+        else if (analysis->target[pc] == TARGET_SEVERAL) fprintf(f, " -> several targets");
+        if (analysis->unresolved[pc]) fprintf(f, " (unresolved)");
+        if (opcode == condition_jump) {
+            if (!analysis->taken[pc]) fprintf(f, " (never taken)");
+            if (!analysis->falls[pc]) fprintf(f, " (always taken)");
+        }
+        fprintf(f, "\n");
+    }
+
+    fprintf(f, "loops: %u\n", analysis->loops);
+    for (int pc = 0; pc < MEM_SIZE; pc++) {
+        if (!analysis->loop_header[pc]) continue;
+        fprintf(f, "  header 0x%02X: %u instructions, depth %u\n",
+                pc, analysis->loop_size[pc], analysis->loop_depth[pc]);
+    }
+
+    // an unresolved jump, or a path through RAM, may reach any byte: the
+    // ranges below are only those no resolved path executes
+    int unresolved = 0;
+    for (int pc = 0; pc < ROM_SIZE; pc++) {
+        unresolved += analysis->reachable[pc] && analysis->unresolved[pc];
+    }
+    if (unresolved != 0 || analysis->runs_ram) {
+        fprintf(f, "dead code: unknown (%d unresolved jumps%s), not reached by resolved paths:\n",
+                unresolved, analysis->runs_ram ? ", a path runs into RAM" : "");
+    }
+    else {
+        fprintf(f, "dead code:\n");
+    }
+    for (size_t pc = 0; pc < analysis->length; pc++) {
+        if (analysis->reachable[pc]) continue;
+        size_t end = pc;
+        bool zero = true;
+        while (end < analysis->length && !analysis->reachable[end]) {
+            zero &= (memory[end] == 0);
+            end++;
+        }
+        fprintf(f, "  0x%02zX-0x%02zX (%zu bytes%s)\n", pc, end - 1, end - pc, zero ? ", zero padding" : "");
+        pc = end;
+    }
+
+    fprintf(f, "stores (r0_to_ram masks into RAM, none can hit the ROM):\n");
+    for (int pc = 0; pc < ROM_SIZE; pc++) {
+        if (!analysis->reachable[pc]
+            || ((memory[pc] >> 4) != r0_to_ram_1 && (memory[pc] >> 4) != r0_to_ram_2)) {
+            continue;
+        }
+        if (analysis->store[pc] >= 0) fprintf(f, "  0x%02X -> RAM[0x%02X]\n", pc, analysis->store[pc]);
+        else fprintf(f, "  0x%02X -> RAM[r%d %% 128 + 0x80]\n", pc, memory[pc] & 0x03);
+    }
+    for (int pc = 0; pc < ROM_SIZE; pc++) {
+        if (analysis->faults[pc]) {
+            fprintf(f, "read fault: 0x%02X always halts with a %s read fault\n", pc,
+                    (memory[pc] & 0x04) ? "RAM" : "ROM");
+        }
+    }
+    return ferror(f) ? -1 : 0;
+}
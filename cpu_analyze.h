@@ -0,0 +1,46 @@
+#ifndef CPU_ANALYZE_H
+#define CPU_ANALYZE_H
+
+#include <stdio.h>
+#include "cpu_core.h"
+
+// Static analyzer of a ROM image. Starting from the reset state (PC 0, r0-r3
+// = 0, ZF = 0), constants are propagated through r0-r3 and ZF over every
+// path: inputs and RAM reads are unknown, ROM reads at a known address are
+// constants. That resolves the register-indirect targets of condition_jump
+// and uncondition_jump, which gives the control-flow graph, its natural
+// loops, the ROM bytes no path executes, and the RAM address every store
+// can write. r0_to_ram masks its address into 0x80..0xFF, so no store can
+// hit the ROM; the analyzer reports the RAM targets.
+//
+// A path stops at output_external, at a read fault, at a jump whose target
+// is not a constant (reported as unresolved) and when it reaches RAM, whose
+// contents are not known statically.
+
+#define ANALYZE_KNOWN_ZF    (0x10)      // bits 0..3: r0..r3 are constants
+
+typedef struct cpu_analysis{
+    bool reachable[MEM_SIZE];
+    uint8_t known[MEM_SIZE];            // constant registers / ZF at entry
+    uint8_t reg[MEM_SIZE][4];           // their values
+    uint8_t zf[MEM_SIZE];
+    int16_t target[MEM_SIZE];           // constant jump target, -1 none, -2 several
+    bool unresolved[MEM_SIZE];          // jump through a non-constant register
+    bool taken[MEM_SIZE];               // condition_jump may jump
+    bool falls[MEM_SIZE];               // condition_jump may fall through
+    bool faults[MEM_SIZE];              // mem_to_r0 always faults
+    int16_t store[MEM_SIZE];            // r0_to_ram: RAM address, -2 if it varies
+    uint16_t loop_depth[MEM_SIZE];      // loops the instruction is in
+    bool loop_header[MEM_SIZE];
+    uint16_t loop_size[MEM_SIZE];       // instructions of the loop of a header
+    uint16_t loops;
+    bool runs_ram;                      // some path reaches PC >= ROM_SIZE
+    size_t length;                      // up to the last non-zero ROM byte
+} stCpu_analysis;
+
+// Analyze memory[0..ROM_SIZE) of cpu (usually right after load_program)
+void cpu_analyze(const stCpu_state *cpu, stCpu_analysis *analysis);
+// Print the loops, the unresolved jumps, the dead code and the stores
+int cpu_analysis_write(const stCpu_analysis *analysis, const stCpu_state *cpu, FILE *f);
+
+#endif // CPU_ANALYZE_H
@@ -0,0 +1,933 @@
+#include "cpu_asm.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    ITEM_INSN,              // one instruction byte
+    ITEM_LI,                // r0 = constant or label address
+    ITEM_BYTE,              // .byte
+    ITEM_LABEL,
+};
+
+#define NO_SYMBOL       (-1)
+#define LIVE_ZF         (0x10)      // bits 0..3 are r0..r3
+#define LIVE_ALL        (0x1F)
+#define MAX_SEGMENTS    (ASM_MAX_LABELS + 1)
+#define PERMUTE_MAX     (8)         // all block orders are tried up to this many
+
+typedef struct asm_item{
+    uint8_t kind;
+    uint8_t byte;           // instruction or data byte
+    uint8_t value;          // constant of li
+    int16_t symbol;         // label of li (NO_SYMBOL = constant) or of ITEM_LABEL
+    int line;
+} stAsm_item;
+
+// A segment starts at a label (or at the first item) and runs to the next
+// label; it either ends with a jump/output/data ("breaks") or falls
+// through into the next segment.
+typedef struct asm_segment{
+    int begin, end;         // items
+    bool breaks;
+    int weight;             // 10 ^ loop depth
+    uint8_t live_in;
+    bool targeted;          // some li loads its address
+} stAsm_segment;
+
+typedef struct asm_layout{
+    int order[MAX_SEGMENTS];
+    uint8_t size[ASM_MAX_ITEMS];        // size of every li
+    uint8_t fix_size[MAX_SEGMENTS];     // li of the jump appended to a segment
+    bool fixup[MAX_SEGMENTS];
+    uint8_t entry_size;                 // li of the jump at address 0
+    bool entry;
+    int address[MAX_SEGMENTS];
+    int length;
+    long cost;
+} stAsm_layout;
+
+typedef struct asm_ctx{
+    stAsm_item item[ASM_MAX_ITEMS];
+    int items;
+    char label[ASM_MAX_LABELS][32];
+    int label_line[ASM_MAX_LABELS];
+    bool defined[ASM_MAX_LABELS];
+    int labels;
+    int scratch;                        // register li may clobber, -1 = none
+    stAsm_segment segment[MAX_SEGMENTS];
+    int segments;
+    int label_segment[ASM_MAX_LABELS];
+    int target[ASM_MAX_ITEMS];          // segment a jz/jmp goes to, -1 = unknown
+    char *error;
+    size_t error_size;
+} stAsm;
+
+static int asm_error(stAsm *ctx, int line, const char *format, ...) {
+    if (ctx->error != NULL && ctx->error_size != 0) {
+        char message[128];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+        if (line > 0) {
+            snprintf(ctx->error, ctx->error_size, "line %d: %s", line, message);
+        }
+        else {
+            snprintf(ctx->error, ctx->error_size, "%s", message);
+        }
+    }
+    return -1;
+}
+
+//---------------------------
+// Instruction effects
+
+// registers and ZF read / definitely written by an instruction
+static void insn_effects(uint8_t insn, uint8_t *use, uint8_t *def) {
+    uint8_t H = 1 << ((insn >> 2) & 0x03);
+    uint8_t L = 1 << (insn & 0x03);
+    switch (insn >> 4) {
+    case mem_to_r0_1: case mem_to_r0_2:
+        *use = L; *def = 0x01 | LIVE_ZF; break;
+    case r0_to_ram_1: case r0_to_ram_2:
+        *use = L | 0x01; *def = LIVE_ZF; break;
+    case rx_to_ry:
+        *use = H; *def = L | LIVE_ZF; break;
+    case set_value_r0:
+        *use = 0; *def = 0x01 | LIVE_ZF; break;
+    case add_ry_to_rx: case substract_ry_by_rx:
+        *use = H | L; *def = H; break;          // ZF only without overflow
+    case shift_left: case shift_right:
+        *use = H; *def = H; break;
+    case compare_rx_with_zero_1: case compare_rx_with_zero_2:
+        *use = H; *def = LIVE_ZF; break;
+    case output_external:
+        *use = H; *def = 0; break;
+    case input_external:
+        *use = 0; *def = H; break;
+    case condition_jump:
+        *use = H | LIVE_ZF; *def = 0; break;
+    default:    // uncondition_jump
+        *use = H; *def = 0; break;
+    }
+}
+
+static bool insn_may_set_zf(uint8_t insn) {
+    uint8_t opcode = insn >> 4;
+    return opcode <= set_value_r0 || opcode == add_ry_to_rx || opcode == substract_ry_by_rx
+           || opcode == compare_rx_with_zero_1 || opcode == compare_rx_with_zero_2;
+}
+
+// instructions li needs for the value: 1, 2, 5 (scratch) or -1
+static int li_need(const stAsm *ctx, int value) {
+    if (value < 16) return 1;
+    if ((value & 0x0F) == 0) return 2;
+    return (ctx->scratch >= 0) ? 5 : -1;
+}
+
+// true when the li can take the five-instruction form that overwrites the
+// scratch register: a value that needs it, or a label not yet placed
+static bool li_clobbers_scratch(const stAsm *ctx, const stAsm_item *item) {
+    return ctx->scratch >= 0 && (item->symbol != NO_SYMBOL || li_need(ctx, item->value) == 5);
+}
+
+// r0 = value in exactly "size" instructions; ZF ends as (value == 0)
+static void li_expand(const stAsm *ctx, int value, int size, uint8_t *out) {
+    int n = 0;
+    if (value < 16) {
+        out[n++] = 0x50 | value;
+    }
+    else if ((value & 0x0F) == 0) {
+        out[n++] = 0x50 | (value >> 4);
+        out[n++] = 0x80;                            // shl r0
+    }
+    else {
+        out[n++] = 0x50 | (value & 0x0F);
+        out[n++] = 0x40 | ctx->scratch;             // mov r0, scratch
+        out[n++] = 0x50 | (value >> 4);
+        out[n++] = 0x80;
+        out[n++] = 0x60 | ctx->scratch;             // add r0, scratch
+    }
+    while (n < size) {
+        out[n++] = 0x40;                            // mov r0, r0
+    }
+}
+
+//---------------------------
+// Parser
+
+static int asm_symbol(stAsm *ctx, const char *name, int line) {
+    for (int i = 0; i < ctx->labels; i++) {
+        if (strcmp(ctx->label[i], name) == 0) {
+            return i;
+        }
+    }
+    if (ctx->labels == ASM_MAX_LABELS) {
+        return asm_error(ctx, line, "too many labels");
+    }
+    if (strlen(name) >= sizeof(ctx->label[0])) {
+        return asm_error(ctx, line, "label %s is too long", name);
+    }
+    strcpy(ctx->label[ctx->labels], name);
+    ctx->label_line[ctx->labels] = line;
+    ctx->defined[ctx->labels] = false;
+    return ctx->labels++;
+}
+
+static int asm_add(stAsm *ctx, uint8_t kind, uint8_t byte, int symbol, int line) {
+    if (ctx->items == ASM_MAX_ITEMS) {
+        return asm_error(ctx, line, "program too long");
+    }
+    stAsm_item *item = &ctx->item[ctx->items++];
+    item->kind = kind;
+    item->byte = (kind == ITEM_LI) ? 0 : byte;
+    item->value = (kind == ITEM_LI) ? byte : 0;
+    item->symbol = (int16_t)symbol;
+    item->line = line;
+    return 0;
+}
+
+static int parse_register(const char *token) {
+    if (token != NULL && (token[0] == 'r' || token[0] == 'R')
+        && token[1] >= '0' && token[1] <= '3' && token[2] == '\0') {
+        return token[1] - '0';
+    }
+    return -1;
+}
+
+static bool parse_number(const char *token, int max, int *value) {
+    char *end;
+    if (token == NULL || !isdigit((unsigned char)token[0])) {
+        return false;
+    }
+    long n = strtol(token, &end, 0);
+    if (*end != '\0' || n < 0 || n > max) {
+        return false;
+    }
+    *value = (int)n;
+    return true;
+}
+
+static bool is_name(const char *token) {
+    if (token == NULL || !(isalpha((unsigned char)token[0]) || token[0] == '_')) {
+        return false;
+    }
+    for (const char *c = token; *c != '\0'; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '_' && *c != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// "jz label": put "li label" in front of the instruction that sets ZF
+static int asm_hoist_li(stAsm *ctx, int symbol, int line) {
+    for (int i = ctx->items - 1; i >= 0; i--) {
+        stAsm_item *item = &ctx->item[i];
+        uint8_t use, def;
+        if (item->kind != ITEM_INSN) {
+            break;
+        }
+        insn_effects(item->byte, &use, &def);
+        uint8_t clobbered = 0x01 | ((ctx->scratch >= 0) ? 1 << ctx->scratch : 0);
+        if ((use | def) & clobbered) {
+            break;
+        }
+        if (insn_may_set_zf(item->byte)) {
+            if (asm_add(ctx, ITEM_LI, 0, symbol, line) != 0) {
+                return -1;
+            }
+            memmove(&ctx->item[i + 1], &ctx->item[i], (ctx->items - 1 - i) * sizeof(stAsm_item));
+            ctx->item[i].kind = ITEM_LI;
+            ctx->item[i].byte = 0;
+            ctx->item[i].value = 0;
+            ctx->item[i].symbol = (int16_t)symbol;
+            ctx->item[i].line = line;
+            return 0;
+        }
+    }
+    return asm_error(ctx, line, "jz %s needs the instruction setting ZF right before it, "
+                     "leaving r0 alone; use \"li %s\" and \"jz rX\"",
+                     ctx->label[symbol], ctx->label[symbol]);
+}
+
+static int asm_statement(stAsm *ctx, char **token, int count, int line) {
+    static const struct {
+        const char *name;
+        uint8_t opcode;
+        char form;          // 'H' one register in H, 'L' in L, 'M' two, 'S' mov
+    } ops[] = {
+        { "store", 0x20, 'L' }, { "mov", 0x40, 'S' },  { "add", 0x60, 'M' },
+        { "sub",   0x70, 'M' }, { "shl", 0x80, 'H' },  { "shr", 0x90, 'H' },
+        { "cmp",   0xA0, 'H' }, { "out", 0xC0, 'H' },  { "in",  0xD0, 'H' },
+        { "jz",    0xE0, 'H' }, { "jmp", 0xF0, 'H' },
+    };
+    const char *op = token[0];
+    int value;
+
+    if (strcmp(op, ".scratch") == 0) {
+        if (count != 2 || (ctx->scratch = parse_register(token[1])) <= 0) {
+            return asm_error(ctx, line, ".scratch takes one of r1..r3");
+        }
+        return 0;
+    }
+    if (strcmp(op, ".byte") == 0) {
+        if (count < 2) {
+            return asm_error(ctx, line, ".byte needs values");
+        }
+        for (int i = 1; i < count; i++) {
+            if (!parse_number(token[i], 255, &value)) {
+                return asm_error(ctx, line, "bad byte %s", token[i]);
+            }
+            if (asm_add(ctx, ITEM_BYTE, (uint8_t)value, NO_SYMBOL, line) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    if (strcmp(op, "load") == 0) {
+        int reg = (count == 3) ? parse_register(token[2]) : -1;
+        if (reg < 0 || (strcmp(token[1], "rom") != 0 && strcmp(token[1], "ram") != 0)) {
+            return asm_error(ctx, line, "usage: load rom|ram, rX");
+        }
+        return asm_add(ctx, ITEM_INSN, (uint8_t)((strcmp(token[1], "ram") == 0 ? 0x04 : 0) | reg),
+                       NO_SYMBOL, line);
+    }
+    if (strcmp(op, "set") == 0) {
+        if (count != 2 || !parse_number(token[1], 15, &value)) {
+            return asm_error(ctx, line, "set takes 0..15 (li loads larger values)");
+        }
+        return asm_add(ctx, ITEM_INSN, (uint8_t)(0x50 | value), NO_SYMBOL, line);
+    }
+    if (strcmp(op, "li") == 0) {
+        if (count == 2 && parse_number(token[1], 255, &value)) {
+            return asm_add(ctx, ITEM_LI, (uint8_t)value, NO_SYMBOL, line);
+        }
+        if (count == 2 && is_name(token[1])) {
+            int symbol = asm_symbol(ctx, token[1], line);
+            return (symbol < 0) ? -1 : asm_add(ctx, ITEM_LI, 0, symbol, line);
+        }
+        return asm_error(ctx, line, "li takes 0..255 or a label");
+    }
+    if ((strcmp(op, "jz") == 0 || strcmp(op, "jmp") == 0) && count == 2
+        && parse_register(token[1]) < 0 && is_name(token[1])) {
+        int symbol = asm_symbol(ctx, token[1], line);
+        if (symbol < 0) {
+            return -1;
+        }
+        if (op[1] == 'z') {
+            if (asm_hoist_li(ctx, symbol, line) != 0) return -1;
+        }
+        else if (asm_add(ctx, ITEM_LI, 0, symbol, line) != 0) {
+            return -1;
+        }
+        return asm_add(ctx, ITEM_INSN, op[1] == 'z' ? 0xE0 : 0xF0, NO_SYMBOL, line);
+    }
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (strcmp(op, ops[i].name) != 0) {
+            continue;
+        }
+        int a = (count >= 2) ? parse_register(token[1]) : -1;
+        int b = (count >= 3) ? parse_register(token[2]) : -1;
+        bool two = (ops[i].form == 'M' || ops[i].form == 'S');
+        if (a < 0 || (two ? (b < 0 || count != 3) : count != 2)) {
+            return asm_error(ctx, line, "bad operands for %s", op);
+        }
+        uint8_t byte = ops[i].opcode;
+        switch (ops[i].form) {
+        case 'L': byte |= a; break;
+        case 'H': byte |= a << 2; break;
+        default:  byte |= a << 2 | b; break;    // mov rS, rD = H -> L; add rA, rB
+        }
+        return asm_add(ctx, ITEM_INSN, byte, NO_SYMBOL, line);
+    }
+    return asm_error(ctx, line, "unknown instruction %s", op);
+}
+
+static int asm_parse(stAsm *ctx, const char *source, size_t size) {
+    size_t pos = 0;
+    int line = 0;
+
+    while (pos < size) {
+        char text[256];
+        size_t n = 0;
+        line++;
+        while (pos < size && source[pos] != '\n') {
+            if (n + 1 < sizeof(text)) {
+                text[n++] = source[pos];
+            }
+            pos++;
+        }
+        pos++;
+        text[n] = '\0';
+        char *comment = strchr(text, ';');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        for (char *c = text; *c != '\0'; c++) {
+            *c = (char)tolower((unsigned char)*c);
+        }
+
+        // labels, then one statement
+        char *rest = text;
+        char *colon;
+        while ((colon = strchr(rest, ':')) != NULL) {
+            *colon = '\0';
+            char *name = rest;
+            while (isspace((unsigned char)*name)) name++;
+            char *end = name + strlen(name);
+            while (end > name && isspace((unsigned char)end[-1])) *--end = '\0';
+            if (!is_name(name)) {
+                return asm_error(ctx, line, "bad label \"%s\"", name);
+            }
+            int symbol = asm_symbol(ctx, name, line);
+            if (symbol < 0) {
+                return -1;
+            }
+            if (ctx->defined[symbol]) {
+                return asm_error(ctx, line, "label %s defined twice", name);
+            }
+            ctx->defined[symbol] = true;
+            ctx->label_line[symbol] = line;
+            if (asm_add(ctx, ITEM_LABEL, 0, symbol, line) != 0) {
+                return -1;
+            }
+            rest = colon + 1;
+        }
+        char *token[8];
+        int count = 0;
+        for (char *t = strtok(rest, " \t\r,"); t != NULL; t = strtok(NULL, " \t\r,")) {
+            if (count == 8) {
+                return asm_error(ctx, line, "too many operands");
+            }
+            token[count++] = t;
+        }
+        if (count != 0 && asm_statement(ctx, token, count, line) != 0) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < ctx->labels; i++) {
+        if (!ctx->defined[i]) {
+            return asm_error(ctx, ctx->label_line[i], "undefined label %s", ctx->label[i]);
+        }
+    }
+    return 0;
+}
+
+//---------------------------
+// Segments, jump targets and liveness
+
+static void asm_segments(stAsm *ctx) {
+    int s = 0;
+    ctx->segment[0].begin = 0;
+    for (int i = 0; i < ctx->items; i++) {
+        // a label after a non-label item starts a new segment
+        if (ctx->item[i].kind == ITEM_LABEL && i > ctx->segment[s].begin
+            && ctx->item[i - 1].kind != ITEM_LABEL) {
+            ctx->segment[s].end = i;
+            ctx->segment[++s].begin = i;
+        }
+        if (ctx->item[i].kind == ITEM_LABEL) {
+            ctx->label_segment[ctx->item[i].symbol] = s;
+        }
+    }
+    ctx->segment[s].end = ctx->items;
+    ctx->segments = s + 1;
+
+    for (s = 0; s < ctx->segments; s++) {
+        stAsm_segment *segment = &ctx->segment[s];
+        int last = segment->end - 1;
+        segment->breaks = false;
+        segment->targeted = false;
+        if (last >= segment->begin && ctx->item[last].kind != ITEM_LABEL) {
+            const stAsm_item *item = &ctx->item[last];
+            segment->breaks = item->kind == ITEM_BYTE
+                              || (item->kind == ITEM_INSN && ((item->byte >> 4) == uncondition_jump
+                                                             || (item->byte >> 4) == output_external));
+        }
+    }
+    // jump targets: jz/jmp through r0 right after li label are known
+    for (s = 0; s < ctx->segments; s++) {
+        int r0_symbol = NO_SYMBOL;
+        for (int i = ctx->segment[s].begin; i < ctx->segment[s].end; i++) {
+            const stAsm_item *item = &ctx->item[i];
+            ctx->target[i] = -1;
+            if (item->kind == ITEM_LI) {
+                r0_symbol = item->symbol;
+                if (item->symbol != NO_SYMBOL) {
+                    ctx->segment[ctx->label_segment[item->symbol]].targeted = true;
+                }
+            }
+            else if (item->kind == ITEM_INSN) {
+                uint8_t use, def;
+                uint8_t opcode = item->byte >> 4;
+                if ((opcode == condition_jump || opcode == uncondition_jump)
+                    && (item->byte & 0x0C) == 0 && r0_symbol != NO_SYMBOL) {
+                    ctx->target[i] = ctx->label_segment[r0_symbol];
+                }
+                insn_effects(item->byte, &use, &def);
+                if (def & 0x01) {
+                    r0_symbol = NO_SYMBOL;
+                }
+            }
+        }
+    }
+}
+
+// Walk segment s backwards from live_out; live_after[] (may be NULL)
+// receives the live set after every item. Return the live-in set.
+static uint8_t asm_segment_live(const stAsm *ctx, int s, uint8_t *live_after) {
+    const stAsm_segment *segment = &ctx->segment[s];
+    uint8_t live;
+    if (segment->breaks) {
+        live = 0;
+    }
+    else if (s + 1 < ctx->segments) {
+        live = ctx->segment[s + 1].live_in;
+    }
+    else {
+        live = LIVE_ALL;        // runs off the end of the program
+    }
+    for (int i = segment->end - 1; i >= segment->begin; i--) {
+        const stAsm_item *item = &ctx->item[i];
+        if (live_after != NULL) {
+            live_after[i] = live;
+        }
+        if (item->kind == ITEM_LI) {
+            live &= ~(0x01 | LIVE_ZF);
+            if (li_clobbers_scratch(ctx, item)) {
+                live &= ~(1 << ctx->scratch);
+            }
+        }
+        else if (item->kind == ITEM_INSN) {
+            uint8_t use, def;
+            uint8_t opcode = item->byte >> 4;
+            insn_effects(item->byte, &use, &def);
+            if (opcode == output_external) {
+                live = 0;
+            }
+            else if (opcode == uncondition_jump) {
+                live = (ctx->target[i] >= 0) ? ctx->segment[ctx->target[i]].live_in : LIVE_ALL;
+            }
+            else if (opcode == condition_jump) {
+                live |= (ctx->target[i] >= 0) ? ctx->segment[ctx->target[i]].live_in : LIVE_ALL;
+            }
+            live = (live & ~def) | use;
+        }
+    }
+    return live;
+}
+
+static void asm_liveness(stAsm *ctx) {
+    bool changed = true;
+    for (int s = 0; s < ctx->segments; s++) {
+        ctx->segment[s].live_in = 0;
+    }
+    while (changed) {
+        changed = false;
+        for (int s = ctx->segments - 1; s >= 0; s--) {
+            uint8_t live = asm_segment_live(ctx, s, NULL);
+            if (live != ctx->segment[s].live_in) {
+                ctx->segment[s].live_in = live;
+                changed = true;
+            }
+        }
+    }
+}
+
+//---------------------------
+// Peephole pass
+
+#define VALUE_CONST(n)      (1000 + (n))
+#define VALUE_SYMBOL(s)     (2000 + (s))
+
+// Delete the first mov, set or li that is redundant or dead, return true
+// if one was deleted
+static bool asm_peephole_once(stAsm *ctx) {
+    uint8_t live_after[ASM_MAX_ITEMS];
+
+    asm_segments(ctx);
+    asm_liveness(ctx);
+    for (int s = 0; s < ctx->segments; s++) {
+        const stAsm_segment *segment = &ctx->segment[s];
+        int value[4];
+        int fresh = 3000;
+
+        asm_segment_live(ctx, s, live_after);
+        for (int r = 0; r < 4; r++) {
+            value[r] = fresh++;
+        }
+        for (int i = segment->begin; i < segment->end; i++) {
+            const stAsm_item *item = &ctx->item[i];
+            bool zf_dead = (live_after[i] & LIVE_ZF) == 0;
+            bool remove = false;
+            int loaded = -1;
+
+            if (item->kind == ITEM_LI) {
+                loaded = (item->symbol != NO_SYMBOL) ? VALUE_SYMBOL(item->symbol) : VALUE_CONST(item->value);
+            }
+            else if (item->kind == ITEM_INSN && (item->byte >> 4) == set_value_r0) {
+                loaded = VALUE_CONST(item->byte & 0x0F);
+            }
+            if (loaded >= 0) {
+                remove = zf_dead && (value[0] == loaded || (live_after[i] & 0x01) == 0);
+                value[0] = loaded;
+                if (item->kind == ITEM_LI && li_clobbers_scratch(ctx, item)) {
+                    value[ctx->scratch] = fresh++;
+                }
+            }
+            else if (item->kind == ITEM_INSN && (item->byte >> 4) == rx_to_ry) {
+                int from = (item->byte >> 2) & 0x03;
+                int to = item->byte & 0x03;
+                remove = zf_dead && (value[from] == value[to] || (live_after[i] & (1 << to)) == 0);
+                value[to] = value[from];
+            }
+            else if (item->kind == ITEM_INSN) {
+                uint8_t use, def;
+                insn_effects(item->byte, &use, &def);
+                for (int r = 0; r < 4; r++) {
+                    if (def & (1 << r)) {
+                        value[r] = fresh++;
+                    }
+                }
+            }
+            if (remove) {
+                memmove(&ctx->item[i], &ctx->item[i + 1], (ctx->items - i - 1) * sizeof(stAsm_item));
+                ctx->items--;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//---------------------------
+// Layout
+
+// Loop depth of every segment from the natural loops of the segment graph
+static void asm_weights(stAsm *ctx) {
+    bool edge[MAX_SEGMENTS][MAX_SEGMENTS] = { { false } };
+    int depth[MAX_SEGMENTS] = { 0 };
+    int n = ctx->segments;
+
+    for (int s = 0; s < n; s++) {
+        const stAsm_segment *segment = &ctx->segment[s];
+        if (!segment->breaks && s + 1 < n) {
+            edge[s][s + 1] = true;
+        }
+        for (int i = segment->begin; i < segment->end; i++) {
+            const stAsm_item *item = &ctx->item[i];
+            uint8_t opcode = item->byte >> 4;
+            if (item->kind != ITEM_INSN || (opcode != condition_jump && opcode != uncondition_jump)) {
+                continue;
+            }
+            for (int t = 0; t < n; t++) {
+                if (ctx->target[i] == t || (ctx->target[i] < 0 && ctx->segment[t].targeted)) {
+                    edge[s][t] = true;
+                }
+            }
+        }
+    }
+
+    // depth-first search from the entry; an edge to a segment on the
+    // stack closes a loop whose body is everything reaching the edge's
+    // source without going through the header
+    int state[MAX_SEGMENTS] = { 0 };    // 0 new, 1 on stack, 2 done
+    int stack[MAX_SEGMENTS], next[MAX_SEGMENTS];
+    bool header[MAX_SEGMENTS][MAX_SEGMENTS] = { { false } };   // [header][tail]
+    int top = 0;
+    stack[0] = 0;
+    next[0] = 0;
+    state[0] = 1;
+    while (top >= 0) {
+        int u = stack[top];
+        if (next[top] == n) {
+            state[u] = 2;
+            top--;
+            continue;
+        }
+        int v = next[top]++;
+        if (!edge[u][v]) continue;
+        if (state[v] == 1) {
+            header[v][u] = true;
+        }
+        else if (state[v] == 0) {
+            state[v] = 1;
+            stack[++top] = v;
+            next[top] = 0;
+        }
+    }
+    for (int h = 0; h < n; h++) {
+        bool body[MAX_SEGMENTS] = { false };
+        int work[MAX_SEGMENTS], count = 0;
+        bool any = false;
+        body[h] = true;
+        for (int t = 0; t < n; t++) {
+            if (header[h][t] && !body[t]) {
+                body[t] = true;
+                work[count++] = t;
+            }
+            any |= header[h][t];
+        }
+        if (!any) continue;
+        while (count > 0) {
+            int v = work[--count];
+            for (int u = 0; u < n; u++) {
+                if (edge[u][v] && !body[u] && state[u] != 0) {
+                    body[u] = true;
+                    work[count++] = u;
+                }
+            }
+        }
+        for (int s = 0; s < n; s++) {
+            depth[s] += body[s];
+        }
+    }
+    for (int s = 0; s < n; s++) {
+        int weight = 1;
+        for (int d = 0; d < depth[s] && d < 6; d++) {
+            weight *= 10;
+        }
+        ctx->segment[s].weight = weight;
+    }
+}
+
+static int li_value(const stAsm *ctx, const stAsm_layout *layout, const stAsm_item *item) {
+    return (item->symbol != NO_SYMBOL) ? layout->address[ctx->label_segment[item->symbol]] : item->value;
+}
+
+// Place the segments in layout->order, growing every li until the sizes
+// are stable. Return 0 and the cost, or -1 when the order cannot work.
+static int asm_place(const stAsm *ctx, stAsm_layout *layout, bool align) {
+    int n = ctx->segments;
+    uint8_t clobbered = 0x01 | LIVE_ZF | ((ctx->scratch >= 0) ? 1 << ctx->scratch : 0);
+    bool targeted[MAX_SEGMENTS];
+
+    layout->entry = (layout->order[0] != 0);
+    if (layout->entry && (ctx->segment[0].live_in & clobbered)) {
+        return -1;
+    }
+    layout->entry_size = 1;
+    for (int s = 0; s < n; s++) {
+        targeted[s] = ctx->segment[s].targeted || (s == 0 && layout->entry);
+        layout->fixup[s] = false;
+        layout->fix_size[s] = 1;
+    }
+    for (int p = 0; p < n; p++) {
+        int s = layout->order[p];
+        if (ctx->segment[s].breaks) continue;
+        if (s + 1 == n) {
+            if (p != n - 1) return -1;      // must stay last to run off the end
+            continue;
+        }
+        if (p + 1 < n && layout->order[p + 1] == s + 1) continue;
+        if (ctx->segment[s + 1].live_in & clobbered) return -1;
+        layout->fixup[s] = true;
+        targeted[s + 1] = true;
+    }
+    for (int i = 0; i < ctx->items; i++) {
+        layout->size[i] = 1;
+    }
+
+    for (;;) {
+        int address = layout->entry ? layout->entry_size + 1 : 0;
+        bool breaks = true;
+        for (int p = 0; p < n; p++) {
+            int s = layout->order[p];
+            const stAsm_segment *segment = &ctx->segment[s];
+            if (align && breaks && targeted[s] && address > 16 && (address & 0x0F) != 0) {
+                address = (address + 15) & ~15;
+            }
+            layout->address[s] = address;
+            for (int i = segment->begin; i < segment->end; i++) {
+                if (ctx->item[i].kind == ITEM_LI) address += layout->size[i];
+                else if (ctx->item[i].kind != ITEM_LABEL) address++;
+            }
+            if (layout->fixup[s]) {
+                address += layout->fix_size[s] + 1;
+            }
+            breaks = segment->breaks || layout->fixup[s];
+        }
+        layout->length = address;
+        if (address > ROM_SIZE) {
+            return -1;
+        }
+
+        bool changed = false;
+        int need;
+        for (int i = 0; i < ctx->items; i++) {
+            if (ctx->item[i].kind != ITEM_LI) continue;
+            if ((need = li_need(ctx, li_value(ctx, layout, &ctx->item[i]))) < 0) return -1;
+            if (need > layout->size[i]) {
+                layout->size[i] = (uint8_t)need;
+                changed = true;
+            }
+        }
+        for (int s = 0; s < n; s++) {
+            if (!layout->fixup[s]) continue;
+            if ((need = li_need(ctx, layout->address[s + 1])) < 0) return -1;
+            if (need > layout->fix_size[s]) {
+                layout->fix_size[s] = (uint8_t)need;
+                changed = true;
+            }
+        }
+        if (layout->entry) {
+            if ((need = li_need(ctx, layout->address[0])) < 0) return -1;
+            if (need > layout->entry_size) {
+                layout->entry_size = (uint8_t)need;
+                changed = true;
+            }
+        }
+        if (!changed) break;
+    }
+
+    // executed instructions, weighted by the loop depth of their segment
+    layout->cost = layout->entry ? layout->entry_size + 1 : 0;
+    for (int s = 0; s < n; s++) {
+        const stAsm_segment *segment = &ctx->segment[s];
+        long size = layout->fixup[s] ? layout->fix_size[s] + 1 : 0;
+        for (int i = segment->begin; i < segment->end; i++) {
+            if (ctx->item[i].kind == ITEM_LI) size += layout->size[i];
+            else if (ctx->item[i].kind == ITEM_INSN) size++;
+        }
+        layout->cost += size * segment->weight;
+    }
+    return 0;
+}
+
+static int asm_place_any(const stAsm *ctx, stAsm_layout *layout) {
+    if (asm_place(ctx, layout, true) == 0) {
+        return 0;
+    }
+    return asm_place(ctx, layout, false);
+}
+
+// try every order of segments[k..n), keep the cheapest in *best
+static void asm_permute(const stAsm *ctx, stAsm_layout *trial, int k, stAsm_layout *best) {
+    int n = ctx->segments;
+    if (k == n) {
+        if (asm_place_any(ctx, trial) == 0 && (best->cost < 0 || trial->cost < best->cost)) {
+            *best = *trial;
+        }
+        return;
+    }
+    for (int i = k; i < n; i++) {
+        int t = trial->order[k]; trial->order[k] = trial->order[i]; trial->order[i] = t;
+        asm_permute(ctx, trial, k + 1, best);
+        t = trial->order[k]; trial->order[k] = trial->order[i]; trial->order[i] = t;
+    }
+}
+
+static void asm_emit(const stAsm *ctx, const stAsm_layout *layout, uint8_t rom[ROM_SIZE]) {
+    memset(rom, 0, ROM_SIZE);
+    if (layout->entry) {
+        li_expand(ctx, layout->address[0], layout->entry_size, rom);
+        rom[layout->entry_size] = 0xF0;
+    }
+    for (int p = 0; p < ctx->segments; p++) {
+        int s = layout->order[p];
+        const stAsm_segment *segment = &ctx->segment[s];
+        int address = layout->address[s];
+        for (int i = segment->begin; i < segment->end; i++) {
+            const stAsm_item *item = &ctx->item[i];
+            if (item->kind == ITEM_LI) {
+                li_expand(ctx, li_value(ctx, layout, item), layout->size[i], rom + address);
+                address += layout->size[i];
+            }
+            else if (item->kind != ITEM_LABEL) {
+                rom[address++] = item->byte;
+            }
+        }
+        if (layout->fixup[s]) {
+            li_expand(ctx, layout->address[s + 1], layout->fix_size[s], rom + address);
+            rom[address + layout->fix_size[s]] = 0xF0;
+        }
+    }
+}
+
+int asm_assemble(const char *source, size_t size, bool optimize,
+                 uint8_t rom[ROM_SIZE], size_t *len, stAsm_report *report,
+                 char *error, size_t error_size) {
+    stAsm *ctx = calloc(1, sizeof(stAsm));
+    stAsm_layout *layout = malloc(2 * sizeof(stAsm_layout));
+    stAsm_report local = { 0, 0, false };
+    int result = -1;
+
+    if (ctx == NULL || layout == NULL) {
+        free(ctx);
+        free(layout);
+        if (error != NULL && error_size != 0) snprintf(error, error_size, "out of memory");
+        return -1;
+    }
+    ctx->scratch = -1;
+    ctx->error = error;
+    ctx->error_size = error_size;
+    if (asm_parse(ctx, source, size) != 0) {
+        goto done;
+    }
+    if (ctx->items == 0) {
+        asm_error(ctx, 0, "empty program");
+        goto done;
+    }
+
+    while (optimize && asm_peephole_once(ctx)) {
+        local.removed++;
+    }
+    asm_segments(ctx);
+    asm_liveness(ctx);
+    asm_weights(ctx);
+    local.blocks = (unsigned)ctx->segments;
+
+    // source order first; with "optimize" any cheaper order replaces it
+    stAsm_layout *best = &layout[0];
+    for (int s = 0; s < ctx->segments; s++) {
+        best->order[s] = s;
+    }
+    best->cost = -1;
+    if (asm_place_any(ctx, best) != 0) {
+        best->cost = -1;
+    }
+    if (optimize) {
+        stAsm_layout *trial = &layout[1];
+        for (int s = 0; s < ctx->segments; s++) {
+            trial->order[s] = s;
+        }
+        if (ctx->segments <= PERMUTE_MAX) {
+            asm_permute(ctx, trial, 0, best);
+        }
+        else {
+            // hottest segments first, otherwise in source order
+            for (int i = 1; i < ctx->segments; i++) {
+                for (int j = i; j > 0 && ctx->segment[trial->order[j]].weight
+                                         > ctx->segment[trial->order[j - 1]].weight; j--) {
+                    int t = trial->order[j]; trial->order[j] = trial->order[j - 1]; trial->order[j - 1] = t;
+                }
+            }
+            if (asm_place_any(ctx, trial) == 0 && (best->cost < 0 || trial->cost < best->cost)) {
+                *best = *trial;
+            }
+        }
+    }
+    if (best->cost < 0) {
+        asm_error(ctx, 0, "does not fit the %d-byte ROM%s", ROM_SIZE,
+                  ctx->scratch < 0 ? " (or needs .scratch for a label that cannot be aligned)" : "");
+        goto done;
+    }
+    for (int s = 0; s < ctx->segments; s++) {
+        local.relaid |= (best->order[s] != s);
+    }
+    asm_emit(ctx, best, rom);
+    *len = (size_t)best->length;
+    result = 0;
+
+done:
+    if (report != NULL) {
+        *report = local;
+    }
+    free(ctx);
+    free(layout);
+    return result;
+}
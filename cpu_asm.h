@@ -0,0 +1,57 @@
+#ifndef CPU_ASM_H
+#define CPU_ASM_H
+
+#include "cpu_core.h"
+
+// Assembler for the 16-opcode ISA, one statement per line, ';' comments:
+//
+//   label:                     (may share the line with a statement)
+//   load rom, rX | load ram, rX    r0 = memory[rX]
+//   store rX                   RAM[rX % 128 + 0x80] = r0
+//   mov rS, rD                 rD = rS
+//   set n                      r0 = n (0..15)
+//   add rA, rB | sub rA, rB    rA = rA +/- rB
+//   shl rA | shr rA            rA shifted by 4
+//   cmp rA                     ZF = (rA == 0)
+//   out rA | in rA
+//   jz rA | jmp rA             jump to the address in rA
+//
+// and the pseudo instructions
+//
+//   li n | li label            r0 = n: "set n", "set n >> 4; shl r0" when
+//                              n is a multiple of 16, otherwise five
+//                              instructions through the .scratch register
+//   jmp label                  li label; jmp r0
+//   jz label                   li label is hoisted in front of the
+//                              instruction that sets ZF, which must leave
+//                              r0 alone: "cmp r3; jz loop" becomes
+//                              "li loop; cmp r3; jz r0"
+//   .byte n, ...               raw bytes
+//   .scratch rN                register li may clobber for addresses that
+//                              are not multiples of 16
+//
+// Labels that are jump targets are aligned to 16 when the code before them
+// never falls through, so "li label" stays one or two instructions.
+//
+// With "optimize", a peephole pass deletes mov, set and li whose result is
+// already in place or never read (when ZF is dead too), and the blocks are
+// relaid so that the loop bodies weighted by nesting depth execute the
+// fewest instructions, putting the hottest targets below address 16 and
+// inserting jumps where a block no longer falls through.
+
+#define ASM_MAX_ITEMS   (512)
+#define ASM_MAX_LABELS  (64)
+
+typedef struct asm_report{
+    unsigned removed;       // instructions deleted by the peephole pass
+    unsigned blocks;        // blocks seen by the layout pass
+    bool relaid;            // the layout differs from the source order
+} stAsm_report;
+
+// Assemble "source" into rom (the rest is zeroed), its size into *len.
+// Return 0, or -1 with "line N: message" in "error". report may be NULL.
+int asm_assemble(const char *source, size_t size, bool optimize,
+                 uint8_t rom[ROM_SIZE], size_t *len, stAsm_report *report,
+                 char *error, size_t error_size);
+
+#endif // CPU_ASM_H
@@ -0,0 +1,244 @@
+#include "cpu_batch.h"
+#include <string.h>
+
+#if defined(__GNUC__)
+
+typedef uint8_t vbyte __attribute__((vector_size(BATCH_LANES), aligned(BATCH_LANES)));
+
+#define VMASK(cond)     ((vbyte)(cond))
+
+// per lane: m ? a : b (m is all ones or all zeros)
+static inline vbyte vsel(vbyte m, vbyte a, vbyte b) {
+    return (m & a) | (~m & b);
+}
+
+static inline bool vany(vbyte m) {
+    uint64_t w[BATCH_LANES / 8];
+    uint64_t any = 0;
+    memcpy(w, &m, sizeof(w));
+    for (size_t i = 0; i < BATCH_LANES / 8; i++) {
+        any |= w[i];
+    }
+    return any != 0;
+}
+
+// register of each lane selected by a 2-bit index vector
+static inline vbyte vreg(vbyte index, vbyte r0, vbyte r1, vbyte r2, vbyte r3) {
+    return vsel(VMASK(index == 0), r0,
+           vsel(VMASK(index == 1), r1,
+           vsel(VMASK(index == 2), r2, r3)));
+}
+
+// Run up to BATCH_LANES CPUs (programs[0..count-1]) to completion
+static uint64_t batch_group(const uint8_t *const *programs, const uint8_t *inputs, size_t count,
+                            stBatch_result *results, uint64_t limit) {
+    // memory[address] holds that byte of every lane
+    static __thread vbyte memory[MEM_SIZE];
+    vbyte r0 = { 0 }, r1 = { 0 }, r2 = { 0 }, r3 = { 0 };
+    vbyte PC = { 0 }, status = { 0 }, halt = { 0 };
+    vbyte output = { 0 }, input = { 0 }, input_pending = { 0 };
+    uint64_t steps[BATCH_LANES];
+    uint64_t iteration;
+
+    memset(memory, 0, sizeof(memory));
+    for (size_t k = 0; k < BATCH_LANES; k++) {
+        steps[k] = 0;
+        if (k < count) {
+            for (int address = 0; address < ROM_SIZE; address++) {
+                memory[address][k] = programs[k][address];
+            }
+            input[k] = inputs[k];
+            input_pending[k] = 0xFF;
+        }
+        else {
+            halt[k] = HALT_STEP_LIMIT;       // unused lane
+        }
+    }
+
+    for (iteration = 0; iteration < limit; iteration++) {
+        vbyte active = VMASK(halt == 0);
+        if (!vany(active)) {
+            break;
+        }
+
+        // fetch: one vector load when every running lane is at the same PC
+        vbyte ins;
+        int first = 0;
+        while (!active[first]) {
+            first++;
+        }
+        vbyte same = VMASK(PC == PC[first]) | ~active;
+        if (!vany(~same)) {
+            ins = memory[PC[first]];
+        }
+        else {
+            for (int k = 0; k < BATCH_LANES; k++) {
+                ins[k] = memory[PC[k]][k];
+            }
+        }
+
+        // decode, halted lanes get opcode 0x10 which matches nothing
+        vbyte op = vsel(active, ins >> 4, (vbyte){ 0 } + 0x10);
+        vbyte H = (ins >> 2) & 0x03;
+        vbyte L = ins & 0x03;
+        vbyte rH = vreg(H, r0, r1, r2, r3);
+        vbyte rL = vreg(L, r0, r1, r2, r3);
+
+        vbyte m_load     = VMASK(op <= mem_to_r0_2);
+        vbyte m_store    = VMASK(op == r0_to_ram_1) | VMASK(op == r0_to_ram_2);
+        vbyte m_transfer = VMASK(op == rx_to_ry);
+        vbyte m_set      = VMASK(op == set_value_r0);
+        vbyte m_add      = VMASK(op == add_ry_to_rx);
+        vbyte m_sub      = VMASK(op == substract_ry_by_rx);
+        vbyte m_shl      = VMASK(op == shift_left);
+        vbyte m_shr      = VMASK(op == shift_right);
+        vbyte m_compare  = VMASK(op == compare_rx_with_zero_1) | VMASK(op == compare_rx_with_zero_2);
+        vbyte m_output   = VMASK(op == output_external);
+        vbyte m_input    = VMASK(op == input_external);
+        vbyte m_cond     = VMASK(op == condition_jump);
+        vbyte m_uncond   = VMASK(op == uncondition_jump);
+
+        // arithmetic
+        vbyte sum = rH + rL;
+        vbyte carry = VMASK(sum < rH);
+        vbyte diff = rH - rL;
+        vbyte borrow = VMASK(rH < rL);
+
+        // memory read: select bit 0 must hit ROM, 1 must hit RAM
+        vbyte select = VMASK((ins & 0x04) != 0);
+        vbyte in_ram = VMASK(rL >= ROM_SIZE);
+        vbyte fault = m_load & (select ^ in_ram);
+        vbyte m_read = m_load & ~fault;
+        vbyte loaded = { 0 };
+        if (vany(m_read)) {
+            for (int k = 0; k < BATCH_LANES; k++) {
+                if (m_read[k]) {
+                    loaded[k] = memory[rL[k]][k];
+                }
+            }
+        }
+        // memory write, always inside RAM
+        if (vany(m_store)) {
+            for (int k = 0; k < BATCH_LANES; k++) {
+                if (m_store[k]) {
+                    memory[rL[k] | 0x80][k] = r0[k];
+                }
+            }
+        }
+        // input: the lane's byte the first time, 0 afterwards
+        vbyte value_in = input & input_pending;
+        input_pending &= ~m_input;
+
+        // register write back
+        vbyte write = m_transfer | m_set | m_add | m_sub | m_shl | m_shr | m_read | m_input;
+        vbyte dest = vsel(m_transfer, L, vsel(m_set | m_read, (vbyte){ 0 }, H));
+        vbyte value = vsel(m_transfer, rH,
+                      vsel(m_set, ins & 0x0F,
+                      vsel(m_add, sum,
+                      vsel(m_sub, diff,
+                      vsel(m_shl, rH << 4,
+                      vsel(m_shr, rH >> 4,
+                      vsel(m_read, loaded, value_in)))))));
+        vbyte old_r0 = r0;
+        r0 = vsel(write & VMASK(dest == 0), value, r0);
+        r1 = vsel(write & VMASK(dest == 1), value, r1);
+        r2 = vsel(write & VMASK(dest == 2), value, r2);
+        r3 = vsel(write & VMASK(dest == 3), value, r3);
+
+        // branches read ZF before this step
+        vbyte zero_set = VMASK((status & STATUS_ZERO) != 0);
+        vbyte jump = m_uncond | (m_cond & zero_set);
+        PC = vsel(active, vsel(jump, rH, PC + 1), PC);
+
+        // flags
+        vbyte zf_write = m_transfer | m_set | (m_add & ~carry) | (m_sub & ~borrow)
+                       | m_read | m_store | m_compare;
+        vbyte zf_source = vsel(m_store, old_r0, vsel(m_compare, rH, value));
+        vbyte zf_value = VMASK(zf_source == 0) & STATUS_ZERO;
+        status = vsel(zf_write, (status & ~STATUS_ZERO) | zf_value, status);
+        vbyte of_write = m_add | m_sub;
+        vbyte of_value = ((m_add & carry) | (m_sub & borrow)) & STATUS_OF;
+        status = vsel(of_write, (status & ~STATUS_OF) | of_value, status);
+
+        // halts
+        output = vsel(m_output, rH, output);
+        halt = vsel(m_output, (vbyte){ 0 } + HALT_OUTPUT, halt);
+        halt = vsel(fault & select, (vbyte){ 0 } + HALT_RAM_READ, halt);
+        halt = vsel(fault & ~select, (vbyte){ 0 } + HALT_ROM_READ, halt);
+        vbyte stopped = active & VMASK(halt != 0);
+        if (vany(stopped)) {
+            for (int k = 0; k < BATCH_LANES; k++) {
+                if (stopped[k]) {
+                    steps[k] = iteration + 1;
+                }
+            }
+        }
+    }
+
+    uint64_t total = 0;
+    for (size_t k = 0; k < count; k++) {
+        stBatch_result *result = &results[k];
+        if (halt[k] == HALT_NONE) {
+            halt[k] = HALT_STEP_LIMIT;
+            steps[k] = iteration;
+        }
+        result->steps = steps[k];
+        result->halt = halt[k];
+        result->output = output[k];
+        result->PC = PC[k];
+        result->status = status[k];
+        result->r[0] = r0[k];
+        result->r[1] = r1[k];
+        result->r[2] = r2[k];
+        result->r[3] = r3[k];
+        total += steps[k];
+    }
+    return total;
+}
+
+uint64_t run_batch(const uint8_t *const *programs, const uint8_t *inputs, size_t n,
+                   stBatch_result *results, uint64_t max_steps) {
+    uint64_t limit = (max_steps != 0) ? max_steps : UINT64_MAX;
+    uint64_t total = 0;
+    for (size_t first = 0; first < n; first += BATCH_LANES) {
+        size_t count = (n - first < BATCH_LANES) ? n - first : BATCH_LANES;
+        total += batch_group(programs + first, inputs + first, count, results + first, limit);
+    }
+    return total;
+}
+
+#else
+
+// Fill one result from a CPU state
+static void batch_result_of(stBatch_result *result, const stCpu_state *cpu, uint64_t steps, uint8_t output) {
+    result->steps = steps;
+    result->halt = cpu->halt;
+    result->output = output;
+    result->PC = cpu->PC;
+    result->status = cpu->status;
+    result->r[0] = cpu->r0;
+    result->r[1] = cpu->r1;
+    result->r[2] = cpu->r2;
+    result->r[3] = cpu->r3;
+}
+
+// no vector extensions: run the CPUs one by one
+uint64_t run_batch(const uint8_t *const *programs, const uint8_t *inputs, size_t n,
+                   stBatch_result *results, uint64_t max_steps) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        stCpu_state cpu;
+        stCpu_buffer buffer;
+        stCpu_io io;
+        uint8_t output = 0;
+        initialize_cpu(&cpu);
+        load_program(&cpu, programs[i], ROM_SIZE);
+        cpu_buffer_io(&io, &buffer, &inputs[i], 1, &output, 1);
+        uint64_t steps = run_cpu(&cpu, &io, max_steps);
+        batch_result_of(&results[i], &cpu, steps, output);
+        total += steps;
+    }
+    return total;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CPU_BATCH_H
+#define CPU_BATCH_H
+
+#include "cpu_core.h"
+
+// Lockstep batch emulator: many CPUs stepped together, BATCH_LANES at a
+// time, with their state kept in structure-of-arrays form (one vector per
+// register, one plane per memory address). Every step decodes the
+// instructions of all lanes at once and executes all opcodes under
+// per-lane masks, so lanes that diverge on branches keep running side by
+// side. When all lanes are at the same PC the fetch is a single vector load.
+//
+// Written with GCC vector extensions: build with -mavx2 (or -march=native)
+// to get 32 lanes of AVX2 byte ops, 16 lanes of SSE2 otherwise. Other
+// compilers run each CPU with run_cpu().
+
+#if defined(__AVX2__)
+#define BATCH_LANES     (32)
+#else
+#define BATCH_LANES     (16)
+#endif
+
+// Final state of one CPU of the batch
+typedef struct batch_result{
+    uint64_t steps;
+    uint8_t halt;
+    uint8_t output;         // value of output_external (halt == HALT_OUTPUT)
+    uint8_t PC;
+    uint8_t status;
+    uint8_t r[4];
+} stBatch_result;
+
+// Run n CPUs: CPU i executes the ROM image programs[i] (ROM_SIZE bytes) and
+// reads inputs[i] on its first input_external (0 afterwards), like the
+// buffer backend. Each CPU stops at halt or after max_steps instructions
+// (0 = no limit). Return the total number of executed instructions.
+uint64_t run_batch(const uint8_t *const *programs, const uint8_t *inputs, size_t n,
+                   stBatch_result *results, uint64_t max_steps);
+
+#endif // CPU_BATCH_H
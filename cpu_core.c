@@ -0,0 +1,475 @@
+#include "cpu_core.h"
+#include "cpu_profile.h"
+#include <string.h>
+
+// Instructor function
+static void instr_mem_to_r0(stCpu_state *cpu, Register rx, uint8_t select_bit, const stCpu_io *io);
+static void instr_r0_to_ram(stCpu_state *cpu, Register rx, const stCpu_io *io);
+static void instr_transfer_reg(stCpu_state *cpu, Register rx, Register ry);
+static void instr_immediate_set(stCpu_state *cpu, uint8_t value);
+static void instr_add(stCpu_state *cpu, Register rx, Register ry, const stCpu_io *io);
+static void instr_sub(stCpu_state *cpu, Register rx, Register ry, const stCpu_io *io);
+static void instr_shift_left(stCpu_state *cpu, Register rx);
+static void instr_shift_right(stCpu_state *cpu, Register rx);
+static void instr_compare(stCpu_state *cpu, Register rx);
+static void instr_output(stCpu_state *cpu, Register rx, const stCpu_io *io);
+static void instr_input(stCpu_state *cpu, Register rx, const stCpu_io *io);
+static void instr_cond_branch(stCpu_state *cpu, Register rx);
+static void instr_uncond_branch(stCpu_state *cpu, Register rx);
+
+static void update_zero_flag(stCpu_state *cpu, uint8_t value);
+
+// send a diagnostic to the backend, if it wants them
+static void cpu_message(const stCpu_io *io, const char *text) {
+    if (io->message != NULL) {
+        io->message(io->ctx, text);
+    }
+}
+
+
+//---------------------------
+// Define functions
+
+// Initilization of CPU family
+void initialize_cpu(stCpu_state *cpu) {
+    // initilization for registers
+    cpu->PC = 0;
+    cpu->r0 = 0;
+    cpu->r1 = 0;
+    cpu->r2 = 0;
+    cpu->r3 = 0;
+    cpu->status = 0;
+    cpu->instruction = 0;
+    cpu->halt = HALT_NONE;
+    // initialization for memory
+    memset(cpu->memory, 0, MEM_SIZE);
+}
+
+// Store a machine code image into ROM, the rest of ROM is set to 0
+void load_program(stCpu_state *cpu, const uint8_t *program, size_t len) {
+    if (len > ROM_SIZE) {
+        len = ROM_SIZE;
+    }
+    memcpy(cpu->memory, program, len);
+    memset(&(cpu->memory[len]), 0, ROM_SIZE - len);
+}
+
+// Store the machine code of addition program into ROM
+void load_addition_program(stCpu_state *cpu) {
+    static const uint8_t addition_program[] = {
+        0xD2,
+        0x4B,
+        0x51,
+        0x7C,
+
+        0x5D,
+        0x60,
+        0xA3,
+        0xE0,
+
+        0x4D,
+
+        0x5A,
+        0x60,
+        0xA1,
+        0xE0,
+        0x03,
+        0x62,
+        0x23,
+        0x51,
+        0x74,
+
+        0x59,
+        0xF0,
+        0x03,
+        0x42,
+        0x51,
+        0x7C,
+
+        0x54,
+        0xF0,
+        0xC2
+    };
+    load_program(cpu, addition_program, sizeof(addition_program));
+}
+
+// Store the machine code of factorial program into ROM: r1 = N! (mod 256).
+// Immediates only reach 0..15, so far targets are built as imm << 4 and the
+// remaining counter N lives in RAM[0x80].
+void load_factorial_program(stCpu_state *cpu) {
+    static const uint8_t factorial_program[] = {
+        0x53,   // 0: r0 = 3
+        0x80,   // 1: r0 <<= 4 (48)
+        0xF0,   // 2: jump to Setup
+    // End:
+        0xC4,   // 3: output r1
+    // Inner_Loop:
+        0x51,   // 4: r0 = 1
+        0x80,   // 5: r0 <<= 4 (16)
+        0xAC,   // 6: compare r3 with zero
+        0xE0,   // 7: if zero, jump to Next
+        0x66,   // 8: r1 = r1 + r2
+        0x51,   // 9: r0 = 1
+        0x7C,   // 10: r3 = r3 - r0
+        0x54,   // 11: r0 = 4
+        0xF0,   // 12: jump to Inner_Loop
+        0x00, 0x00, 0x00,
+    // Next: (r3 == 0)
+        0x58,   // 16: r0 = 8
+        0x80,   // 17: r0 <<= 4 (0x80)
+        0x04,   // 18: r0 = RAM[0x80] (N)
+        0x42,   // 19: r2 = r0
+        0x51,   // 20: r0 = 1
+        0x78,   // 21: r2 = r2 - r0
+        0x48,   // 22: r0 = r2
+        0x23,   // 23: RAM[r3 + 0x80] = r0 (N - 1)
+        0x52,   // 24: r0 = 2
+        0x80,   // 25: r0 <<= 4 (32)
+        0xF0,   // 26: jump to Outer_Loop
+        0x00, 0x00, 0x00, 0x00, 0x00,
+    // Outer_Loop:
+        0x53,   // 32: r0 = 3
+        0x42,   // 33: r2 = r0 (End)
+        0x58,   // 34: r0 = 8
+        0x80,   // 35: r0 <<= 4 (0x80)
+        0x04,   // 36: r0 = RAM[0x80] (N), ZF = (N == 0)
+        0xE8,   // 37: if zero, jump to End
+        0x43,   // 38: r3 = r0
+        0x51,   // 39: r0 = 1
+        0x7C,   // 40: r3 = r3 - r0 (N - 1 additions)
+        0x46,   // 41: r2 = r1
+        0x54,   // 42: r0 = 4
+        0xF0,   // 43: jump to Inner_Loop
+        0x00, 0x00, 0x00, 0x00,
+    // Setup:
+        0xD0,   // 48: input N into r0
+        0x23,   // 49: RAM[r3 + 0x80] = r0 (r3 = 0)
+        0x51,   // 50: r0 = 1
+        0x41,   // 51: r1 = r0
+        0x52,   // 52: r0 = 2
+        0x80,   // 53: r0 <<= 4 (32)
+        0xF0    // 54: jump to Outer_Loop
+    };
+    load_program(cpu, factorial_program, sizeof(factorial_program));
+}
+
+// capture the machine code from memory to instruction register through by PC
+void fetch_instruction(stCpu_state *cpu) {
+    cpu->instruction = cpu->memory[cpu->PC];
+    PROFILE_STEP(gCpu_profile, cpu->PC, cpu->instruction);
+    cpu->PC += 1;
+}
+
+// Decode the instruction to obtain the opcode part and operand part
+stInstruction decode_instruction(const stCpu_state *cpu) {
+    stInstruction instr;
+    // extract the opcode part and operand part from instruction code
+    instr.opcode = (cpu->instruction) >> 4;
+    instr.operand = (cpu->instruction) & 0x0F;
+    return instr;
+}
+
+// From the result of decoding process, execute the program accordingly
+void execute_instruction(stCpu_state *cpu, stInstruction instr, const stCpu_io *io) {
+    uint8_t opcode_decoded = instr.opcode;
+    uint8_t operand_decoded = instr.operand;
+    uint8_t select_bit = (instr.operand & 0x04) >> 2;
+
+    Register reg_H = (Register)((operand_decoded & 0x0C) >> 2);          // Take the first two bits ("higher") of the 4-bit LSB
+    Register reg_L = (Register)(operand_decoded & 0x03);                 // Take the last two bits ("lower") of the 4-bit LSB
+
+    switch (opcode_decoded) {
+
+        case mem_to_r0_1:
+        case mem_to_r0_2:                           // transfer data from RAM to register
+            instr_mem_to_r0(cpu, reg_L, select_bit, io);
+            break;
+
+        case r0_to_ram_1:
+        case r0_to_ram_2:                           // transfer data from register to RAM
+            instr_r0_to_ram(cpu, reg_L, io);
+            break;
+
+        case rx_to_ry:                              // transfer data between 2 register
+            instr_transfer_reg(cpu, reg_H, reg_L);
+            break;
+        case set_value_r0:                          // set value for register
+            instr_immediate_set(cpu, operand_decoded);
+            break;
+        case add_ry_to_rx:                          // add 2 register
+            instr_add(cpu, reg_H, reg_L, io);
+            break;
+
+        case substract_ry_by_rx:                        // substract 2 register
+            instr_sub(cpu, reg_H, reg_L, io);
+            break;
+        case shift_left:                                // shift left
+            instr_shift_left(cpu, reg_H);
+            break;
+
+        case shift_right:                               // shift right
+            instr_shift_right(cpu, reg_H);
+            break;
+
+        case compare_rx_with_zero_1:
+        case compare_rx_with_zero_2:                    // compare rx with zero
+            instr_compare(cpu, reg_H);
+            break;
+
+        case output_external:                           // output external
+            instr_output(cpu, reg_H, io);
+            break;
+
+        case input_external:                            // input external
+            instr_input(cpu, reg_H, io);
+            break;
+
+        case condition_jump:                             // jump with condition
+            instr_cond_branch(cpu, reg_H);
+            break;
+
+        case uncondition_jump:                          // jump with uncondition
+            instr_uncond_branch(cpu, reg_H);
+            break;
+    }
+}
+
+// Run one instruction cycle
+bool step_cpu(stCpu_state *cpu, const stCpu_io *io) {
+    if (cpu->halt != HALT_NONE) {
+        return false;
+    }
+    fetch_instruction(cpu);                                     // fetching
+    execute_instruction(cpu, decode_instruction(cpu), io);      // decoding, executing
+    return cpu->halt == HALT_NONE;
+}
+
+// Run the CPU until it halts or the step budget is exhausted
+uint64_t run_cpu(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps) {
+    uint64_t steps = 0;
+    while (cpu->halt == HALT_NONE) {
+        if (max_steps != 0 && steps >= max_steps) {
+            cpu->halt = HALT_STEP_LIMIT;
+            break;
+        }
+        fetch_instruction(cpu);
+        execute_instruction(cpu, decode_instruction(cpu), io);
+        steps++;
+    }
+    return steps;
+}
+
+// transfer data from memory[value_rx] to r0 (read data from memory)
+// The memory space stretches from memory[0] belong to memory[255]
+static void instr_mem_to_r0(stCpu_state *cpu, Register rx, uint8_t select_bit, const stCpu_io *io) {
+    uint8_t address_read_data = get_register_value(cpu, rx);     // region for reading: from memory index: 0x00 to 0xFF (all of area memory)
+    uint8_t read_data;
+
+    // check if the address is within valid memory bounds
+    // if select bit = 0, access the ROM part of memory
+    if (select_bit == 0) {
+        if (address_read_data < ROM_SIZE) {
+            read_data = cpu->memory[address_read_data];
+        }
+        else {
+            cpu_message(io, "ROM access out of bounds.\n");
+            cpu->halt = HALT_ROM_READ;
+            return;
+        }
+    }
+    // if select bit = 1, access the RAM part of memory
+    else {
+        if (address_read_data >= ROM_SIZE) {
+            read_data = cpu->memory[address_read_data];
+        }
+        else {
+            cpu_message(io, "RAM access out of bounds.\n");
+            cpu->halt = HALT_RAM_READ;
+            return;
+        }
+    }
+    PROFILE_READ(gCpu_profile, address_read_data);
+    set_register_value(cpu, REG_0, read_data);                    // read data to register 0
+    update_zero_flag(cpu, read_data);
+}
+
+// transfer data from r0 to RAM[rx]
+static void instr_r0_to_ram(stCpu_state *cpu, Register rx, const stCpu_io *io) {
+    uint8_t address_write_data = (get_register_value(cpu, rx)) % 128 + 0x80;  // define the location for write data to, limit the offset
+    uint8_t write_data = get_register_value(cpu, REG_0);                        // get data stored in register 0
+
+    // ensure the address is within RAM bounds (0x80 to 0xFF)
+    if (address_write_data >= ROM_SIZE) {
+        cpu->memory[address_write_data] = write_data;                           // write data to the defined location
+        PROFILE_WRITE(gCpu_profile, address_write_data);
+        update_zero_flag(cpu, write_data);
+    }
+    else {
+        cpu_message(io, "Out of RAM store!\n");
+        cpu->halt = HALT_RAM_STORE;
+    }
+}
+
+// transfer data between 2 registers
+static void instr_transfer_reg(stCpu_state *cpu, Register rx, Register ry) {
+    uint8_t value_rx = get_register_value(cpu, rx);
+    set_register_value(cpu, ry, value_rx);
+    update_zero_flag(cpu, value_rx);
+}
+
+// set immediate value into r0
+static void instr_immediate_set(stCpu_state *cpu, uint8_t value) {
+    set_register_value(cpu, REG_0, value);
+    update_zero_flag(cpu, value);
+}
+
+// addition rx and ry and then store the result in rx
+static void instr_add(stCpu_state *cpu, Register rx, Register ry, const stCpu_io *io) {
+    uint8_t value_rx = get_register_value(cpu, rx);
+    uint8_t value_ry = get_register_value(cpu, ry);
+    int16_t result = value_rx + value_ry;
+    // if the result can't represented by 8 bits, i.e. overflow is occur,
+    // then the result should be truncated to 8-bit LSB of result
+    uint8_t result_truncated = (uint8_t)(result & 0xFF);
+    if (result > 0xFF) {      // result exceeds 0xFF
+        set_register_value(cpu, rx, result_truncated);
+        cpu->status |= STATUS_OF;        // update the Overflow flag
+        cpu_message(io, "\nOverflow occurs in addition operation!\n");
+    }
+    else {   // result didn't exceed 0xFF
+        set_register_value(cpu, rx, result_truncated);
+        update_zero_flag(cpu, result_truncated);
+        cpu->status &= ~STATUS_OF;
+    }
+}
+
+// substract rx and ry then store the result in rx
+static void instr_sub(stCpu_state *cpu, Register rx, Register ry, const stCpu_io *io) {
+    uint8_t value_rx = get_register_value(cpu, rx);
+    uint8_t value_ry = get_register_value(cpu, ry);
+    int16_t result = value_rx - value_ry;
+    uint8_t result_truncated = (uint8_t)(result & 0xFF);
+    if (result < 0) {
+        set_register_value(cpu, rx, result_truncated);
+        cpu->status |= STATUS_OF;
+        cpu_message(io, "\nOverflow occurs in subtraction operation!\n");
+    }
+    else {
+        set_register_value(cpu, rx, result_truncated);
+        update_zero_flag(cpu, result_truncated);
+        cpu->status &= ~STATUS_OF;
+    }
+}
+
+// shift left rx 4 bits
+static void instr_shift_left(stCpu_state *cpu, Register rx) {
+    uint8_t value_rx = get_register_value(cpu, rx);
+    value_rx <<= 4;
+    set_register_value(cpu, rx, value_rx);
+}
+
+// shift right rx 4 bits
+static void instr_shift_right(stCpu_state *cpu, Register rx) {
+    uint8_t value_rx = get_register_value(cpu, rx);
+    value_rx >>= 4;
+    set_register_value(cpu, rx, value_rx);
+}
+
+// compare rx with zero
+static void instr_compare(stCpu_state *cpu, Register rx) {
+    uint8_t value_rx = get_register_value(cpu, rx);
+    update_zero_flag(cpu, value_rx);
+}
+
+// external the last ouput
+static void instr_output(stCpu_state *cpu, Register rx, const stCpu_io *io) {
+    uint8_t value_rx = get_register_value(cpu, rx);
+    io->output(io->ctx, value_rx);
+    cpu->halt = HALT_OUTPUT;            // exit program
+}
+
+// external input
+static void instr_input(stCpu_state *cpu, Register rx, const stCpu_io *io) {
+    uint8_t value = io->input(io->ctx);
+    set_register_value(cpu, rx, value);
+}
+
+// condition branch (if ZF set then rx -> PC)
+// PC is 8 bits wide, so every branch location is inside the memory
+static void instr_cond_branch(stCpu_state *cpu, Register rx) {
+    uint8_t index_branch_to = get_register_value(cpu, rx);
+    PROFILE_BRANCH(gCpu_profile, cpu->PC - 1, cpu->status & STATUS_ZERO);
+    if (cpu->status & STATUS_ZERO) {
+        cpu->PC = index_branch_to;
+    }
+}
+
+// unconditional branch (rx ->PC)
+static void instr_uncond_branch(stCpu_state *cpu, Register rx) {
+    cpu->PC = get_register_value(cpu, rx);
+}
+
+// get value stored in register
+uint8_t get_register_value(const stCpu_state *cpu, Register reg) {
+    switch (reg) {
+        case REG_0: return cpu->r0;
+        case REG_1: return cpu->r1;
+        case REG_2: return cpu->r2;
+        case REG_3: return cpu->r3;
+    }
+    return 0;
+}
+
+// write a value into register
+void set_register_value(stCpu_state *cpu, Register reg, uint8_t value) {
+    switch (reg) {
+        case REG_0: cpu->r0 = value; break;
+        case REG_1: cpu->r1 = value; break;
+        case REG_2: cpu->r2 = value; break;
+        case REG_3: cpu->r3 = value; break;
+    }
+}
+
+// function for update ZF bit
+static void update_zero_flag(stCpu_state *cpu, uint8_t value) {
+    if (value == 0) {
+        cpu->status |= STATUS_ZERO;
+    } else {
+        cpu->status &= ~STATUS_ZERO;
+    }
+}
+
+
+//---------------------------
+// Buffer backend
+
+static uint8_t cpu_buffer_input(void *ctx) {
+    stCpu_buffer *buffer = (stCpu_buffer *)ctx;
+    if (buffer->in_pos >= buffer->in_len) {
+        return 0;
+    }
+    return buffer->in[buffer->in_pos++];
+}
+
+static void cpu_buffer_output(void *ctx, uint8_t value) {
+    stCpu_buffer *buffer = (stCpu_buffer *)ctx;
+    if (buffer->out_len < buffer->out_cap) {
+        buffer->out[buffer->out_len] = value;
+    }
+    buffer->out_len++;
+}
+
+// Set up "io" to read inputs from "in" and append outputs to "out"
+void cpu_buffer_io(stCpu_io *io, stCpu_buffer *buffer,
+                   const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap) {
+    buffer->in = in;
+    buffer->in_len = in_len;
+    buffer->in_pos = 0;
+    buffer->out = out;
+    buffer->out_cap = out_cap;
+    buffer->out_len = 0;
+    io->ctx = buffer;
+    io->input = cpu_buffer_input;
+    io->output = cpu_buffer_output;
+    io->message = NULL;
+}
@@ -0,0 +1,133 @@
+#ifndef CPU_CORE_H
+#define CPU_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Emulator core of the 8-bit CPU (same ISA as original.c), without any
+// dependency on the Pico SDK. Input and output go through a stCpu_io
+// backend so the same core runs on the Pico (cpu_pico.c) and on a Linux
+// host (cpu_host.c).
+//
+// Host build: gcc -O2 cpu_*.c -o cpu_host (all files except cpu_pico.c),
+// plus cpu_template.cpp (and, for cpu_host, cpu_host_wide16.cpp) compiled
+// with g++ -std=c++17
+
+#define ROM_SIZE        (128)
+#define RAM_SIZE        (128)
+#define MEM_SIZE        (256)
+
+#define STATUS_ZERO     (0x01)   // ZF specified by LSB bit
+#define STATUS_OF       (0x02)   // OF specified by the second LSB bit
+#define STATUS_FAULT    (0x04)   // sticky: a masked read left its ROM/RAM half
+
+// Define opcodes
+#define mem_to_r0_1                 (0x0)
+#define mem_to_r0_2                 (0x1)
+#define r0_to_ram_1                 (0x2)
+#define r0_to_ram_2                 (0x3)
+#define rx_to_ry                    (0x4)
+#define set_value_r0                (0x5)
+#define add_ry_to_rx                (0x6)
+#define substract_ry_by_rx          (0x7)
+#define shift_left                  (0x8)
+#define shift_right                 (0x9)
+#define compare_rx_with_zero_1      (0xA)
+#define compare_rx_with_zero_2      (0xB)
+#define output_external             (0xC)
+#define input_external              (0xD)
+#define condition_jump              (0xE)
+#define uncondition_jump            (0xF)
+
+// Reason why the CPU stopped (stCpu_state.halt), HALT_NONE while running
+#define HALT_NONE           (0)
+#define HALT_OUTPUT         (1)     // output_external ends the program
+#define HALT_ROM_READ       (2)     // mem_to_r0 with select bit 0 outside ROM
+#define HALT_RAM_READ       (3)     // mem_to_r0 with select bit 1 outside RAM
+#define HALT_RAM_STORE      (4)     // r0_to_ram outside RAM
+#define HALT_STEP_LIMIT     (5)     // stopped by the caller's step budget
+
+typedef enum {
+    REG_0,
+    REG_1,
+    REG_2,
+    REG_3
+} Register;
+
+// Structure of CPU
+typedef struct cpu_state{
+    uint8_t PC;
+    uint8_t r0;
+    uint8_t r1;
+    uint8_t r2;
+    uint8_t r3;
+    uint8_t status;
+    uint8_t instruction;
+    uint8_t halt;
+    uint8_t memory[MEM_SIZE];
+} stCpu_state;
+
+// Components of an instruction
+typedef struct inst{
+    uint8_t opcode;
+    uint8_t operand;
+} stInstruction;
+
+// I/O backend of the CPU. "message" receives the diagnostics (overflow,
+// out of bounds) and may be NULL to drop them.
+typedef struct cpu_io{
+    void *ctx;
+    uint8_t (*input)(void *ctx);
+    void (*output)(void *ctx, uint8_t value);
+    void (*message)(void *ctx, const char *text);
+} stCpu_io;
+
+// Buffer backend: inputs are taken from "in" (0 once exhausted), outputs
+// are appended to "out" (dropped once full, but still counted in out_len)
+typedef struct cpu_buffer{
+    const uint8_t *in;
+    size_t in_len;
+    size_t in_pos;
+    uint8_t *out;
+    size_t out_cap;
+    size_t out_len;
+} stCpu_buffer;
+
+//----------------------------------
+// -------Function prototype--------
+
+// CPU implementer function
+void initialize_cpu(stCpu_state *cpu);
+void load_program(stCpu_state *cpu, const uint8_t *program, size_t len);
+void load_addition_program(stCpu_state *cpu);
+void load_factorial_program(stCpu_state *cpu);
+void fetch_instruction(stCpu_state *cpu);
+stInstruction decode_instruction(const stCpu_state *cpu);
+void execute_instruction(stCpu_state *cpu, stInstruction instr, const stCpu_io *io);
+
+// Run one fetch/decode/execute cycle, return false once the CPU is halted
+bool step_cpu(stCpu_state *cpu, const stCpu_io *io);
+// Run until halt or until max_steps instructions (0 = no limit), return the
+// number of executed instructions
+uint64_t run_cpu(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps);
+// Same as run_cpu, with threaded dispatch (cpu_threaded.c)
+uint64_t run_cpu_threaded(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps);
+// Same as run_cpu, on the templated C++ core (cpu_template.cpp)
+uint64_t run_cpu_template(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps);
+// Fast mode of the templated core: a mem_to_r0 outside the half named by
+// its select bit reads the masked address (% 128, + 0x80 for RAM) and sets
+// the sticky STATUS_FAULT instead of halting with a message
+uint64_t run_cpu_masked(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps);
+// Same as run_cpu_template with lazy flags: the hot loop keeps the last ZF
+// result and OF apart and only builds status when the CPU stops
+uint64_t run_cpu_lazy(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps);
+
+uint8_t get_register_value(const stCpu_state *cpu, Register reg);
+void set_register_value(stCpu_state *cpu, Register reg, uint8_t value);
+
+// Buffer backend
+void cpu_buffer_io(stCpu_io *io, stCpu_buffer *buffer,
+                   const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap);
+
+#endif // CPU_CORE_H
@@ -0,0 +1,287 @@
+#ifndef CPU_CORE_HPP
+#define CPU_CORE_HPP
+
+// C++ core of the ISA, templated on memory size, word width, register count
+// and bounds-check policy. original.c, test7.c/tets8.c, test9.c, test10.c
+// and factorial_cal.c each carry their own copy of the same instruction set;
+// this is the one implementation meant to replace them. Each configuration
+// is a type whose parameters are compile-time constants, so the policy
+// branches (if constexpr) and the masks fold away and every configuration
+// gets its own straight hot loop.
+//
+// Instruction layout for a W-bit word: opcode in the top 4 bits, then the
+// reg_H and reg_L fields of (W - 4) / 2 bits each; the select bit of
+// mem_to_r0 is the lowest bit of reg_H, set_value_r0 takes the W - 4 low
+// bits as immediate and the shifts move by W / 2 bits. With W = 8 this is
+// exactly the encoding of original.c. The lower half of the memory is ROM,
+// the upper half RAM.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+extern "C" {
+#include "cpu_core.h"   // opcodes, STATUS_* and HALT_* values
+}
+
+namespace cpu {
+
+// What mem_to_r0 does with an address outside the half its select bit names
+enum class Bounds {
+    checked,        // halt with HALT_ROM_READ / HALT_RAM_READ, like original.c
+    masked,         // mask the address into the selected half and set the
+                    // sticky STATUS_FAULT bit instead of halting: no branch
+    unchecked,      // read wherever it points: the program is trusted
+};
+
+// How the interpreter keeps ZF and OF
+enum class Flags {
+    eager,          // update status after every instruction, like original.c
+    lazy,           // keep the last ZF result and OF apart, build status on exit
+};
+
+template <typename Word, std::size_t MemorySize, unsigned Registers, Bounds Policy,
+          Flags FlagPolicy = Flags::eager>
+struct Config {
+    using word = Word;
+
+    static constexpr unsigned word_bits = std::numeric_limits<Word>::digits;
+    static constexpr std::size_t memory_size = MemorySize;
+    static constexpr std::size_t rom_size = MemorySize / 2;
+    static constexpr std::size_t ram_size = MemorySize - rom_size;
+    static constexpr unsigned registers = Registers;
+    static constexpr Bounds bounds = Policy;
+    static constexpr Flags flags = FlagPolicy;
+
+    static constexpr unsigned field_bits = (word_bits - 4) / 2;
+    static constexpr Word field_mask = Word(Registers - 1);
+    static constexpr Word immediate_mask = Word((Word(1) << (word_bits - 4)) - 1);
+    static constexpr Word address_mask = Word(MemorySize - 1);
+    static constexpr unsigned shift = word_bits / 2;
+
+    static_assert(std::is_unsigned<Word>::value, "the word is an unsigned type");
+    static_assert(word_bits >= 8, "room for the opcode and two register fields");
+    static_assert(MemorySize >= 2 && (MemorySize & (MemorySize - 1)) == 0,
+                  "the memory size is a power of two");
+    static_assert(MemorySize - 1 <= std::numeric_limits<Word>::max(),
+                  "every address fits in a word");
+    static_assert(Registers >= 1 && (Registers & (Registers - 1)) == 0
+                  && Registers <= (1u << field_bits),
+                  "the register count is a power of two that a field can name");
+};
+
+// original.c / cpu_core.c
+using Original8 = Config<std::uint8_t, 256, 4, Bounds::checked>;
+// same machine for trusted programs, without the read checks
+using Trusted8 = Config<std::uint8_t, 256, 4, Bounds::unchecked>;
+// same machine with branch-free reads: faults only set STATUS_FAULT
+using Masked8 = Config<std::uint8_t, 256, 4, Bounds::masked>;
+// original.c with lazy flags
+using Lazy8 = Config<std::uint8_t, 256, 4, Bounds::checked, Flags::lazy>;
+// 16-bit words: 64K words of memory, 16 registers, 12-bit immediates
+using Wide16 = Config<std::uint16_t, 65536, 16, Bounds::checked>;
+
+template <class C>
+struct State {
+    using word = typename C::word;
+
+    word PC;
+    word reg[C::registers];
+    std::uint8_t status;
+    word instruction;
+    std::uint8_t halt;
+    word memory[C::memory_size];
+
+    void reset() {
+        std::memset(this, 0, sizeof(*this));
+    }
+};
+
+// I/O backend over the C stCpu_io
+struct CIo {
+    const stCpu_io *io;
+
+    std::uint8_t input() { return io->input(io->ctx); }
+    void output(std::uint8_t value) { io->output(io->ctx, value); }
+    void message(const char *text) {
+        if (io->message != nullptr) {
+            io->message(io->ctx, text);
+        }
+    }
+};
+
+// Run until halt or until max_steps instructions (0 = no limit), return the
+// number of executed instructions. Io provides input(), output(word) and
+// message(const char *).
+template <class C, class Io>
+std::uint64_t run(State<C> &cpu, Io &io, std::uint64_t max_steps) {
+    using word = typename C::word;
+
+    word *memory = cpu.memory;
+    word reg[C::registers];
+    word PC = cpu.PC;
+    word instruction = cpu.instruction;
+    std::uint8_t status = cpu.status;
+    std::uint8_t halt = cpu.halt;
+    std::uint64_t steps = 0;
+    const std::uint64_t limit = (max_steps != 0) ? max_steps : UINT64_MAX;
+
+    std::memcpy(reg, cpu.reg, sizeof(reg));
+
+    // Lazy flags: ZF is (zf_result == 0) and OF is "overflow"; status only
+    // holds the other bits until the CPU stops. Eager flags live in status.
+    constexpr bool lazy = (C::flags == Flags::lazy);
+    word zf_result = (status & STATUS_ZERO) ? 0 : 1;
+    bool overflow = (status & STATUS_OF) != 0;
+
+    auto set_zf = [&](word value) {
+        if constexpr (lazy) {
+            zf_result = value;
+        }
+        else {
+            status = std::uint8_t((status & ~STATUS_ZERO) | (value == 0 ? STATUS_ZERO : 0));
+        }
+    };
+    auto set_of = [&](bool value) {
+        if constexpr (lazy) {
+            overflow = value;
+        }
+        else if (value) {
+            status |= STATUS_OF;
+        }
+        else {
+            status &= ~STATUS_OF;
+        }
+    };
+
+    while (halt == HALT_NONE) {
+        if (steps == limit) {
+            halt = HALT_STEP_LIMIT;
+            break;
+        }
+        instruction = memory[PC];
+        PC = word((PC + 1) & C::address_mask);
+        steps++;
+
+        const word operand = word(instruction & C::immediate_mask);
+        word &rH = reg[(operand >> C::field_bits) & C::field_mask];
+        word &rL = reg[operand & C::field_mask];
+
+        switch (instruction >> (C::word_bits - 4)) {
+        case mem_to_r0_1:
+        case mem_to_r0_2: {
+            const bool select = ((operand >> C::field_bits) & 1) != 0;
+            word address = rL;
+            if constexpr (C::bounds == Bounds::checked) {
+                if (!select && address >= C::rom_size) {
+                    io.message("ROM access out of bounds.\n");
+                    halt = HALT_ROM_READ;
+                    continue;
+                }
+                if (select && address < C::rom_size) {
+                    io.message("RAM access out of bounds.\n");
+                    halt = HALT_RAM_READ;
+                    continue;
+                }
+                address = word(address & C::address_mask);
+            }
+            else if constexpr (C::bounds == Bounds::masked) {
+                const bool fault = (word(address & C::address_mask) >= C::rom_size) != select;
+                status |= std::uint8_t(STATUS_FAULT * fault);
+                address = word((address & (C::rom_size - 1)) | (C::rom_size * select));
+            }
+            else {
+                address = word(address & C::address_mask);
+            }
+            reg[0] = memory[address];
+            set_zf(reg[0]);
+            break;
+        }
+        case r0_to_ram_1:
+        case r0_to_ram_2:
+            memory[C::rom_size + rL % C::ram_size] = reg[0];
+            set_zf(reg[0]);
+            break;
+        case rx_to_ry: {
+            const word value = rH;
+            rL = value;
+            set_zf(value);
+            break;
+        }
+        case set_value_r0:
+            reg[0] = operand;
+            set_zf(reg[0]);
+            break;
+        case add_ry_to_rx: {
+            const word result = word(rH + rL);
+            const bool carry = result < rH;
+            rH = result;
+            if (carry) {
+                set_of(true);
+                io.message("\nOverflow occurs in addition operation!\n");
+            }
+            else {
+                set_zf(result);
+                set_of(false);
+            }
+            break;
+        }
+        case substract_ry_by_rx: {
+            const bool borrow = rH < rL;
+            const word result = word(rH - rL);
+            rH = result;
+            if (borrow) {
+                set_of(true);
+                io.message("\nOverflow occurs in subtraction operation!\n");
+            }
+            else {
+                set_zf(result);
+                set_of(false);
+            }
+            break;
+        }
+        case shift_left:
+            rH = word(rH << C::shift);
+            break;
+        case shift_right:
+            rH = word(rH >> C::shift);
+            break;
+        case compare_rx_with_zero_1:
+        case compare_rx_with_zero_2:
+            set_zf(rH);
+            break;
+        case output_external:
+            io.output(rH);
+            halt = HALT_OUTPUT;
+            break;
+        case input_external:
+            rH = io.input();
+            break;
+        case condition_jump:
+            if (lazy ? zf_result == 0 : (status & STATUS_ZERO) != 0) {
+                PC = word(rH & C::address_mask);
+            }
+            break;
+        case uncondition_jump:
+            PC = word(rH & C::address_mask);
+            break;
+        }
+    }
+
+    if constexpr (lazy) {
+        status = std::uint8_t((status & ~(STATUS_ZERO | STATUS_OF))
+                              | (zf_result == 0 ? STATUS_ZERO : 0) | (overflow ? STATUS_OF : 0));
+    }
+    cpu.PC = PC;
+    std::memcpy(cpu.reg, reg, sizeof(reg));
+    cpu.status = status;
+    cpu.instruction = instruction;
+    cpu.halt = halt;
+    return steps;
+}
+
+} // namespace cpu
+
+#endif // CPU_CORE_HPP
@@ -0,0 +1,122 @@
+#include "cpu_dual.h"
+#include <string.h>
+
+void dual_fifo_init(stDual_fifo *fifo) {
+    memset(fifo->entry, 0, sizeof(fifo->entry));
+    atomic_init(&fifo->head, 0);
+    atomic_init(&fifo->tail, 0);
+}
+
+static bool dual_fifo_full(stDual_fifo *fifo) {
+    uint32_t head = atomic_load_explicit(&fifo->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&fifo->tail, memory_order_acquire);
+    return head - tail == DUAL_FIFO_SIZE;
+}
+
+bool dual_fifo_push(stDual_fifo *fifo, const stDual_entry *entry) {
+    uint32_t head = atomic_load_explicit(&fifo->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&fifo->tail, memory_order_acquire);
+    if (head - tail == DUAL_FIFO_SIZE) {
+        return false;
+    }
+    fifo->entry[head % DUAL_FIFO_SIZE] = *entry;
+    atomic_store_explicit(&fifo->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool dual_fifo_pop(stDual_fifo *fifo, stDual_entry *entry) {
+    uint32_t tail = atomic_load_explicit(&fifo->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&fifo->head, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    *entry = fifo->entry[tail % DUAL_FIFO_SIZE];
+    atomic_store_explicit(&fifo->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static void dual_idle(const stDual_io *dual) {
+    if (dual->idle != NULL) {
+        dual->idle();
+    }
+}
+
+// compute core side of the backend: wait while the FIFO is empty / full
+static uint8_t dual_input(void *ctx) {
+    stDual_io *dual = ctx;
+    stDual_entry entry;
+    if (!dual_fifo_pop(&dual->in, &entry)) {
+        dual->input_waits++;
+        while (!dual_fifo_pop(&dual->in, &entry)) {
+            dual_idle(dual);
+        }
+    }
+    return entry.value;
+}
+
+static void dual_send(stDual_io *dual, uint8_t kind, uint8_t value, const char *text) {
+    stDual_entry entry = { kind, value, text };
+    while (!dual_fifo_push(&dual->out, &entry)) {
+        dual_idle(dual);
+    }
+}
+
+static void dual_output(void *ctx, uint8_t value) {
+    dual_send(ctx, DUAL_OUTPUT, value, NULL);
+}
+
+static void dual_message(void *ctx, const char *text) {
+    dual_send(ctx, DUAL_MESSAGE, 0, text);
+}
+
+void dual_io_init(stDual_io *dual, stCpu_io *io, void (*idle)(void)) {
+    dual_fifo_init(&dual->in);
+    dual_fifo_init(&dual->out);
+    dual->idle = idle;
+    atomic_init(&dual->finished, false);
+    dual->input_waits = 0;
+    io->ctx = dual;
+    io->input = dual_input;
+    io->output = dual_output;
+    io->message = dual_message;
+}
+
+void dual_io_finish(stDual_io *dual) {
+    atomic_store_explicit(&dual->finished, true, memory_order_release);
+}
+
+bool dual_io_service(stDual_io *dual, const stDual_device *device) {
+    // read "finished" first: every output pushed before it is drained below
+    bool finished = atomic_load_explicit(&dual->finished, memory_order_acquire);
+    stDual_entry entry;
+    while (dual_fifo_pop(&dual->out, &entry)) {
+        if (entry.kind == DUAL_OUTPUT) {
+            device->output(device->ctx, entry.value);
+        }
+        else if (device->message != NULL) {
+            device->message(device->ctx, entry.text);
+        }
+    }
+    if (finished) {
+        return false;
+    }
+    // only poll when the byte has somewhere to go
+    if (!dual_fifo_full(&dual->in)) {
+        int c = device->poll(device->ctx);
+        if (c >= 0) {
+            stDual_entry input = { DUAL_INPUT, (uint8_t)c, NULL };
+            dual_fifo_push(&dual->in, &input);
+        }
+    }
+    return true;
+}
+
+void dual_core_run(stDual_core *core) {
+    if (core->timing != NULL) {
+        core->steps = run_cpu_timed(core->cpu, core->io, core->timing, core->max_steps);
+    }
+    else {
+        core->steps = run_cpu(core->cpu, core->io, core->max_steps);
+    }
+    atomic_store_explicit(&core->done, true, memory_order_release);
+}
@@ -0,0 +1,90 @@
+#ifndef CPU_DUAL_H
+#define CPU_DUAL_H
+
+#include <stdatomic.h>
+#include "cpu_core.h"
+#include "cpu_timing.h"
+
+// Dual-core execution for the RP2040 (multicore_launch_core1), written
+// against plain C11 atomics so the host runs the same code with a thread
+// standing in for each core.
+//
+// DUAL_IO splits I/O from compute. The compute core runs the CPU on a
+// stCpu_io whose input_external pops the next byte from an input FIFO and
+// whose output_external and messages push to an output FIFO. The I/O core
+// polls the console without blocking, fills the input FIFO and writes out
+// what the output FIFO holds. A slow console or a read timeout then never
+// stalls the compute core; it only waits when the program needs an input
+// byte that has not been typed yet.
+//
+// DUAL_PAIR runs two independent CPUs, one per core (dual_core_run).
+//
+// The FIFOs are single producer / single consumer rings of fixed size
+// with only loads and stores on their indices, so they need no lock and no
+// atomic read-modify-write (which the Cortex-M0+ does not have).
+
+#define DUAL_IO         (1)
+#define DUAL_PAIR       (2)
+
+#define DUAL_FIFO_SIZE  (64)        // entries, a power of two
+
+#define DUAL_INPUT      (0)         // input byte (I/O core -> compute core)
+#define DUAL_OUTPUT     (1)         // output_external value
+#define DUAL_MESSAGE    (2)         // diagnostic, "text" is a string literal
+
+typedef struct dual_entry{
+    uint8_t kind;
+    uint8_t value;
+    const char *text;
+} stDual_entry;
+
+typedef struct dual_fifo{
+    stDual_entry entry[DUAL_FIFO_SIZE];
+    _Atomic uint32_t head;          // next entry the producer writes
+    _Atomic uint32_t tail;          // next entry the consumer reads
+} stDual_fifo;
+
+// Console of the I/O core: poll returns the next input byte or -1 if none
+// is ready, and must not block
+typedef struct dual_device{
+    void *ctx;
+    int (*poll)(void *ctx);
+    void (*output)(void *ctx, uint8_t value);
+    void (*message)(void *ctx, const char *text);
+} stDual_device;
+
+typedef struct dual_io{
+    stDual_fifo in;
+    stDual_fifo out;
+    void (*idle)(void);             // called while a core waits on a FIFO
+    _Atomic bool finished;          // the compute core has halted
+    uint64_t input_waits;           // input_external found the FIFO empty
+} stDual_io;
+
+// One core of DUAL_PAIR
+typedef struct dual_core{
+    stCpu_state *cpu;
+    const stCpu_io *io;
+    stCpu_timing *timing;           // NULL runs the CPU as fast as possible
+    uint64_t max_steps;
+    uint64_t steps;
+    _Atomic bool done;
+} stDual_core;
+
+void dual_fifo_init(stDual_fifo *fifo);
+// Return false if the FIFO is full / empty
+bool dual_fifo_push(stDual_fifo *fifo, const stDual_entry *entry);
+bool dual_fifo_pop(stDual_fifo *fifo, stDual_entry *entry);
+
+// Set up the FIFOs and "io" for the compute core. idle may be NULL.
+void dual_io_init(stDual_io *dual, stCpu_io *io, void (*idle)(void));
+// Compute core: call once the CPU running on the FIFO backend has halted
+void dual_io_finish(stDual_io *dual);
+// I/O core: one pass over the device and the FIFOs. Return false once the
+// compute core has finished and every output has been written.
+bool dual_io_service(stDual_io *dual, const stDual_device *device);
+
+// DUAL_PAIR: run core->cpu to halt or max_steps, then set core->done
+void dual_core_run(stDual_core *core);
+
+#endif // CPU_DUAL_H
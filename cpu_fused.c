@@ -0,0 +1,477 @@
+#include "cpu_fused.h"
+#include <string.h>
+
+// handler index of candidate i
+#define FUSED_HANDLER(candidate)    (16 + (candidate))
+
+typedef struct fusion_candidate{
+    const char *name;
+    uint8_t length;
+    uint8_t handler[FUSED_MAX_LENGTH];      // UOP_* of each instruction
+} stFusion_candidate;
+
+static const stFusion_candidate gCandidates[FUSE_COUNT] = {
+    [FUSE_SET_COND_JUMP]            = { "set+cond_jump",            2, { UOP_SET, UOP_COND_JUMP } },
+    [FUSE_SET_UNCOND_JUMP]          = { "set+jump",                 2, { UOP_SET, UOP_UNCOND_JUMP } },
+    [FUSE_SET_SUB]                  = { "set+sub",                  2, { UOP_SET, UOP_SUB } },
+    [FUSE_SET_ADD]                  = { "set+add",                  2, { UOP_SET, UOP_ADD } },
+    [FUSE_SET_TRANSFER]             = { "set+transfer",             2, { UOP_SET, UOP_TRANSFER } },
+    [FUSE_SET_SHIFT_LEFT]           = { "set+shl",                  2, { UOP_SET, UOP_SHIFT_LEFT } },
+    [FUSE_SET_SHIFT_LEFT_JUMP]      = { "set+shl+jump",             3, { UOP_SET, UOP_SHIFT_LEFT, UOP_UNCOND_JUMP } },
+    [FUSE_SET_SHIFT_LEFT_TEST_JUMP] = { "set+shl+compare+cond_jump", 4,
+                                        { UOP_SET, UOP_SHIFT_LEFT, UOP_COMPARE, UOP_COND_JUMP } },
+    [FUSE_SET_TEST_JUMP]            = { "set+compare+cond_jump",    3, { UOP_SET, UOP_COMPARE, UOP_COND_JUMP } },
+    [FUSE_ADD_SET_SUB]              = { "add+set+sub",              3, { UOP_ADD, UOP_SET, UOP_SUB } },
+    [FUSE_SUB_SET_JUMP]             = { "sub+set+jump",             3, { UOP_SUB, UOP_SET, UOP_UNCOND_JUMP } },
+    [FUSE_TRANSFER_SET_SUB]         = { "transfer+set+sub",         3, { UOP_TRANSFER, UOP_SET, UOP_SUB } },
+};
+
+const char *fusion_name(int candidate) {
+    return (candidate >= 0 && candidate < FUSE_COUNT) ? gCandidates[candidate].name : "?";
+}
+
+uint64_t fusion_profile_run(stFusion_profile *profile, stCpu_state *cpu,
+                            const stCpu_io *io, uint64_t max_steps) {
+    // the last FUSED_MAX_LENGTH executed instructions, newest first
+    uint8_t history_pc[FUSED_MAX_LENGTH] = { 0 };
+    uint8_t history_op[FUSED_MAX_LENGTH] = { 0 };
+    int history = 0;                // straight-line ROM instructions in the history
+    uint64_t steps = 0;
+
+    while (cpu->halt == HALT_NONE) {
+        if (max_steps != 0 && steps >= max_steps) {
+            cpu->halt = HALT_STEP_LIMIT;
+            break;
+        }
+        uint8_t pc = cpu->PC;
+        uint8_t instruction = cpu->memory[pc];
+        step_cpu(cpu, io);
+        steps++;
+
+        // a sequence is only kept across adjacent ROM addresses
+        if (pc >= ROM_SIZE) {
+            history = 0;
+            continue;
+        }
+        if (history > 0 && pc != (uint8_t)(history_pc[0] + 1)) {
+            history = 0;
+        }
+        memmove(&history_pc[1], &history_pc[0], FUSED_MAX_LENGTH - 1);
+        memmove(&history_op[1], &history_op[0], FUSED_MAX_LENGTH - 1);
+        history_pc[0] = pc;
+        history_op[0] = predecode_instruction(instruction).handler;
+        if (history < FUSED_MAX_LENGTH) {
+            history++;
+        }
+
+        uint8_t opcode = instruction >> 4;
+        profile->single[opcode]++;
+        if (history >= 2) {
+            profile->pair[cpu->memory[history_pc[1]] >> 4][opcode]++;
+        }
+        if (history >= 3) {
+            profile->triple[cpu->memory[history_pc[2]] >> 4][cpu->memory[history_pc[1]] >> 4][opcode]++;
+        }
+        // a candidate counts once its whole sequence ran
+        for (int c = 0; c < FUSE_COUNT; c++) {
+            const stFusion_candidate *candidate = &gCandidates[c];
+            int length = candidate->length;
+            if (history < length) {
+                continue;
+            }
+            int k = 0;
+            while (k < length && history_op[length - 1 - k] == candidate->handler[k]) {
+                k++;
+            }
+            if (k == length) {
+                profile->candidate[c]++;
+            }
+        }
+    }
+    return steps;
+}
+
+unsigned fusion_select(const stFusion_profile *profile, int max_count) {
+    unsigned enabled = 0;
+    // rank by dispatches saved: each run of a sequence saves length - 1
+    for (int n = 0; n < max_count; n++) {
+        int best = -1;
+        uint64_t best_saved = 0;
+        for (int c = 0; c < FUSE_COUNT; c++) {
+            uint64_t saved = profile->candidate[c] * (gCandidates[c].length - 1u);
+            if (!(enabled & (1u << c)) && saved > best_saved) {
+                best = c;
+                best_saved = saved;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        enabled |= 1u << best;
+    }
+    return enabled;
+}
+
+// plain entry for one instruction byte
+static stFused_op fused_plain(uint8_t instruction) {
+    stFused_op op;
+    memset(&op, 0, sizeof(op));
+    op.plain = predecode_instruction(instruction);
+    op.handler = op.plain.handler;
+    op.length = 1;
+    op.last = instruction;
+    return op;
+}
+
+// RAM entries are decoded again on first execution
+static void fused_clear_ram(stCpu_fused *cache) {
+    stFused_op undecoded;
+    memset(&undecoded, 0, sizeof(undecoded));
+    undecoded.handler = UOP_DECODE;
+    undecoded.length = 1;
+    for (int address = ROM_SIZE; address < MEM_SIZE; address++) {
+        cache->op[address] = undecoded;
+    }
+    cache->ram_decoded = false;
+}
+
+void fused_program(stCpu_fused *cache, const stCpu_state *cpu, unsigned enabled) {
+    for (int address = 0; address < ROM_SIZE; address++) {
+        cache->op[address] = fused_plain(cpu->memory[address]);
+    }
+    // the longest enabled sequence starting at each address
+    for (int address = 0; address < ROM_SIZE; address++) {
+        stFused_op *op = &cache->op[address];
+        for (int c = 0; c < FUSE_COUNT; c++) {
+            const stFusion_candidate *candidate = &gCandidates[c];
+            if (!(enabled & (1u << c)) || candidate->length <= op->length
+                || address + candidate->length > ROM_SIZE) {
+                continue;
+            }
+            int k = 0;
+            while (k < candidate->length
+                   && cache->op[address + k].plain.handler == candidate->handler[k]) {
+                k++;
+            }
+            if (k == candidate->length) {
+                op->handler = FUSED_HANDLER(c);
+                op->length = candidate->length;
+                op->last = cpu->memory[address + k - 1];
+            }
+        }
+    }
+    memcpy(cache->rom, cpu->memory, ROM_SIZE);
+    cache->enabled = enabled;
+    fused_clear_ram(cache);
+}
+
+void fused_sync(stCpu_fused *cache, const stCpu_state *cpu, unsigned enabled) {
+    // length 0 marks a table that was never built
+    if (cache->op[0].length == 0 || cache->enabled != enabled
+        || memcmp(cache->rom, cpu->memory, ROM_SIZE) != 0) {
+        fused_program(cache, cpu, enabled);
+    }
+    else if (cache->ram_decoded) {
+        fused_clear_ram(cache);
+    }
+}
+
+#if defined(__GNUC__)
+
+#define ZERO_BIT(value)    (((value) == 0) ? STATUS_ZERO : 0)
+
+uint64_t run_cpu_fused(stCpu_state *cpu, stCpu_fused *cache, const stCpu_io *io, uint64_t max_steps) {
+    static void *const dispatch_table[] = {
+        [UOP_DECODE]       = &&op_decode,
+        [UOP_LOAD_ROM]     = &&op_load_rom,
+        [UOP_LOAD_RAM]     = &&op_load_ram,
+        [UOP_STORE]        = &&op_store,
+        [UOP_TRANSFER]     = &&op_transfer,
+        [UOP_SET]          = &&op_set,
+        [UOP_ADD]          = &&op_add,
+        [UOP_SUB]          = &&op_sub,
+        [UOP_SHIFT_LEFT]   = &&op_shift_left,
+        [UOP_SHIFT_RIGHT]  = &&op_shift_right,
+        [UOP_COMPARE]      = &&op_compare,
+        [UOP_OUTPUT]       = &&op_output,
+        [UOP_INPUT]        = &&op_input,
+        [UOP_COND_JUMP]    = &&op_cond_jump,
+        [UOP_UNCOND_JUMP]  = &&op_uncond_jump,
+        [FUSED_HANDLER(FUSE_SET_COND_JUMP)]            = &&fuse_set_cond_jump,
+        [FUSED_HANDLER(FUSE_SET_UNCOND_JUMP)]          = &&fuse_set_uncond_jump,
+        [FUSED_HANDLER(FUSE_SET_SUB)]                  = &&fuse_set_sub,
+        [FUSED_HANDLER(FUSE_SET_ADD)]                  = &&fuse_set_add,
+        [FUSED_HANDLER(FUSE_SET_TRANSFER)]             = &&fuse_set_transfer,
+        [FUSED_HANDLER(FUSE_SET_SHIFT_LEFT)]           = &&fuse_set_shift_left,
+        [FUSED_HANDLER(FUSE_SET_SHIFT_LEFT_JUMP)]      = &&fuse_set_shift_left_jump,
+        [FUSED_HANDLER(FUSE_SET_SHIFT_LEFT_TEST_JUMP)] = &&fuse_set_shift_left_test_jump,
+        [FUSED_HANDLER(FUSE_SET_TEST_JUMP)]            = &&fuse_set_test_jump,
+        [FUSED_HANDLER(FUSE_ADD_SET_SUB)]              = &&fuse_add_set_sub,
+        [FUSED_HANDLER(FUSE_SUB_SET_JUMP)]             = &&fuse_sub_set_jump,
+        [FUSED_HANDLER(FUSE_TRANSFER_SET_SUB)]         = &&fuse_transfer_set_sub,
+    };
+    uint8_t *memory = cpu->memory;
+    stFused_op *ops = cache->op;
+    const stFused_op *op = NULL;
+    uint8_t reg[4] = { cpu->r0, cpu->r1, cpu->r2, cpu->r3 };
+    uint8_t PC = cpu->PC;
+    uint8_t at = 0;                 // address of the current entry
+    bool single = false;            // op ran its first instruction only
+    uint8_t status = cpu->status;
+    uint8_t halt = cpu->halt;
+    uint64_t steps = 0;
+    uint64_t limit = (max_steps != 0) ? max_steps : UINT64_MAX;
+
+    if (halt != HALT_NONE) {
+        return 0;
+    }
+
+// take the entry at PC; near the end of the budget a sequence that does
+// not fit runs its first instruction only
+#define DISPATCH()                                          \
+    do {                                                    \
+        if (limit - steps < FUSED_MAX_LENGTH) {             \
+            goto tail;                                      \
+        }                                                   \
+        at = PC;                                            \
+        op = &ops[at];                                      \
+        PC += op->length;                                   \
+        steps += op->length;                                \
+        goto *dispatch_table[op->handler];                  \
+    } while (0)
+
+// instruction k of the entry (k = 0 for plain handlers)
+#define UOP(k)          ops[(uint8_t)(at + (k))].plain
+#define REG_H(k)        reg[UOP(k).reg_h]
+#define REG_L(k)        reg[UOP(k).reg_l]
+#define SET_ZF(value)   (status = (status & ~STATUS_ZERO) | ZERO_BIT(value))
+
+// bodies shared by the plain and the fused handlers
+#define DO_TRANSFER(k)                                                              \
+    do {                                                                            \
+        uint8_t value = REG_H(k);                                                   \
+        REG_L(k) = value;                                                           \
+        SET_ZF(value);                                                              \
+    } while (0)
+#define DO_SET(k)                                                                   \
+    do {                                                                            \
+        reg[0] = UOP(k).imm;                                                        \
+        SET_ZF(reg[0]);                                                             \
+    } while (0)
+#define DO_ADD(k)                                                                   \
+    do {                                                                            \
+        int16_t result = REG_H(k) + REG_L(k);                                       \
+        REG_H(k) = (uint8_t)result;                                                 \
+        if (result > 0xFF) {                                                        \
+            status |= STATUS_OF;                                                    \
+            if (io->message != NULL) io->message(io->ctx, "\nOverflow occurs in addition operation!\n"); \
+        }                                                                           \
+        else {                                                                      \
+            SET_ZF((uint8_t)result);                                                \
+            status &= ~STATUS_OF;                                                   \
+        }                                                                           \
+    } while (0)
+#define DO_SUB(k)                                                                   \
+    do {                                                                            \
+        int16_t result = REG_H(k) - REG_L(k);                                       \
+        REG_H(k) = (uint8_t)result;                                                 \
+        if (result < 0) {                                                           \
+            status |= STATUS_OF;                                                    \
+            if (io->message != NULL) io->message(io->ctx, "\nOverflow occurs in subtraction operation!\n"); \
+        }                                                                           \
+        else {                                                                      \
+            SET_ZF((uint8_t)result);                                                \
+            status &= ~STATUS_OF;                                                   \
+        }                                                                           \
+    } while (0)
+#define DO_SHIFT_LEFT(k)    (REG_H(k) = (uint8_t)(REG_H(k) << 4))
+#define DO_COMPARE(k)       SET_ZF(REG_H(k))
+#define DO_COND_JUMP(k)                                                             \
+    do {                                                                            \
+        if (status & STATUS_ZERO) {                                                 \
+            PC = REG_H(k);                                                          \
+        }                                                                           \
+    } while (0)
+#define DO_UNCOND_JUMP(k)   (PC = REG_H(k))
+
+    DISPATCH();
+
+tail:
+    if (steps == limit) {
+        halt = HALT_STEP_LIMIT;
+        goto done;
+    }
+    at = PC;
+    op = &ops[at];
+    if (op->length > limit - steps) {
+        single = true;
+        PC += 1;
+        steps++;
+        goto *dispatch_table[op->plain.handler];
+    }
+    single = false;
+    PC += op->length;
+    steps += op->length;
+    goto *dispatch_table[op->handler];
+
+op_decode:
+    // only RAM entries are left undecoded
+    ops[at] = fused_plain(memory[at]);
+    cache->ram_decoded = true;
+    goto *dispatch_table[op->handler];
+op_load_rom: {
+        uint8_t address = REG_L(0);
+        if (address >= ROM_SIZE) {
+            if (io->message != NULL) io->message(io->ctx, "ROM access out of bounds.\n");
+            halt = HALT_ROM_READ;
+            goto done;
+        }
+        reg[0] = memory[address];
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_load_ram: {
+        uint8_t address = REG_L(0);
+        if (address < ROM_SIZE) {
+            if (io->message != NULL) io->message(io->ctx, "RAM access out of bounds.\n");
+            halt = HALT_RAM_READ;
+            goto done;
+        }
+        reg[0] = memory[address];
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_store: {
+        uint8_t address = REG_L(0) % 128 + 0x80;
+        memory[address] = reg[0];
+        ops[address].handler = UOP_DECODE;      // invalidate the decoded entry
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_transfer:
+    DO_TRANSFER(0);
+    DISPATCH();
+op_set:
+    DO_SET(0);
+    DISPATCH();
+op_add:
+    DO_ADD(0);
+    DISPATCH();
+op_sub:
+    DO_SUB(0);
+    DISPATCH();
+op_shift_left:
+    DO_SHIFT_LEFT(0);
+    DISPATCH();
+op_shift_right:
+    REG_H(0) = REG_H(0) >> 4;
+    DISPATCH();
+op_compare:
+    DO_COMPARE(0);
+    DISPATCH();
+op_output:
+    io->output(io->ctx, REG_H(0));
+    halt = HALT_OUTPUT;
+    goto done;
+op_input:
+    REG_H(0) = io->input(io->ctx);
+    DISPATCH();
+op_cond_jump:
+    DO_COND_JUMP(0);
+    DISPATCH();
+op_uncond_jump:
+    DO_UNCOND_JUMP(0);
+    DISPATCH();
+
+fuse_set_cond_jump:
+    DO_SET(0);
+    DO_COND_JUMP(1);
+    DISPATCH();
+fuse_set_uncond_jump:
+    DO_SET(0);
+    DO_UNCOND_JUMP(1);
+    DISPATCH();
+fuse_set_sub:
+    DO_SET(0);
+    DO_SUB(1);
+    DISPATCH();
+fuse_set_add:
+    DO_SET(0);
+    DO_ADD(1);
+    DISPATCH();
+fuse_set_transfer:
+    DO_SET(0);
+    DO_TRANSFER(1);
+    DISPATCH();
+fuse_set_shift_left:
+    DO_SET(0);
+    DO_SHIFT_LEFT(1);
+    DISPATCH();
+fuse_set_shift_left_jump:
+    DO_SET(0);
+    DO_SHIFT_LEFT(1);
+    DO_UNCOND_JUMP(2);
+    DISPATCH();
+fuse_set_shift_left_test_jump:
+    DO_SET(0);
+    DO_SHIFT_LEFT(1);
+    DO_COMPARE(2);
+    DO_COND_JUMP(3);
+    DISPATCH();
+fuse_set_test_jump:
+    DO_SET(0);
+    DO_COMPARE(1);
+    DO_COND_JUMP(2);
+    DISPATCH();
+fuse_add_set_sub:
+    DO_ADD(0);
+    DO_SET(1);
+    DO_SUB(2);
+    DISPATCH();
+fuse_sub_set_jump:
+    DO_SUB(0);
+    DO_SET(1);
+    DO_UNCOND_JUMP(2);
+    DISPATCH();
+fuse_transfer_set_sub:
+    DO_TRANSFER(0);
+    DO_SET(1);
+    DO_SUB(2);
+    DISPATCH();
+
+done:
+#undef DISPATCH
+#undef UOP
+#undef REG_H
+#undef REG_L
+#undef SET_ZF
+#undef DO_TRANSFER
+#undef DO_SET
+#undef DO_ADD
+#undef DO_SUB
+#undef DO_SHIFT_LEFT
+#undef DO_COMPARE
+#undef DO_COND_JUMP
+#undef DO_UNCOND_JUMP
+    cpu->PC = PC;
+    cpu->r0 = reg[0];
+    cpu->r1 = reg[1];
+    cpu->r2 = reg[2];
+    cpu->r3 = reg[3];
+    cpu->status = status;
+    if (op != NULL) {
+        cpu->instruction = single ? op->plain.instruction : op->last;
+    }
+    cpu->halt = halt;
+    return steps;
+}
+
+#else
+
+// no computed goto on this compiler: fall back to the switch interpreter
+uint64_t run_cpu_fused(stCpu_state *cpu, stCpu_fused *cache, const stCpu_io *io, uint64_t max_steps) {
+    (void)cache;
+    return run_cpu(cpu, io, max_steps);
+}
+
+#endif
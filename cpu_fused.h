@@ -0,0 +1,78 @@
+#ifndef CPU_FUSED_H
+#define CPU_FUSED_H
+
+#include "cpu_predecode.h"
+
+// Superinstructions: frequent straight-line opcode sequences (for example
+// set_value_r0 followed by condition_jump) run in one handler with one
+// dispatch. A profiling pass counts how often adjacent opcode pairs and
+// triples execute over a corpus of runs, and the most frequent candidate
+// sequences are enabled.
+//
+// Every ROM address keeps its own entry: the entry at a sequence start
+// runs the fused handler, the entries inside the sequence are plain
+// micro-ops, so a jump into the middle of a sequence runs correctly.
+// Sequences never leave ROM and never contain a load, input or output, so
+// fused code cannot fault or be overwritten.
+
+#define FUSED_MAX_LENGTH    (4)
+
+// Candidate superinstructions, bit i of an "enabled" mask
+#define FUSE_SET_COND_JUMP              (0)
+#define FUSE_SET_UNCOND_JUMP            (1)
+#define FUSE_SET_SUB                    (2)
+#define FUSE_SET_ADD                    (3)
+#define FUSE_SET_TRANSFER               (4)
+#define FUSE_SET_SHIFT_LEFT             (5)
+#define FUSE_SET_SHIFT_LEFT_JUMP        (6)     // set, shift left, uncondition_jump
+#define FUSE_SET_SHIFT_LEFT_TEST_JUMP   (7)     // set, shift left, compare, condition_jump
+#define FUSE_SET_TEST_JUMP              (8)     // set, compare, condition_jump
+#define FUSE_ADD_SET_SUB                (9)
+#define FUSE_SUB_SET_JUMP               (10)    // sub, set, uncondition_jump
+#define FUSE_TRANSFER_SET_SUB           (11)
+#define FUSE_COUNT                      (12)
+
+#define FUSE_ALL                        ((1u << FUSE_COUNT) - 1)
+
+// Dynamic counts of adjacent opcodes (by opcode nibble) and of each
+// candidate sequence
+typedef struct fusion_profile{
+    uint64_t single[16];
+    uint64_t pair[16][16];
+    uint64_t triple[16][16][16];
+    uint64_t candidate[FUSE_COUNT];
+} stFusion_profile;
+
+typedef struct fused_op{
+    uint8_t handler;        // UOP_* or a fused handler
+    uint8_t length;         // instructions run by the handler
+    uint8_t last;           // last instruction byte of the sequence
+    uint8_t reserved[5];
+    stMicro_op plain;       // the single instruction at this address
+} stFused_op;
+
+typedef struct cpu_fused{
+    stFused_op op[MEM_SIZE];
+    uint8_t rom[ROM_SIZE];
+    unsigned enabled;
+    bool ram_decoded;
+} stCpu_fused;
+
+// Name of a candidate ("set+cond_jump", ...)
+const char *fusion_name(int candidate);
+// Run the program with the switch interpreter and add its dynamic
+// adjacency counts to the profile; return the executed instructions
+uint64_t fusion_profile_run(stFusion_profile *profile, stCpu_state *cpu,
+                            const stCpu_io *io, uint64_t max_steps);
+// Mask of the (at most max_count) most executed candidates
+unsigned fusion_select(const stFusion_profile *profile, int max_count);
+
+// Build the table for cpu with the "enabled" candidates
+void fused_program(stCpu_fused *cache, const stCpu_state *cpu, unsigned enabled);
+// Rebuild when the ROM or the mask changed, else reset the RAM entries
+void fused_sync(stCpu_fused *cache, const stCpu_state *cpu, unsigned enabled);
+
+// Same as run_cpu, running superinstructions where the table has them
+uint64_t run_cpu_fused(stCpu_state *cpu, stCpu_fused *cache, const stCpu_io *io, uint64_t max_steps);
+
+#endif // CPU_FUSED_H
@@ -0,0 +1,170 @@
+#define _DEFAULT_SOURCE
+#include "cpu_harness.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// A job range [begin, end) packed into one atomic word, so that the owner
+// and the thieves can both shrink it with a single compare-and-swap
+#define RANGE(begin, end)   (((uint64_t)(end) << 32) | (uint32_t)(begin))
+#define RANGE_BEGIN(range)  ((uint32_t)(range))
+#define RANGE_END(range)    ((uint32_t)((range) >> 32))
+
+typedef struct harness_worker{
+    // range alone on its cache line: thieves CAS it while the owner
+    // updates its stats, which start on the next line
+    _Alignas(64) _Atomic uint64_t range;
+    _Alignas(64) struct harness_pool *pool;
+    unsigned index;
+    pthread_t thread;
+    stHarness_stats stats;                  // private, summed at the end
+} stHarness_worker;
+
+typedef struct harness_pool{
+    const stHarness_job *jobs;
+    stHarness_result *results;
+    uint64_t max_steps;
+    unsigned n_workers;
+    stHarness_worker *workers;
+} stHarness_pool;
+
+// Take up to "chunk" jobs from the front of the own range
+static bool harness_take(stHarness_worker *worker, uint32_t *begin, uint32_t *end) {
+    uint64_t range = atomic_load_explicit(&worker->range, memory_order_relaxed);
+    for (;;) {
+        uint32_t b = RANGE_BEGIN(range);
+        uint32_t e = RANGE_END(range);
+        if (b >= e) {
+            return false;
+        }
+        uint32_t take = (e - b < HARNESS_CHUNK) ? e : b + HARNESS_CHUNK;
+        if (atomic_compare_exchange_weak_explicit(&worker->range, &range, RANGE(take, e),
+                                                  memory_order_acq_rel, memory_order_relaxed)) {
+            *begin = b;
+            *end = take;
+            return true;
+        }
+    }
+}
+
+// Steal the back half of another worker's range into the own range
+static bool harness_steal(stHarness_worker *worker) {
+    stHarness_pool *pool = worker->pool;
+    for (unsigned i = 1; i < pool->n_workers; i++) {
+        stHarness_worker *victim = &pool->workers[(worker->index + i) % pool->n_workers];
+        uint64_t range = atomic_load_explicit(&victim->range, memory_order_relaxed);
+        for (;;) {
+            uint32_t b = RANGE_BEGIN(range);
+            uint32_t e = RANGE_END(range);
+            if (e - b <= HARNESS_CHUNK || b >= e) {
+                break;                      // not worth it, try the next one
+            }
+            uint32_t middle = b + (e - b) / 2;
+            if (atomic_compare_exchange_weak_explicit(&victim->range, &range, RANGE(b, middle),
+                                                      memory_order_acq_rel, memory_order_relaxed)) {
+                atomic_store_explicit(&worker->range, RANGE(middle, e), memory_order_release);
+                worker->stats.steals++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Run one job on the threaded interpreter
+static void harness_run_job(const stHarness_job *job, stHarness_result *result,
+                            uint64_t max_steps, stHarness_stats *stats) {
+    stCpu_state cpu;
+    stCpu_buffer buffer;
+    stCpu_io io;
+    uint8_t output = 0;
+
+    initialize_cpu(&cpu);
+    load_program(&cpu, job->program, ROM_SIZE);
+    cpu_buffer_io(&io, &buffer, &job->input, 1, &output, 1);
+    result->steps = run_cpu_threaded(&cpu, &io, max_steps);
+    result->halt = cpu.halt;
+    result->output = output;
+    stats->steps += result->steps;
+    stats->halts[cpu.halt]++;
+}
+
+static void *harness_worker_main(void *arg) {
+    stHarness_worker *worker = (stHarness_worker *)arg;
+    stHarness_pool *pool = worker->pool;
+    uint32_t begin, end;
+
+    for (;;) {
+        while (harness_take(worker, &begin, &end)) {
+            for (uint32_t i = begin; i < end; i++) {
+                harness_run_job(&pool->jobs[i], &pool->results[i], pool->max_steps, &worker->stats);
+            }
+        }
+        // ranges only shrink, so once nothing can be stolen the work is done
+        if (!harness_steal(worker)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+int run_harness(const stHarness_job *jobs, size_t n, stHarness_result *results,
+                unsigned threads, uint64_t max_steps, stHarness_stats *stats) {
+    stHarness_pool pool;
+
+    if (n > UINT32_MAX) {
+        return -1;
+    }
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (online > 0) ? (unsigned)online : 1;
+    }
+    pool.jobs = jobs;
+    pool.results = results;
+    pool.max_steps = max_steps;
+    pool.n_workers = threads;
+    pool.workers = aligned_alloc(64, threads * sizeof(stHarness_worker));
+    if (pool.workers == NULL) {
+        return -1;
+    }
+
+    // equal initial shares, stealing evens out the slow programs
+    for (unsigned i = 0; i < threads; i++) {
+        stHarness_worker *worker = &pool.workers[i];
+        memset(&worker->stats, 0, sizeof(worker->stats));
+        worker->pool = &pool;
+        worker->index = i;
+        atomic_init(&worker->range, RANGE(n * i / threads, n * (i + 1) / threads));
+    }
+    unsigned started = 0;
+    for (unsigned i = 1; i < threads; i++) {
+        if (pthread_create(&pool.workers[i].thread, NULL, harness_worker_main, &pool.workers[i]) != 0) {
+            break;
+        }
+        started = i;
+    }
+    // the calling thread is worker 0; it also steals the shares of
+    // threads that could not be started
+    harness_worker_main(&pool.workers[0]);
+    for (unsigned i = 1; i <= started; i++) {
+        pthread_join(pool.workers[i].thread, NULL);
+    }
+    for (unsigned i = started + 1; i < threads; i++) {
+        harness_worker_main(&pool.workers[i]);
+    }
+
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+        for (unsigned i = 0; i < threads; i++) {
+            stats->steps += pool.workers[i].stats.steps;
+            stats->steals += pool.workers[i].stats.steals;
+            for (int h = 0; h <= HALT_STEP_LIMIT; h++) {
+                stats->halts[h] += pool.workers[i].stats.halts[h];
+            }
+        }
+    }
+    free(pool.workers);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef CPU_HARNESS_H
+#define CPU_HARNESS_H
+
+#include "cpu_core.h"
+
+// Multi-threaded harness for exhaustive program testing: (program, input)
+// jobs are split into one range per worker thread, each worker takes small
+// chunks from the front of its own range and, once it is empty, steals the
+// back half of another worker's range. Ranges are single atomic words, and
+// every job writes its own slot of the result table, so the hot path takes
+// no lock.
+
+#define HARNESS_CHUNK   (16)        // jobs taken from the own range at once
+
+typedef struct harness_job{
+    const uint8_t *program;         // ROM image (ROM_SIZE bytes)
+    uint8_t input;                  // returned by the first input_external
+} stHarness_job;
+
+typedef struct harness_result{
+    uint64_t steps;
+    uint8_t halt;                   // HALT_OUTPUT, a fault or HALT_STEP_LIMIT
+    uint8_t output;                 // valid when halt == HALT_OUTPUT
+} stHarness_result;
+
+typedef struct harness_stats{
+    uint64_t steps;                 // instructions executed by all jobs
+    uint64_t halts[HALT_STEP_LIMIT + 1];    // jobs per halt reason
+    uint64_t steals;                // successful steals
+} stHarness_stats;
+
+// Run every job to halt or to max_steps instructions (0 = no limit) on
+// "threads" worker threads (0 = one per online CPU). results[i] receives
+// the outcome of jobs[i]. Return 0 on success.
+int run_harness(const stHarness_job *jobs, size_t n, stHarness_result *results,
+                unsigned threads, uint64_t max_steps, stHarness_stats *stats);
+
+#endif // CPU_HARNESS_H
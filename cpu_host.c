@@ -0,0 +1,1448 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include "cpu_core.h"
+#include "cpu_predecode.h"
+#include "cpu_fused.h"
+#include "cpu_jit.h"
+#include "cpu_batch.h"
+#include "cpu_harness.h"
+#include "cpu_snapshot.h"
+#include "cpu_trace.h"
+#include "cpu_profile.h"
+#include "cpu_stream.h"
+#include "cpu_image.h"
+#include "cpu_asm.h"
+#include "cpu_analyze.h"
+#include "cpu_timing.h"
+#include "cpu_dual.h"
+#include "cpu_memo.h"
+
+// Linux host driver of the emulator core
+//
+// usage: cpu_host <program> [input ...]
+//        cpu_host bench <program> [engine] [steps]
+//        cpu_host compare <program>
+//        cpu_host batch <program> [cpus] [steps]
+//        cpu_host harness <program> [jobs] [threads]
+//        cpu_host fuse <program> [max]
+//        cpu_host fork <program> [continuations]
+//        cpu_host trace <program> [input] [file]
+//        cpu_host profile <program> [json|folded]
+//        cpu_host stream <program> <input file> [output file]
+//        cpu_host images <file> ...
+//        cpu_host asm <source> [output]
+//        cpu_host analyze <program>
+//        cpu_host timed <program> <fast|cycles|hz> [input ...]
+//        cpu_host dual <program> [io|pair]
+//        cpu_host memo <program> [runs] [capacity]
+// <program> is "addition", "factorial" or a raw binary or Intel-HEX ROM
+// image file (cpu_image.c).
+// Inputs are decimal bytes, fed to input_external in order.
+// "compare" runs every engine over the 256 input values and checks that
+// they end in the same state as the switch interpreter ("masked" only has
+// to flag the runs that halt on a read fault).
+// "batch" runs the program on many CPUs in lockstep (run_batch) and
+// reports the aggregate throughput.
+// "harness" runs the program for "jobs" inputs (0..255 repeated) on the
+// work-stealing thread pool, checks the result table against run_cpu and
+// prints the halt reasons.
+// "fuse" profiles the program over the 256 input values, prints the most
+// executed opcode pairs and triples, enables the "max" best superinstructions
+// for the "fused" engine and benchmarks it against "predecoded".
+// "fork" runs the program up to its first input once, forks that snapshot
+// for every continuation (inputs 0..255 repeated), checks the final states
+// against full reruns and reports both times.
+// "trace" records the program for one input (and writes the trace to
+// "file"), replays it, checks seeks against fresh runs and measures the
+// recording overhead over the 256 input values.
+// "profile" runs the program over the 256 input values on the threaded
+// interpreter and prints the hot-spot profile (build with -DCPU_PROFILE).
+// "stream" maps the input file and runs the program again and again on the
+// threaded interpreter until every input byte is consumed, writing the raw
+// output bytes to "output file" in bulk, and reports the throughput.
+// "images" loads every file into a shared read-only image pool and runs
+// each image over the 256 input values on the thread pool.
+// "asm" assembles the source with and without the optimizer (cpu_asm.c),
+// runs both over the 256 input values (every input_external reads the
+// value), checks that they halt with the same outputs and reports their
+// sizes and dynamic instruction counts. "output" receives the optimized
+// raw image.
+// "analyze" prints the static analysis of the program (cpu_analyze.c):
+// resolved jumps, loops, dead code and store targets.
+// "timed" runs the program with the given inputs on the timing model
+// (cpu_timing.c): "fast" as fast as possible, "cycles" cycle-counted on a
+// 1 MHz virtual clock without pacing, a number cycle-counted on a clock of
+// that many Hz paced to real time. It prints the virtual and real times.
+// "dual" runs the dual-core modes of cpu_dual.c over the 256 input values
+// with threads standing in for the cores: "io" with a console thread that
+// has an input ready on one poll out of four, "pair" with two CPU threads,
+// and checks the results against run_cpu.
+// "memo" runs the program "runs" times on input values i * 7 % 256 through
+// the result cache (cpu_memo.c) with "capacity" entries, checks every
+// result against run_cpu and compares the times.
+
+// Small programs on the 16-bit configuration of the templated core
+// (cpu_host_wide16.cpp), return the number of failed checks
+int cpu_wide16_check(void);
+
+#define OUTPUT_CAP      (256)
+#define COMPARE_STEPS   (1000000)
+
+typedef uint64_t (*run_fn)(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps);
+
+typedef struct host_engine{
+    const char *name;
+    run_fn run;
+    bool sticky_faults;     // read faults set STATUS_FAULT instead of halting
+} stHost_engine;
+
+static stCpu_predecode gPredecode;
+
+// predecoded engine: the cache is rebuilt only when the ROM changes
+static uint64_t host_run_predecoded(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps) {
+    predecode_sync(&gPredecode, cpu);
+    return run_cpu_predecoded(cpu, &gPredecode, io, max_steps);
+}
+
+static stCpu_fused gFused;
+static unsigned gFusion_enabled = FUSE_ALL;
+
+// superinstruction engine: every candidate unless "fuse" selected some
+static uint64_t host_run_fused(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps) {
+    fused_sync(&gFused, cpu, gFusion_enabled);
+    return run_cpu_fused(cpu, &gFused, io, max_steps);
+}
+
+static stCpu_jit gJit;
+
+// JIT engine: the code buffer is allocated on first use
+static uint64_t host_run_jit(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps) {
+    if (gJit.code_size == 0) {
+        jit_init(&gJit);
+    }
+    return run_cpu_jit(cpu, &gJit, io, max_steps);
+}
+
+static const stHost_engine gEngines[] = {
+    { "switch",     run_cpu,             false },
+    { "threaded",   run_cpu_threaded,    false },
+    { "template",   run_cpu_template,    false },
+    { "masked",     run_cpu_masked,      true },
+    { "lazy",       run_cpu_lazy,        false },
+    { "predecoded", host_run_predecoded, false },
+    { "fused",      host_run_fused,      false },
+    { "jit",        host_run_jit,        false },
+};
+#define N_ENGINES   (sizeof(gEngines) / sizeof(gEngines[0]))
+
+static const char *const gHalt_names[] = {
+    "running", "output", "ROM read fault", "RAM read fault", "RAM store fault", "step limit"
+};
+
+// backend message callback: diagnostics go to stderr
+static void host_message(void *ctx, const char *text) {
+    (void)ctx;
+    fputs(text, stderr);
+}
+
+static double host_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const stHost_engine *host_engine(const char *name) {
+    for (size_t i = 0; i < N_ENGINES; i++) {
+        if (strcmp(gEngines[i].name, name) == 0) {
+            return &gEngines[i];
+        }
+    }
+    fprintf(stderr, "Unknown engine %s\n", name);
+    return NULL;
+}
+
+// Load the named program into ROM, return 0 on success
+static int host_load(stCpu_state *cpu, const char *name) {
+    if (strcmp(name, "addition") == 0) {
+        load_addition_program(cpu);
+        return 0;
+    }
+    if (strcmp(name, "factorial") == 0) {
+        load_factorial_program(cpu);
+        return 0;
+    }
+    uint8_t image[ROM_SIZE];
+    size_t len;
+    char error[160];
+    if (image_load(name, image, &len, error, sizeof(error)) != 0) {
+        fprintf(stderr, "%s\n", error);
+        return -1;
+    }
+    load_program(cpu, image, len);
+    return 0;
+}
+
+// Run the program with the given inputs and print its outputs
+static int host_run(const char *name, int argc, char **argv) {
+    stCpu_state cpu;
+    uint8_t inputs[64];
+    uint8_t outputs[OUTPUT_CAP];
+    int n_inputs = 0;
+
+    for (int i = 0; i < argc && n_inputs < (int)sizeof(inputs); i++) {
+        inputs[n_inputs++] = (uint8_t)atoi(argv[i]);
+    }
+
+    initialize_cpu(&cpu);
+    if (host_load(&cpu, name) != 0) {
+        return 1;
+    }
+
+    stCpu_buffer buffer;
+    stCpu_io io;
+    cpu_buffer_io(&io, &buffer, inputs, n_inputs, outputs, OUTPUT_CAP);
+    io.message = host_message;
+
+    uint64_t steps = run_cpu(&cpu, &io, 100000000);
+    for (size_t i = 0; i < buffer.out_len && i < OUTPUT_CAP; i++) {
+        printf("%d\n", outputs[i]);
+    }
+    printf("steps: %llu, halt: %d\n", (unsigned long long)steps, cpu.halt);
+    return 0;
+}
+
+// Run the program over all 256 input values until "steps" instructions
+// have been executed, and report the throughput
+static int host_bench(const char *name, const stHost_engine *engine, uint64_t steps) {
+    stCpu_state rom;
+    stCpu_state cpu;
+    stCpu_buffer buffer;
+    stCpu_io io;
+    uint8_t input;
+    uint8_t output;
+    uint64_t total = 0;
+    unsigned checksum = 0;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+
+    double start = host_seconds();
+    while (total < steps) {
+        for (int value = 0; value < 256; value++) {
+            input = (uint8_t)value;
+            cpu = rom;
+            cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+            total += engine->run(&cpu, &io, COMPARE_STEPS);
+            checksum += output;
+        }
+    }
+    double elapsed = host_seconds() - start;
+    printf("%s/%s: %llu steps in %.3f s, %.1f Msteps/s (checksum %u)\n",
+           name, engine->name, (unsigned long long)total, elapsed,
+           total / elapsed / 1e6, checksum);
+    return 0;
+}
+
+static uint64_t host_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void host_sleep_us(uint64_t us) {
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+// Run the program with the given inputs on the timing model
+static int host_timed(const char *name, const char *clock, int argc, char **argv) {
+    stCpu_state cpu;
+    stCpu_timing timing;
+    uint8_t inputs[64];
+    uint8_t outputs[OUTPUT_CAP];
+    int n_inputs = 0;
+
+    if (strcmp(clock, "fast") == 0) {
+        timing_init(&timing, TIMING_FAST, 0);
+    }
+    else if (strcmp(clock, "cycles") == 0) {
+        timing_init(&timing, TIMING_CYCLES, 1000000);
+    }
+    else {
+        uint32_t hz = (uint32_t)strtoul(clock, NULL, 10);
+        if (hz == 0) {
+            fprintf(stderr, "Bad clock %s\n", clock);
+            return 1;
+        }
+        timing_init(&timing, TIMING_CYCLES, hz);
+        timing_pace(&timing, 0, host_now_us, host_sleep_us);
+    }
+    for (int i = 0; i < argc && n_inputs < (int)sizeof(inputs); i++) {
+        inputs[n_inputs++] = (uint8_t)atoi(argv[i]);
+    }
+
+    initialize_cpu(&cpu);
+    if (host_load(&cpu, name) != 0) {
+        return 1;
+    }
+
+    stCpu_buffer buffer;
+    stCpu_io io;
+    cpu_buffer_io(&io, &buffer, inputs, n_inputs, outputs, OUTPUT_CAP);
+    io.message = host_message;
+
+    double start = host_seconds();
+    uint64_t steps = run_cpu_timed(&cpu, &io, &timing, 100000000);
+    double elapsed = host_seconds() - start;
+    for (size_t i = 0; i < buffer.out_len && i < OUTPUT_CAP; i++) {
+        printf("%d\n", outputs[i]);
+    }
+    printf("steps: %llu, halt: %d, cycles: %llu", (unsigned long long)steps, cpu.halt,
+           (unsigned long long)timing.cycle);
+    if (timing.mode == TIMING_CYCLES) {
+        printf(", virtual time: %.6f s", timing_virtual_us(&timing) / 1e6);
+    }
+    printf(", real time: %.6f s", elapsed);
+    if (timing.now_us != NULL) {
+        printf(" (%llu sleeps, %llu resyncs)", (unsigned long long)timing.sleeps,
+               (unsigned long long)timing.resyncs);
+    }
+    printf("\n");
+    return 0;
+}
+
+// console of the "io" mode: the input byte, then zeros
+typedef struct host_console{
+    uint8_t input;
+    bool sent;
+    unsigned polls;
+    uint8_t out[OUTPUT_CAP];
+    size_t out_len;
+} stHost_console;
+
+static int host_console_poll(void *ctx) {
+    stHost_console *console = ctx;
+    if (++console->polls % 4 != 0) {
+        return -1;      // nothing typed yet
+    }
+    int c = console->sent ? 0 : console->input;
+    console->sent = true;
+    return c;
+}
+
+static void host_console_output(void *ctx, uint8_t value) {
+    stHost_console *console = ctx;
+    if (console->out_len < OUTPUT_CAP) {
+        console->out[console->out_len] = value;
+    }
+    console->out_len++;
+}
+
+static void host_yield(void) {
+    sched_yield();
+}
+
+typedef struct host_io_core{
+    stDual_io *dual;
+    const stDual_device *device;
+} stHost_io_core;
+
+// thread standing in for core 1 of DUAL_IO
+static void *host_io_core_main(void *arg) {
+    stHost_io_core *core = arg;
+    while (dual_io_service(core->dual, core->device)) {
+        sched_yield();
+    }
+    return NULL;
+}
+
+typedef struct host_pair_core{
+    const stCpu_state *rom;
+    int first;                      // runs the input values first, first + 2, ...
+    stCpu_state cpu[128];
+    uint64_t steps[128];
+    uint8_t output[128];
+} stHost_pair_core;
+
+// thread standing in for one core of DUAL_PAIR
+static void *host_pair_core_main(void *arg) {
+    stHost_pair_core *pair = arg;
+    for (int i = 0; i < 128; i++) {
+        uint8_t input = (uint8_t)(pair->first + 2 * i);
+        stCpu_buffer buffer;
+        stCpu_io io;
+        stDual_core core;
+        memset(&core, 0, sizeof(core));
+        pair->cpu[i] = *pair->rom;
+        cpu_buffer_io(&io, &buffer, &input, 1, &pair->output[i], 1);
+        core.cpu = &pair->cpu[i];
+        core.io = &io;
+        core.max_steps = COMPARE_STEPS;
+        dual_core_run(&core);
+        pair->steps[i] = core.steps;
+    }
+    return NULL;
+}
+
+// Run the dual-core modes over all input values and check them against run_cpu
+static int host_dual(const char *name, const char *mode) {
+    static stHost_pair_core pair[2];
+    stCpu_state rom;
+    stCpu_state expect[256];
+    uint64_t expect_steps[256];
+    uint8_t expect_out[256][OUTPUT_CAP];
+    size_t expect_len[256];
+    int failures = 0;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    for (int value = 0; value < 256; value++) {
+        stCpu_buffer buffer;
+        stCpu_io io;
+        uint8_t input = (uint8_t)value;
+        expect[value] = rom;
+        cpu_buffer_io(&io, &buffer, &input, 1, expect_out[value], OUTPUT_CAP);
+        expect_steps[value] = run_cpu(&expect[value], &io, COMPARE_STEPS);
+        expect_len[value] = buffer.out_len;
+    }
+
+    double start = host_seconds();
+    if (strcmp(mode, "io") == 0) {
+        uint64_t waits = 0;
+        for (int value = 0; value < 256; value++) {
+            static stDual_io dual;
+            stHost_console console = { .input = (uint8_t)value };
+            stDual_device device = { &console, host_console_poll, host_console_output, NULL };
+            stHost_io_core core = { &dual, &device };
+            stCpu_state cpu = rom;
+            stCpu_io io;
+            pthread_t thread;
+
+            dual_io_init(&dual, &io, host_yield);
+            if (pthread_create(&thread, NULL, host_io_core_main, &core) != 0) {
+                fprintf(stderr, "Cannot start the I/O thread\n");
+                return 1;
+            }
+            uint64_t steps = run_cpu(&cpu, &io, COMPARE_STEPS);
+            dual_io_finish(&dual);
+            pthread_join(thread, NULL);
+            waits += dual.input_waits;
+
+            size_t compared = console.out_len < OUTPUT_CAP ? console.out_len : OUTPUT_CAP;
+            if (steps != expect_steps[value] || memcmp(&cpu, &expect[value], sizeof(cpu)) != 0
+                || console.out_len != expect_len[value]
+                || memcmp(console.out, expect_out[value], compared) != 0) {
+                if (failures++ < 8) {
+                    printf("io: input %d differs (%llu steps, expected %llu)\n", value,
+                           (unsigned long long)steps, (unsigned long long)expect_steps[value]);
+                }
+            }
+        }
+        printf("%s/dual io: 256 runs in %.3f s, %llu input waits\n", name,
+               host_seconds() - start, (unsigned long long)waits);
+    }
+    else if (strcmp(mode, "pair") == 0) {
+        pthread_t thread[2];
+        for (int c = 0; c < 2; c++) {
+            pair[c].rom = &rom;
+            pair[c].first = c;
+            if (pthread_create(&thread[c], NULL, host_pair_core_main, &pair[c]) != 0) {
+                fprintf(stderr, "Cannot start the CPU threads\n");
+                return 1;
+            }
+        }
+        for (int c = 0; c < 2; c++) {
+            pthread_join(thread[c], NULL);
+        }
+        for (int value = 0; value < 256; value++) {
+            const stHost_pair_core *core = &pair[value % 2];
+            int i = value / 2;
+            if (core->steps[i] != expect_steps[value]
+                || memcmp(&core->cpu[i], &expect[value], sizeof(rom)) != 0
+                || (expect_len[value] != 0 && core->output[i] != expect_out[value][0])) {
+                if (failures++ < 8) {
+                    printf("pair: input %d differs\n", value);
+                }
+            }
+        }
+        printf("%s/dual pair: 256 runs in %.3f s\n", name, host_seconds() - start);
+    }
+    else {
+        fprintf(stderr, "Unknown dual mode %s\n", mode);
+        return 1;
+    }
+    printf("%s\n", failures == 0 ? "all runs match run_cpu" : "MISMATCH");
+    return failures != 0;
+}
+
+// Run the program through the result cache and against run_cpu
+static int host_memo(const char *name, uint64_t runs, uint32_t capacity) {
+    stCpu_state rom;
+    stCpu_memo memo;
+    int failures = 0;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    if (memo_init(&memo, capacity) != 0) {
+        fprintf(stderr, "Cannot allocate the cache\n");
+        return 1;
+    }
+
+    double plain = 0;
+    double cached = 0;
+    for (uint64_t i = 0; i < runs; i++) {
+        uint8_t input = (uint8_t)(i * 7);
+        stCpu_state expect = rom;
+        stCpu_state actual = rom;
+        stCpu_buffer buffer;
+        stCpu_io io;
+        uint8_t expect_out = 0, actual_out = 0;
+        size_t actual_len;
+
+        double start = host_seconds();
+        cpu_buffer_io(&io, &buffer, &input, 1, &expect_out, 1);
+        uint64_t expect_steps = run_cpu(&expect, &io, COMPARE_STEPS);
+        double middle = host_seconds();
+        uint64_t actual_steps = memo_run(&memo, &actual, &input, 1, &actual_out, 1, &actual_len,
+                                         COMPARE_STEPS);
+        cached += host_seconds() - middle;
+        plain += middle - start;
+
+        if (actual_steps != expect_steps || memcmp(&actual, &expect, sizeof(rom)) != 0
+            || actual_len != buffer.out_len || actual_out != expect_out) {
+            if (failures++ < 8) {
+                printf("run %llu (input %d) differs\n", (unsigned long long)i, input);
+            }
+        }
+    }
+    // cached results asked for again with half their step count as the
+    // budget must stop at the budget like run_cpu, not be replayed
+    for (int value = 0; value < 8; value++) {
+        uint8_t input = (uint8_t)(value * 7);
+        stCpu_state expect = rom;
+        stCpu_state actual = rom;
+        stCpu_buffer buffer;
+        stCpu_io io;
+        uint8_t expect_out = 0, actual_out = 0;
+        size_t actual_len;
+
+        uint64_t full = memo_run(&memo, &actual, &input, 1, &actual_out, 1, &actual_len, COMPARE_STEPS);
+        uint64_t budget = full / 2;
+        if (budget == 0) {
+            continue;
+        }
+        actual = rom;
+        cpu_buffer_io(&io, &buffer, &input, 1, &expect_out, 1);
+        uint64_t expect_steps = run_cpu(&expect, &io, budget);
+        uint64_t actual_steps = memo_run(&memo, &actual, &input, 1, &actual_out, 1, &actual_len, budget);
+        if (actual_steps != expect_steps || memcmp(&actual, &expect, sizeof(rom)) != 0
+            || actual_len != buffer.out_len) {
+            printf("input %d with a budget of %llu steps differs\n", input, (unsigned long long)budget);
+            failures++;
+        }
+    }
+    printf("%s/memo: %llu runs, %llu hits, %llu misses (%llu impure, %llu uncached), "
+           "%llu evictions\n", name, (unsigned long long)runs, (unsigned long long)memo.hits,
+           (unsigned long long)memo.misses, (unsigned long long)memo.impure,
+           (unsigned long long)memo.uncached, (unsigned long long)memo.evictions);
+    printf("run_cpu %.3f s, cached %.3f s (%.1fx)\n", plain, cached, plain / cached);
+    printf("%s\n", failures == 0 ? "all runs match run_cpu" : "MISMATCH");
+    memo_free(&memo);
+    return failures != 0;
+}
+
+// Check every engine against the switch interpreter over all input values
+static int host_compare(const char *name) {
+    stCpu_state rom;
+    int failures = 0;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+
+    for (size_t e = 1; e < N_ENGINES; e++) {
+        int engine_failures = 0;
+        for (int value = 0; value < 256; value++) {
+            stCpu_state expect = rom;
+            stCpu_state actual = rom;
+            stCpu_buffer expect_buffer, actual_buffer;
+            stCpu_io expect_io, actual_io;
+            uint8_t input = (uint8_t)value;
+            uint8_t expect_out[OUTPUT_CAP], actual_out[OUTPUT_CAP];
+
+            cpu_buffer_io(&expect_io, &expect_buffer, &input, 1, expect_out, OUTPUT_CAP);
+            cpu_buffer_io(&actual_io, &actual_buffer, &input, 1, actual_out, OUTPUT_CAP);
+            uint64_t expect_steps = run_cpu(&expect, &expect_io, COMPARE_STEPS);
+            uint64_t actual_steps = gEngines[e].run(&actual, &actual_io, COMPARE_STEPS);
+
+            if (gEngines[e].sticky_faults
+                && (expect.halt == HALT_ROM_READ || expect.halt == HALT_RAM_READ)) {
+                // the run diverges at the fault, which must have been flagged
+                if ((actual.status & STATUS_FAULT) == 0) {
+                    printf("%s/%s: fault not flagged for input %d\n", name, gEngines[e].name, value);
+                    engine_failures++;
+                }
+                continue;
+            }
+            if (expect_steps != actual_steps
+                || memcmp(&expect, &actual, sizeof(stCpu_state)) != 0
+                || expect_buffer.out_len != actual_buffer.out_len
+                || memcmp(expect_out, actual_out, expect_buffer.out_len < OUTPUT_CAP ? expect_buffer.out_len : OUTPUT_CAP) != 0) {
+                printf("%s/%s: mismatch for input %d (steps %llu vs %llu)\n",
+                       name, gEngines[e].name, value,
+                       (unsigned long long)expect_steps, (unsigned long long)actual_steps);
+                engine_failures++;
+            }
+        }
+        // runs stopped by a step budget end in the same state, down to the
+        // instruction register, when the budget cuts a fused sequence
+        for (uint64_t budget = 1; budget <= 256; budget++) {
+            stCpu_state expect = rom;
+            stCpu_state actual = rom;
+            stCpu_buffer expect_buffer, actual_buffer;
+            stCpu_io expect_io, actual_io;
+            uint8_t input = (uint8_t)(budget * 37);
+            uint8_t expect_out[OUTPUT_CAP], actual_out[OUTPUT_CAP];
+
+            cpu_buffer_io(&expect_io, &expect_buffer, &input, 1, expect_out, OUTPUT_CAP);
+            cpu_buffer_io(&actual_io, &actual_buffer, &input, 1, actual_out, OUTPUT_CAP);
+            uint64_t expect_steps = run_cpu(&expect, &expect_io, budget);
+            uint64_t actual_steps = gEngines[e].run(&actual, &actual_io, budget);
+            if (gEngines[e].sticky_faults
+                && (expect.halt == HALT_ROM_READ || expect.halt == HALT_RAM_READ)) {
+                continue;
+            }
+            if (expect_steps != actual_steps || memcmp(&expect, &actual, sizeof(stCpu_state)) != 0) {
+                printf("%s/%s: mismatch for input %d with a budget of %llu steps\n",
+                       name, gEngines[e].name, input, (unsigned long long)budget);
+                engine_failures++;
+            }
+        }
+        printf("%s/%s: %s\n", name, gEngines[e].name, engine_failures ? "FAILED" : "ok");
+        failures += engine_failures;
+    }
+
+    // the 16-bit configuration of the templated core
+    int wide_failures = cpu_wide16_check();
+    printf("wide16: %s\n", wide_failures ? "FAILED" : "ok");
+    failures += wide_failures;
+
+    // lockstep batch: one CPU per input value
+    const uint8_t *programs[256];
+    uint8_t inputs[256];
+    stBatch_result results[256];
+    int batch_failures = 0;
+    for (int value = 0; value < 256; value++) {
+        programs[value] = rom.memory;
+        inputs[value] = (uint8_t)value;
+    }
+    run_batch(programs, inputs, 256, results, COMPARE_STEPS);
+    for (int value = 0; value < 256; value++) {
+        stCpu_state expect = rom;
+        stCpu_buffer buffer;
+        stCpu_io io;
+        uint8_t input = (uint8_t)value;
+        uint8_t output = 0;
+        cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+        uint64_t steps = run_cpu(&expect, &io, COMPARE_STEPS);
+        const stBatch_result *r = &results[value];
+        if (r->steps != steps || r->halt != expect.halt || r->output != output
+            || r->PC != expect.PC || r->status != expect.status
+            || r->r[0] != expect.r0 || r->r[1] != expect.r1
+            || r->r[2] != expect.r2 || r->r[3] != expect.r3) {
+            printf("%s/batch: mismatch for input %d (steps %llu vs %llu)\n",
+                   name, value, (unsigned long long)steps, (unsigned long long)r->steps);
+            batch_failures++;
+        }
+    }
+    printf("%s/batch: %s\n", name, batch_failures ? "FAILED" : "ok");
+    return (failures || batch_failures) ? 1 : 0;
+}
+
+// Run "cpus" copies of the program in lockstep (inputs 0..255 repeated)
+// until "steps" instructions have been executed
+static int host_batch(const char *name, size_t cpus, uint64_t steps) {
+    stCpu_state rom;
+    uint64_t total = 0;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    const uint8_t **programs = malloc(cpus * sizeof(*programs));
+    uint8_t *inputs = malloc(cpus);
+    stBatch_result *results = malloc(cpus * sizeof(*results));
+    if (programs == NULL || inputs == NULL || results == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < cpus; i++) {
+        programs[i] = rom.memory;
+        inputs[i] = (uint8_t)i;
+    }
+
+    double start = host_seconds();
+    while (total < steps) {
+        total += run_batch(programs, inputs, cpus, results, COMPARE_STEPS);
+    }
+    double elapsed = host_seconds() - start;
+    printf("%s/batch x%zu: %llu steps in %.3f s, %.1f Msteps/s\n",
+           name, cpus, (unsigned long long)total, elapsed, total / elapsed / 1e6);
+    free(programs);
+    free(inputs);
+    free(results);
+    return 0;
+}
+
+// Run the program over many inputs on the thread pool
+static int host_harness(const char *name, size_t n, unsigned threads) {
+    stCpu_state rom;
+    stHarness_stats stats;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    stHarness_job *jobs = malloc(n * sizeof(*jobs));
+    stHarness_result *results = malloc(n * sizeof(*results));
+    if (jobs == NULL || results == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        jobs[i].program = rom.memory;
+        jobs[i].input = (uint8_t)i;
+    }
+
+    double start = host_seconds();
+    if (run_harness(jobs, n, results, threads, COMPARE_STEPS, &stats) != 0) {
+        fprintf(stderr, "Cannot start the thread pool\n");
+        return 1;
+    }
+    double elapsed = host_seconds() - start;
+    printf("%s/harness: %zu jobs, %llu steps in %.3f s, %.1f Msteps/s, %llu steals\n",
+           name, n, (unsigned long long)stats.steps, elapsed, stats.steps / elapsed / 1e6,
+           (unsigned long long)stats.steals);
+    for (int h = HALT_OUTPUT; h <= HALT_STEP_LIMIT; h++) {
+        if (stats.halts[h] != 0) {
+            printf("  %s: %llu\n", gHalt_names[h], (unsigned long long)stats.halts[h]);
+        }
+    }
+
+    // the first 256 jobs cover every input value
+    int failures = 0;
+    for (size_t i = 0; i < n && i < 256; i++) {
+        stCpu_state expect = rom;
+        stCpu_buffer buffer;
+        stCpu_io io;
+        uint8_t output = 0;
+        cpu_buffer_io(&io, &buffer, &jobs[i].input, 1, &output, 1);
+        uint64_t steps = run_cpu(&expect, &io, COMPARE_STEPS);
+        if (results[i].steps != steps || results[i].halt != expect.halt
+            || (expect.halt == HALT_OUTPUT && results[i].output != output)) {
+            printf("%s/harness: mismatch for job %zu\n", name, i);
+            failures++;
+        }
+    }
+    free(jobs);
+    free(results);
+    return failures ? 1 : 0;
+}
+
+// Write "size" bytes to a new temporary file whose name ends in "suffix"
+// and load it with image_load, return its result
+static int host_image_try(const void *bytes, size_t size, const char *suffix,
+                          uint8_t rom[ROM_SIZE], size_t *len) {
+    char path[64];
+    char error[160];
+    snprintf(path, sizeof(path), "/tmp/cpu_host_XXXXXX%s", suffix);
+    int fd = mkstemps(path, (int)strlen(suffix));
+    if (fd < 0) {
+        return -1;
+    }
+    bool written = write(fd, bytes, size) == (ssize_t)size;
+    close(fd);
+    int result = written ? image_load(path, rom, len, error, sizeof(error)) : -1;
+    unlink(path);
+    return result;
+}
+
+// The format choice of image_load: a raw ROM starting with 0x3A (':') is
+// raw unless named .hex, and HEX text is HEX with or without the name
+static int host_image_checks(void) {
+    static const uint8_t raw[] = { 0x3A, 0x51, 0xC0 };
+    static const char hex[] = ":03003A00" "3A51C0" "78\n:00000001FF\n";
+    uint8_t rom[ROM_SIZE];
+    size_t len;
+    int failures = 0;
+
+    if (host_image_try(raw, sizeof(raw), "", rom, &len) != 0 || len != sizeof(raw)
+        || memcmp(rom, raw, sizeof(raw)) != 0) {
+        printf("images: raw ROM starting with 0x3A not loaded\n");
+        failures++;
+    }
+    if (host_image_try(raw, sizeof(raw), ".hex", rom, &len) == 0) {
+        printf("images: raw bytes named .hex loaded\n");
+        failures++;
+    }
+    for (int named = 0; named < 2; named++) {
+        if (host_image_try(hex, sizeof(hex) - 1, named ? ".ihx" : "", rom, &len) != 0
+            || len != 0x3A + sizeof(raw) || memcmp(rom + 0x3A, raw, sizeof(raw)) != 0) {
+            printf("images: HEX text%s not loaded\n", named ? " named .ihx" : "");
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Load every image file into a sealed pool and run each of them over the
+// 256 input values on the thread pool, the jobs pointing into the pool
+static int host_images(int n, char **paths, unsigned threads) {
+    stImage_pool pool;
+    stHarness_stats stats;
+    char error[160];
+    int checks = host_image_checks();
+    int failures = 0;
+
+    if (image_pool_init(&pool, (uint32_t)n) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (image_pool_add(&pool, paths[i], error, sizeof(error)) == IMAGE_NONE) {
+            fprintf(stderr, "%s\n", error);
+            failures++;
+        }
+    }
+    if (pool.count == 0 || image_pool_seal(&pool) != 0) {
+        image_pool_free(&pool);
+        return 1;
+    }
+
+    size_t jobs_n = (size_t)pool.count * 256;
+    stHarness_job *jobs = malloc(jobs_n * sizeof(*jobs));
+    stHarness_result *results = malloc(jobs_n * sizeof(*results));
+    if (jobs == NULL || results == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < jobs_n; i++) {
+        jobs[i].program = image_pool_rom(&pool, (uint32_t)(i / 256));
+        jobs[i].input = (uint8_t)i;
+    }
+    double start = host_seconds();
+    if (run_harness(jobs, jobs_n, results, threads, COMPARE_STEPS, &stats) != 0) {
+        fprintf(stderr, "Cannot start the thread pool\n");
+        return 1;
+    }
+    double elapsed = host_seconds() - start;
+    printf("images: %u loaded, %d rejected, %zu jobs, %llu steps in %.3f s, %.1f Msteps/s\n",
+           pool.count, failures, jobs_n, (unsigned long long)stats.steps, elapsed,
+           stats.steps / elapsed / 1e6);
+    for (uint32_t image = 0; image < pool.count; image++) {
+        uint64_t halts[HALT_STEP_LIMIT + 1] = { 0 };
+        for (size_t i = 0; i < 256; i++) {
+            halts[results[image * 256 + i].halt]++;
+        }
+        printf("  #%u (%u bytes):", image, pool.length[image]);
+        for (int h = HALT_OUTPUT; h <= HALT_STEP_LIMIT; h++) {
+            if (halts[h] != 0) {
+                printf(" %s %llu", gHalt_names[h], (unsigned long long)halts[h]);
+            }
+        }
+        printf("\n");
+    }
+    free(jobs);
+    free(results);
+    image_pool_free(&pool);
+    return (failures || checks) ? 1 : 0;
+}
+
+// Assemble a source file with and without the optimizer and compare the runs
+static int host_asm(const char *path, const char *output) {
+    static char source[1 << 16];
+    uint8_t rom[2][ROM_SIZE];
+    size_t len[2];
+    stAsm_report report[2];
+    uint64_t total[2] = { 0, 0 };
+    char error[160];
+    int failures = 0;
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 1;
+    }
+    size_t size = fread(source, 1, sizeof(source), f);
+    fclose(f);
+    for (int o = 0; o < 2; o++) {
+        if (asm_assemble(source, size, o == 1, rom[o], &len[o], &report[o], error, sizeof(error)) != 0) {
+            fprintf(stderr, "%s: %s\n", path, error);
+            return 1;
+        }
+    }
+
+    for (int value = 0; value < 256; value++) {
+        stCpu_state cpu[2];
+        uint8_t inputs[4];
+        uint8_t outputs[2][OUTPUT_CAP];
+        stCpu_buffer buffer[2];
+        memset(inputs, value, sizeof(inputs));
+        for (int o = 0; o < 2; o++) {
+            stCpu_io io;
+            initialize_cpu(&cpu[o]);
+            load_program(&cpu[o], rom[o], len[o]);
+            cpu_buffer_io(&io, &buffer[o], inputs, sizeof(inputs), outputs[o], OUTPUT_CAP);
+            total[o] += run_cpu(&cpu[o], &io, COMPARE_STEPS);
+        }
+        if (cpu[0].halt != cpu[1].halt || buffer[0].out_len != buffer[1].out_len
+            || memcmp(outputs[0], outputs[1], buffer[0].out_len < OUTPUT_CAP ? buffer[0].out_len : OUTPUT_CAP) != 0) {
+            printf("%s: optimized program differs for input %d\n", path, value);
+            failures++;
+        }
+    }
+    printf("%s: %u blocks\n", path, report[1].blocks);
+    printf("  plain:     %3zu bytes, %llu steps over 256 inputs\n", len[0], (unsigned long long)total[0]);
+    printf("  optimized: %3zu bytes, %llu steps over 256 inputs (%.1f%% fewer), "
+           "%u removed by the peephole pass%s\n",
+           len[1], (unsigned long long)total[1], 100.0 * (1.0 - (double)total[1] / total[0]),
+           report[1].removed, report[1].relaid ? ", blocks relaid" : "");
+
+    if (output != NULL) {
+        f = fopen(output, "wb");
+        if (f == NULL || fwrite(rom[1], 1, len[1], f) != len[1]) {
+            fprintf(stderr, "Cannot write %s\n", output);
+            failures++;
+        }
+        if (f != NULL) fclose(f);
+    }
+    return failures ? 1 : 0;
+}
+
+// Print the static analysis of the program
+static int host_analyze(const char *name) {
+    static stCpu_analysis analysis;
+    stCpu_state rom;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    cpu_analyze(&rom, &analysis);
+    return cpu_analysis_write(&analysis, &rom, stdout) != 0;
+}
+
+// Profile the program, pick its superinstructions and benchmark them
+static int host_fuse(const char *name, int max_count) {
+    static stFusion_profile profile;
+    static const char *const opcode_names[16] = {
+        "load", "load", "store", "store", "transfer", "set", "add", "sub",
+        "shl", "shr", "compare", "compare", "output", "input", "cond_jump", "jump"
+    };
+    stCpu_state rom;
+    uint64_t total = 0;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    memset(&profile, 0, sizeof(profile));
+    for (int value = 0; value < 256; value++) {
+        stCpu_state cpu = rom;
+        stCpu_buffer buffer;
+        stCpu_io io;
+        uint8_t input = (uint8_t)value;
+        uint8_t output;
+        cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+        total += fusion_profile_run(&profile, &cpu, &io, COMPARE_STEPS);
+    }
+
+    // top five pairs and triples
+    printf("%s: %llu instructions profiled\n", name, (unsigned long long)total);
+    for (int n = 0; n < 5; n++) {
+        uint64_t best = 0;
+        int a = 0, b = 0;
+        for (int i = 0; i < 16; i++) {
+            for (int j = 0; j < 16; j++) {
+                if (profile.pair[i][j] > best) {
+                    best = profile.pair[i][j];
+                    a = i;
+                    b = j;
+                }
+            }
+        }
+        if (best == 0) {
+            break;
+        }
+        printf("  pair   %5.1f%%  %s %s\n", 100.0 * best / total, opcode_names[a], opcode_names[b]);
+        profile.pair[a][b] = 0;
+    }
+    for (int n = 0; n < 5; n++) {
+        uint64_t best = 0;
+        int a = 0, b = 0, c = 0;
+        for (int i = 0; i < 16; i++) {
+            for (int j = 0; j < 16; j++) {
+                for (int k = 0; k < 16; k++) {
+                    if (profile.triple[i][j][k] > best) {
+                        best = profile.triple[i][j][k];
+                        a = i;
+                        b = j;
+                        c = k;
+                    }
+                }
+            }
+        }
+        if (best == 0) {
+            break;
+        }
+        printf("  triple %5.1f%%  %s %s %s\n", 100.0 * best / total,
+               opcode_names[a], opcode_names[b], opcode_names[c]);
+        profile.triple[a][b][c] = 0;
+    }
+
+    gFusion_enabled = fusion_select(&profile, max_count);
+    for (int c = 0; c < FUSE_COUNT; c++) {
+        if (gFusion_enabled & (1u << c)) {
+            printf("  fused  %s (%llu runs)\n", fusion_name(c), (unsigned long long)profile.candidate[c]);
+        }
+    }
+    host_bench(name, host_engine("predecoded"), 100000000);
+    return host_bench(name, host_engine("fused"), 100000000);
+}
+
+// Run "n" continuations from a snapshot taken at the first input
+static int host_fork(const char *name, uint32_t n) {
+    stSnapshot_arena arena;
+    stCpu_state rom;
+    stCpu_state cpu;
+    stCpu_buffer buffer;
+    stCpu_io io;
+    uint8_t input;
+    uint8_t output;
+    uint64_t fork_steps = 0;
+    uint64_t rerun_steps = 0;
+    int failures = 0;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    if (snapshot_arena_init(&arena, n + 1) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    double start = host_seconds();
+    cpu = rom;
+    cpu_buffer_io(&io, &buffer, NULL, 0, &output, 1);
+    uint64_t prefix = run_cpu_to_input(&cpu, &io, COMPARE_STEPS);
+    uint32_t root = snapshot_take(&arena, &cpu);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t child = snapshot_fork(&arena, root);
+        input = (uint8_t)i;
+        snapshot_restore(&cpu, &arena, child);
+        cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+        fork_steps += run_cpu_threaded(&cpu, &io, COMPARE_STEPS - prefix);
+        if (snapshot_update(&arena, child, &cpu) != 0) {
+            fprintf(stderr, "Snapshot arena full\n");
+            break;
+        }
+    }
+    double fork_time = host_seconds() - start;
+
+    start = host_seconds();
+    for (uint32_t i = 0; i < n; i++) {
+        stCpu_state expect = rom;
+        stCpu_state saved;
+        input = (uint8_t)i;
+        cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+        rerun_steps += run_cpu_threaded(&expect, &io, COMPARE_STEPS);
+        snapshot_restore(&saved, &arena, root + 1 + i);
+        if (memcmp(&saved, &expect, sizeof(stCpu_state)) != 0) {
+            printf("%s/fork: mismatch for continuation %u\n", name, i);
+            failures++;
+        }
+    }
+    double rerun_time = host_seconds() - start;
+
+    printf("%s/fork: prefix of %llu steps, %u continuations, %u memory pages\n",
+           name, (unsigned long long)prefix, n, arena.pages);
+    printf("  forked: %llu steps in %.3f s\n", (unsigned long long)fork_steps, fork_time);
+    printf("  rerun:  %llu steps in %.3f s (includes the check)\n",
+           (unsigned long long)rerun_steps, rerun_time);
+    snapshot_arena_free(&arena);
+    return failures ? 1 : 0;
+}
+
+// Record, replay and seek a trace of the program
+static int host_trace(const char *name, uint8_t input, const char *path) {
+    stCpu_state rom;
+    stCpu_state cpu;
+    stCpu_buffer buffer;
+    stCpu_io io;
+    stCpu_trace trace;
+    stTrace_replay replay;
+    uint8_t output;
+    int failures = 0;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    trace_init(&trace);
+
+    cpu = rom;
+    cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+    uint64_t steps = run_cpu_recorded(&cpu, &io, COMPARE_STEPS, &trace);
+    printf("%s/trace: %llu steps, %llu bytes (%.2f bytes/step), %llu checkpoints\n",
+           name, (unsigned long long)steps, (unsigned long long)trace.length,
+           steps ? (double)trace.length / steps : 0.0, (unsigned long long)trace.checkpoints);
+    if (path != NULL) {
+        FILE *f = fopen(path, "wb");
+        if (f == NULL || trace_write(&trace, f) != 0) {
+            fprintf(stderr, "Cannot write %s\n", path);
+            failures++;
+        }
+        if (f != NULL) {
+            fclose(f);
+        }
+    }
+
+    // full replay ends in the recorded state (apart from a step limit halt)
+    stCpu_state final = cpu;
+    if (final.halt == HALT_STEP_LIMIT) {
+        final.halt = HALT_NONE;
+    }
+    stCpu_io quiet = { NULL, NULL, NULL, NULL };
+    int status = 0;
+    trace_seek(&replay, &trace, 0);
+    while ((status = trace_replay_step(&replay, &quiet)) == 1) {
+    }
+    if (status != 0 || memcmp(&replay.cpu, &final, sizeof(stCpu_state)) != 0) {
+        printf("%s/trace: replay diverges at step %llu\n", name, (unsigned long long)replay.step);
+        failures++;
+    }
+    // seeks match a fresh run stopped at the same step
+    for (int i = 0; i < 64; i++) {
+        uint64_t step = steps * i / 64;
+        stCpu_state expect = rom;
+        cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+        if (step != 0) {
+            run_cpu(&expect, &io, step);
+        }
+        if (expect.halt == HALT_STEP_LIMIT) {
+            expect.halt = HALT_NONE;
+        }
+        if (trace_seek(&replay, &trace, step) != 0
+            || memcmp(&replay.cpu, &expect, sizeof(stCpu_state)) != 0) {
+            printf("%s/trace: seek to step %llu failed\n", name, (unsigned long long)step);
+            failures++;
+        }
+    }
+
+    // the same run recorded in calls of TRACE_CHECKPOINT steps, each ending
+    // on a checkpoint boundary: same checkpoints, same seeks
+    stCpu_trace pieces;
+    trace_init(&pieces);
+    cpu = rom;
+    cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+    do {
+        cpu.halt = HALT_NONE;
+        run_cpu_recorded(&cpu, &io, TRACE_CHECKPOINT, &pieces);
+    } while (cpu.halt == HALT_STEP_LIMIT && pieces.steps < steps);
+    if (pieces.checkpoints != trace.checkpoints || pieces.length != trace.length) {
+        printf("%s/trace: %llu checkpoints when recorded in pieces, %llu in one call\n", name,
+               (unsigned long long)pieces.checkpoints, (unsigned long long)trace.checkpoints);
+        failures++;
+    }
+    for (int i = 0; i < 64; i++) {
+        uint64_t step = steps * i / 64 + 1;
+        stCpu_state expect = rom;
+        if (step > steps) {
+            break;
+        }
+        cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+        run_cpu(&expect, &io, step);
+        if (expect.halt == HALT_STEP_LIMIT) {
+            expect.halt = HALT_NONE;
+        }
+        if (trace_seek(&replay, &pieces, step) != 0
+            || memcmp(&replay.cpu, &expect, sizeof(stCpu_state)) != 0) {
+            printf("%s/trace: seek to step %llu of the pieces failed\n", name, (unsigned long long)step);
+            failures++;
+        }
+    }
+    trace_free(&pieces);
+
+    // a trace cut inside its last record stops short or mismatches
+    if (trace.length != 0) {
+        stCpu_trace cut = trace;
+        cut.length--;
+        trace_seek(&replay, &cut, 0);
+        while ((status = trace_replay_step(&replay, &quiet)) == 1) {
+        }
+        if (status == 0 && replay.step == cut.steps) {
+            printf("%s/trace: replay ran past the end of a cut trace\n", name);
+            failures++;
+        }
+    }
+    // trace_read takes a good file back and refuses a bad header or checkpoint
+    FILE *f = tmpfile();
+    if (f != NULL && trace_write(&trace, f) == 0) {
+        // stream length, checkpoint count, offset of the first checkpoint
+        uint64_t bad[3] = { UINT64_MAX, UINT64_MAX, trace.length + 1 };
+        long at[3] = { 16, 24, 32 + (long)offsetof(stTrace_checkpoint, offset) };
+        for (int i = -1; i < 3; i++) {
+            stCpu_trace back;
+            uint64_t keep;
+            if (i >= 0) {
+                fseek(f, at[i], SEEK_SET);
+                fread(&keep, sizeof(keep), 1, f);
+                fseek(f, at[i], SEEK_SET);
+                fwrite(&bad[i], sizeof(bad[i]), 1, f);
+            }
+            rewind(f);
+            int got = trace_read(&back, f);
+            if (got == 0) {
+                trace_free(&back);
+            }
+            if ((i < 0) != (got == 0)) {
+                printf("%s/trace: trace_read %s case %d\n", name, got == 0 ? "accepts" : "refuses", i);
+                failures++;
+            }
+            if (i >= 0) {
+                fseek(f, at[i], SEEK_SET);
+                fwrite(&keep, sizeof(keep), 1, f);
+            }
+        }
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+
+    // recording overhead: best of three sweeps over the 256 input values
+    double best[3] = { 1e30, 1e30, 1e30 };     // switch, threaded, recorded
+    uint64_t total = 0;
+    uint64_t bytes = 0;
+    for (int round = 0; round < 3; round++) {
+        for (int engine = 0; engine < 3; engine++) {
+            double start = host_seconds();
+            total = 0;
+            bytes = 0;
+            for (int value = 0; value < 256; value++) {
+                uint8_t in = (uint8_t)value;
+                cpu = rom;
+                cpu_buffer_io(&io, &buffer, &in, 1, &output, 1);
+                if (engine == 0) {
+                    total += run_cpu(&cpu, &io, COMPARE_STEPS);
+                }
+                else if (engine == 1) {
+                    total += run_cpu_threaded(&cpu, &io, COMPARE_STEPS);
+                }
+                else {
+                    trace_reset(&trace);
+                    total += run_cpu_recorded(&cpu, &io, COMPARE_STEPS, &trace);
+                    bytes += trace.length;
+                }
+            }
+            double elapsed = host_seconds() - start;
+            if (elapsed < best[engine]) {
+                best[engine] = elapsed;
+            }
+        }
+    }
+    printf("  switch:   %.1f Msteps/s\n", total / best[0] / 1e6);
+    printf("  threaded: %.1f Msteps/s\n", total / best[1] / 1e6);
+    printf("  recorded: %.1f Msteps/s (%.1f%% below threaded, %.2f bytes/step)\n",
+           total / best[2] / 1e6, 100.0 * (1.0 - best[1] / best[2]), (double)bytes / total);
+    printf("%s/trace: %s\n", name, failures ? "FAILED" : "ok");
+    trace_free(&trace);
+    return failures ? 1 : 0;
+}
+
+// Profile the program over all input values
+static int host_profile(const char *name, const char *format) {
+#if defined(CPU_PROFILE)
+    static stCpu_profile profile;
+    stCpu_state rom;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    cpu_profile_attach(&profile);
+    for (int value = 0; value < 256; value++) {
+        stCpu_state cpu = rom;
+        stCpu_buffer buffer;
+        stCpu_io io;
+        uint8_t input = (uint8_t)value;
+        uint8_t output;
+        cpu_buffer_io(&io, &buffer, &input, 1, &output, 1);
+        run_cpu_threaded(&cpu, &io, COMPARE_STEPS);
+    }
+    cpu_profile_attach(NULL);
+    if (strcmp(format, "folded") == 0) {
+        return cpu_profile_write_folded(&profile, &rom, name, stdout) != 0;
+    }
+    return cpu_profile_write_json(&profile, &rom, stdout) != 0;
+#else
+    (void)name;
+    (void)format;
+    fprintf(stderr, "Profiling is compiled out, rebuild with -DCPU_PROFILE\n");
+    return 1;
+#endif
+}
+
+// Run the program over a mapped input file until it is consumed
+static int host_stream(const char *name, const char *input, const char *output) {
+    stCpu_state rom;
+    stCpu_stream stream;
+    stCpu_io io;
+    uint64_t runs = 0;
+    uint64_t steps = 0;
+    int fd = -1;
+
+    initialize_cpu(&rom);
+    if (host_load(&rom, name) != 0) {
+        return 1;
+    }
+    if (output != NULL) {
+        fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "Cannot create %s\n", output);
+            return 1;
+        }
+    }
+    if (stream_init(&stream, 0, 1 << 16, fd) != 0 || stream_map_input(&stream, input) != 0) {
+        fprintf(stderr, "Cannot map %s\n", input);
+        stream_free(&stream);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    cpu_stream_io(&io, &stream);
+
+    double start = host_seconds();
+    size_t left = stream_input_left(&stream);
+    while (left != 0) {
+        stCpu_state cpu = rom;
+        steps += run_cpu_threaded(&cpu, &io, COMPARE_STEPS);
+        runs++;
+        size_t now = stream_input_left(&stream);
+        if (now == left) {
+            break;      // the program reads no input
+        }
+        left = now;
+    }
+    int failed = stream_flush(&stream) != 0;
+    double elapsed = host_seconds() - start;
+
+    printf("%s/stream: %llu runs, %llu steps, %zu bytes in, %llu bytes out in %.3f s "
+           "(%.1f Mruns/s, %.1f Msteps/s)\n",
+           name, (unsigned long long)runs, (unsigned long long)steps, stream.map_len - left,
+           (unsigned long long)stream.out_total, elapsed, runs / elapsed / 1e6, steps / elapsed / 1e6);
+    if (failed) {
+        fprintf(stderr, "Cannot write %s\n", output);
+    }
+    stream_free(&stream);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && strcmp(argv[1], "bench") == 0) {
+        const stHost_engine *engine = host_engine(argc >= 4 ? argv[3] : "switch");
+        uint64_t steps = (argc >= 5) ? strtoull(argv[4], NULL, 10) : 100000000;
+        if (engine == NULL) {
+            return 1;
+        }
+        return host_bench(argv[2], engine, steps);
+    }
+    if (argc >= 3 && strcmp(argv[1], "compare") == 0) {
+        return host_compare(argv[2]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "batch") == 0) {
+        size_t cpus = (argc >= 4) ? strtoull(argv[3], NULL, 10) : 4096;
+        uint64_t steps = (argc >= 5) ? strtoull(argv[4], NULL, 10) : 100000000;
+        return host_batch(argv[2], cpus, steps);
+    }
+    if (argc >= 3 && strcmp(argv[1], "harness") == 0) {
+        size_t jobs = (argc >= 4) ? strtoull(argv[3], NULL, 10) : 4096;
+        unsigned threads = (argc >= 5) ? (unsigned)atoi(argv[4]) : 0;
+        return host_harness(argv[2], jobs, threads);
+    }
+    if (argc >= 3 && strcmp(argv[1], "fuse") == 0) {
+        int max_count = (argc >= 4) ? atoi(argv[3]) : 4;
+        return host_fuse(argv[2], max_count);
+    }
+    if (argc >= 3 && strcmp(argv[1], "fork") == 0) {
+        uint32_t n = (argc >= 4) ? (uint32_t)strtoul(argv[3], NULL, 10) : 4096;
+        return host_fork(argv[2], n);
+    }
+    if (argc >= 3 && strcmp(argv[1], "trace") == 0) {
+        uint8_t input = (argc >= 4) ? (uint8_t)atoi(argv[3]) : 5;
+        return host_trace(argv[2], input, (argc >= 5) ? argv[4] : NULL);
+    }
+    if (argc >= 3 && strcmp(argv[1], "profile") == 0) {
+        return host_profile(argv[2], (argc >= 4) ? argv[3] : "json");
+    }
+    if (argc >= 4 && strcmp(argv[1], "stream") == 0) {
+        return host_stream(argv[2], argv[3], (argc >= 5) ? argv[4] : NULL);
+    }
+    if (argc >= 3 && strcmp(argv[1], "images") == 0) {
+        return host_images(argc - 2, argv + 2, 0);
+    }
+    if (argc >= 3 && strcmp(argv[1], "asm") == 0) {
+        return host_asm(argv[2], (argc >= 4) ? argv[3] : NULL);
+    }
+    if (argc >= 3 && strcmp(argv[1], "analyze") == 0) {
+        return host_analyze(argv[2]);
+    }
+    if (argc >= 4 && strcmp(argv[1], "timed") == 0) {
+        return host_timed(argv[2], argv[3], argc - 4, argv + 4);
+    }
+    if (argc >= 3 && strcmp(argv[1], "dual") == 0) {
+        return host_dual(argv[2], (argc >= 4) ? argv[3] : "io");
+    }
+    if (argc >= 3 && strcmp(argv[1], "memo") == 0) {
+        uint64_t runs = (argc >= 4) ? strtoull(argv[3], NULL, 10) : 4096;
+        uint32_t capacity = (argc >= 5) ? (uint32_t)strtoul(argv[4], NULL, 10) : 256;
+        return host_memo(argv[2], runs, capacity);
+    }
+    if (argc >= 2) {
+        return host_run(argv[1], argc - 2, argv + 2);
+    }
+    fprintf(stderr, "usage: %s <program> [input ...]\n"
+                    "       %s bench <program> [engine] [steps]\n"
+                    "       %s compare <program>\n"
+                    "       %s batch <program> [cpus] [steps]\n"
+                    "       %s harness <program> [jobs] [threads]\n"
+                    "       %s fuse <program> [max]\n"
+                    "       %s fork <program> [continuations]\n"
+                    "       %s trace <program> [input] [file]\n"
+                    "       %s profile <program> [json|folded]\n"
+                    "       %s stream <program> <input file> [output file]\n"
+                    "       %s images <file> ...\n"
+                    "       %s asm <source> [output]\n"
+                    "       %s analyze <program>\n"
+                    "       %s timed <program> <fast|cycles|hz> [input ...]\n"
+                    "       %s dual <program> [io|pair]\n"
+                    "       %s memo <program> [runs] [capacity]\n",
+                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,99 @@
+#include "cpu_core.hpp"
+
+// Host check of the 16-bit configuration of the templated core (64K words,
+// 16 registers): small hand-encoded programs run on cpu::Wide16 and
+// "cpu_host compare" reports the failed checks. Only cpu_host links this.
+
+namespace {
+
+struct RecordIo {
+    std::uint16_t in;
+    std::uint16_t out;
+    int outputs;
+
+    std::uint16_t input() { return in; }
+    void output(std::uint16_t value) {
+        out = value;
+        outputs++;
+    }
+    void message(const char *) {}
+};
+
+// Wide16 encoding: opcode in bits 15..12, reg_H in 11..6, reg_L in 5..0
+constexpr std::uint16_t w16(int opcode, int h, int l) {
+    return std::uint16_t(opcode << 12 | h << 6 | l);
+}
+constexpr std::uint16_t w16_set(int value) {
+    return std::uint16_t(set_value_r0 << 12 | value);
+}
+
+cpu::State<cpu::Wide16> gWide;     // 128 KB: not on the stack
+
+// Run "program" placed at "at" from PC = at; return the output or -1
+int wide16_run(const std::uint16_t *program, std::size_t n, std::uint16_t at, std::uint16_t input,
+               std::uint8_t halt) {
+    RecordIo io{ input, 0, 0 };
+    gWide.reset();
+    for (std::size_t i = 0; i < n; i++) {
+        gWide.memory[std::uint16_t(at + i)] = program[i];
+    }
+    gWide.memory[0x9000] = 0x1234;
+    gWide.PC = at;
+    cpu::run(gWide, io, 1000);
+    if (gWide.halt != halt) {
+        return -1;
+    }
+    return (halt == HALT_OUTPUT && io.outputs == 1) ? io.out : -2;
+}
+
+} // namespace
+
+// Run the programs, return the number of failed checks
+extern "C" int cpu_wide16_check(void) {
+    int failures = 0;
+
+    // 16-bit add: 0xFF00 + 0xFF fits, + 1 more overflows to 0 with OF set
+    {
+        const std::uint16_t fits[] = {
+            w16_set(0xFF), w16(shift_left, 0, 0), w16(rx_to_ry, 0, 1),
+            w16_set(0xFF), w16(add_ry_to_rx, 1, 0), w16(output_external, 1, 0),
+        };
+        failures += wide16_run(fits, 6, 0, 0, HALT_OUTPUT) != 0xFFFF || (gWide.status & STATUS_OF);
+        const std::uint16_t wraps[] = {
+            w16_set(0xFF), w16(shift_left, 0, 0), w16(rx_to_ry, 0, 1),
+            w16_set(0xFF), w16(add_ry_to_rx, 1, 0),
+            w16_set(1), w16(add_ry_to_rx, 1, 0), w16(output_external, 1, 0),
+        };
+        failures += wide16_run(wraps, 8, 0, 0, HALT_OUTPUT) != 0 || !(gWide.status & STATUS_OF);
+    }
+    // PC wraps from 0xFFFF to 0
+    {
+        const std::uint16_t wrap[] = { w16_set(0x7AB), w16(output_external, 0, 0) };
+        failures += wide16_run(wrap, 2, 0xFFFF, 0, HALT_OUTPUT) != 0x7AB || gWide.PC != 1;
+    }
+    // 16-bit addresses: RAM read at 0x9000, the same address as ROM halts;
+    // input, register 15 and the 8-bit shift right
+    {
+        const std::uint16_t ram[] = {
+            w16_set(0x90), w16(shift_left, 0, 0), w16(rx_to_ry, 0, 1),
+            w16(mem_to_r0_1, 1, 1), w16(rx_to_ry, 0, 15), w16(output_external, 15, 0),
+        };
+        failures += wide16_run(ram, 6, 0, 0, HALT_OUTPUT) != 0x1234;
+        const std::uint16_t rom[] = {
+            w16_set(0x90), w16(shift_left, 0, 0), w16(rx_to_ry, 0, 1), w16(mem_to_r0_1, 0, 1),
+        };
+        failures += wide16_run(rom, 4, 0, 0, HALT_ROM_READ) != -2;
+        const std::uint16_t shift[] = { w16(input_external, 2, 0), w16(shift_right, 2, 0),
+                                        w16(output_external, 2, 0) };
+        failures += wide16_run(shift, 3, 0, 0xABCD, HALT_OUTPUT) != 0xAB;
+    }
+    // stores land in the upper half: r0_to_ram at 0xFF00 + 0x8000 % 0x8000
+    {
+        const std::uint16_t store[] = {
+            w16_set(0xFF), w16(shift_left, 0, 0), w16(rx_to_ry, 0, 1),
+            w16_set(0x5A5), w16(r0_to_ram_1, 0, 1), w16(mem_to_r0_1, 1, 1), w16(output_external, 0, 0),
+        };
+        failures += wide16_run(store, 7, 0, 0, HALT_OUTPUT) != 0x5A5 || gWide.memory[0xFF00] != 0x5A5;
+    }
+    return failures;
+}
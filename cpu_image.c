@@ -0,0 +1,225 @@
+#include "cpu_image.h"
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int image_error(char *error, size_t error_size, const char *format, ...) {
+    if (error != NULL && error_size != 0) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(error, error_size, format, args);
+        va_end(args);
+    }
+    return -1;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+int image_parse_hex(const char *text, size_t size, uint8_t rom[ROM_SIZE], size_t *len,
+                    char *error, size_t error_size) {
+    uint8_t written[ROM_SIZE] = { 0 };
+    size_t end = 0;
+    size_t pos = 0;
+    int line = 0;
+    bool eof = false;
+
+    memset(rom, 0, ROM_SIZE);
+    while (pos < size) {
+        // one record per line, blank lines are allowed
+        size_t start = pos;
+        while (pos < size && text[pos] != '\n') {
+            pos++;
+        }
+        size_t stop = pos++;
+        line++;
+        if (stop > start && text[stop - 1] == '\r') {
+            stop--;
+        }
+        if (stop == start) {
+            continue;
+        }
+        if (eof) {
+            return image_error(error, error_size, "line %d: data after the end-of-file record", line);
+        }
+
+        uint8_t record[5 + 255];
+        size_t count = (stop - start - 1) / 2;
+        if (text[start] != ':' || (stop - start - 1) % 2 != 0 || count < 5) {
+            return image_error(error, error_size, "line %d: malformed record", line);
+        }
+        uint8_t sum = 0;
+        for (size_t i = 0; i < count; i++) {
+            int high = hex_digit(text[start + 1 + 2 * i]);
+            int low = hex_digit(text[start + 2 + 2 * i]);
+            if (high < 0 || low < 0 || i >= sizeof(record)) {
+                return image_error(error, error_size, "line %d: malformed record", line);
+            }
+            record[i] = (uint8_t)(high << 4 | low);
+            sum += record[i];
+        }
+        uint8_t length = record[0];
+        unsigned address = (unsigned)record[1] << 8 | record[2];
+        uint8_t type = record[3];
+        if (count != (size_t)length + 5) {
+            return image_error(error, error_size, "line %d: length does not match the record", line);
+        }
+        if (sum != 0) {
+            return image_error(error, error_size, "line %d: bad checksum", line);
+        }
+
+        switch (type) {
+        case 0x00:      // data
+            if (address + length > ROM_SIZE) {
+                return image_error(error, error_size, "line %d: data outside the %d-byte ROM",
+                                   line, ROM_SIZE);
+            }
+            for (unsigned i = 0; i < length; i++) {
+                if (written[address + i]) {
+                    return image_error(error, error_size, "line %d: address 0x%02X written twice",
+                                       line, address + i);
+                }
+                written[address + i] = 1;
+                rom[address + i] = record[4 + i];
+            }
+            if (address + length > end) {
+                end = address + length;
+            }
+            break;
+        case 0x01:      // end of file
+            eof = true;
+            break;
+        case 0x02:      // extended segment / linear address: only 0 fits the ROM
+        case 0x04:
+            if (length != 2 || record[4] != 0 || record[5] != 0) {
+                return image_error(error, error_size, "line %d: extended address outside the ROM", line);
+            }
+            break;
+        case 0x03:      // start address: meaningless here, PC starts at 0
+        case 0x05:
+            break;
+        default:
+            return image_error(error, error_size, "line %d: unknown record type %02X", line, type);
+        }
+    }
+    if (!eof) {
+        return image_error(error, error_size, "missing end-of-file record");
+    }
+    if (end == 0) {
+        return image_error(error, error_size, "no data");
+    }
+    *len = end;
+    return 0;
+}
+
+// Intel HEX by extension: .hex or .ihx in any case
+static bool image_hex_name(const char *path) {
+    size_t n = strlen(path);
+    return n >= 4 && (strcasecmp(path + n - 4, ".hex") == 0 || strcasecmp(path + n - 4, ".ihx") == 0);
+}
+
+int image_load(const char *path, uint8_t rom[ROM_SIZE], size_t *len,
+               char *error, size_t error_size) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return image_error(error, error_size, "%s: cannot open", path);
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return image_error(error, error_size, "%s: empty or unreadable", path);
+    }
+    size_t size = (size_t)st.st_size;
+    const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return image_error(error, error_size, "%s: cannot map", path);
+    }
+
+    // ':' is also the byte of a valid first instruction, so a file with
+    // another name that does not parse as HEX is loaded as a raw ROM
+    int result = -1;
+    bool hex_name = image_hex_name(path);
+    char message[96];
+    if (hex_name || data[0] == ':') {
+        result = image_parse_hex(data, size, rom, len, message, sizeof(message));
+        if (result != 0 && hex_name) {
+            image_error(error, error_size, "%s: %s", path, message);
+        }
+    }
+    if (result != 0 && !hex_name) {
+        if (size > ROM_SIZE && data[0] == ':') {
+            result = image_error(error, error_size, "%s: %s", path, message);
+        }
+        else if (size > ROM_SIZE) {
+            result = image_error(error, error_size, "%s: %zu bytes do not fit the %d-byte ROM",
+                                 path, size, ROM_SIZE);
+        }
+        else {
+            memset(rom, 0, ROM_SIZE);
+            memcpy(rom, data, size);
+            *len = size;
+            result = 0;
+        }
+    }
+    munmap((void *)data, size);
+    return result;
+}
+
+int image_pool_init(stImage_pool *pool, uint32_t capacity) {
+    memset(pool, 0, sizeof(*pool));
+    if (capacity == 0 || capacity == IMAGE_NONE) {
+        return -1;
+    }
+    // slots and lengths in one mapping, so sealing protects both
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (size_t)capacity * (ROM_SIZE + 1);
+    size = (size + page - 1) / page * page;
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    pool->rom = map;
+    pool->length = pool->rom + (size_t)capacity * ROM_SIZE;
+    pool->capacity = capacity;
+    pool->map_size = size;
+    return 0;
+}
+
+void image_pool_free(stImage_pool *pool) {
+    if (pool->rom != NULL) {
+        munmap(pool->rom, pool->map_size);
+    }
+    memset(pool, 0, sizeof(*pool));
+}
+
+uint32_t image_pool_add(stImage_pool *pool, const char *path, char *error, size_t error_size) {
+    size_t len;
+    if (pool->sealed || pool->count == pool->capacity) {
+        image_error(error, error_size, "%s: the image pool is %s", path, pool->sealed ? "sealed" : "full");
+        return IMAGE_NONE;
+    }
+    uint8_t *rom = pool->rom + (size_t)pool->count * ROM_SIZE;
+    if (image_load(path, rom, &len, error, error_size) != 0) {
+        return IMAGE_NONE;
+    }
+    pool->length[pool->count] = (uint8_t)len;
+    return pool->count++;
+}
+
+int image_pool_seal(stImage_pool *pool) {
+    if (mprotect(pool->rom, pool->map_size, PROT_READ) != 0) {
+        return -1;
+    }
+    pool->sealed = true;
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef CPU_IMAGE_H
+#define CPU_IMAGE_H
+
+#include "cpu_core.h"
+
+// Program image loader. A file is memory-mapped and read as Intel HEX when
+// its name ends in .hex or .ihx, or when it starts with ':' and parses as
+// HEX; otherwise it is a raw binary ROM image (0x3A, ':', is a valid first
+// instruction). Both are validated: a raw image holds 1 to ROM_SIZE bytes;
+// a HEX file has well formed records with correct checksums, only data
+// inside the ROM, no byte written twice, no non-zero extended address and
+// an end-of-file record.
+//
+// Many images can be loaded into a pool of ROM_SIZE-byte slots which is
+// made read-only once sealed, so the batch runners and the harness can
+// share one copy of every program and refer to it by index.
+
+#define IMAGE_NONE      (UINT32_MAX)
+
+typedef struct image_pool{
+    uint8_t *rom;           // "capacity" slots of ROM_SIZE bytes
+    uint8_t *length;        // bytes loaded per slot
+    uint32_t count;
+    uint32_t capacity;
+    size_t map_size;
+    bool sealed;            // read-only, no more images can be added
+} stImage_pool;
+
+// Load the image file into rom (the rest is zeroed) and its size into *len.
+// Return 0, or -1 with a message in "error".
+int image_load(const char *path, uint8_t rom[ROM_SIZE], size_t *len,
+               char *error, size_t error_size);
+// Parse Intel HEX text, same contract as image_load
+int image_parse_hex(const char *text, size_t size, uint8_t rom[ROM_SIZE], size_t *len,
+                    char *error, size_t error_size);
+
+// Reserve "capacity" slots, return 0 on success
+int image_pool_init(stImage_pool *pool, uint32_t capacity);
+void image_pool_free(stImage_pool *pool);
+// Load a file into the next slot, return its index or IMAGE_NONE
+uint32_t image_pool_add(stImage_pool *pool, const char *path, char *error, size_t error_size);
+// Make the pool read-only, return 0 on success
+int image_pool_seal(stImage_pool *pool);
+
+// ROM image of slot "index"
+static inline const uint8_t *image_pool_rom(const stImage_pool *pool, uint32_t index) {
+    return pool->rom + (size_t)index * ROM_SIZE;
+}
+
+#endif // CPU_IMAGE_H
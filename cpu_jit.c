@@ -0,0 +1,377 @@
+#define _DEFAULT_SOURCE
+#include "cpu_jit.h"
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define JIT_CODE_SIZE       (1 << 20)
+#define JIT_BLOCK_BYTES     (JIT_BLOCK_MAX * 80 + 256)     // worst case of one block
+
+#define OFF_PC              ((uint8_t)offsetof(stCpu_state, PC))
+#define OFF_R0              ((uint8_t)offsetof(stCpu_state, r0))
+#define OFF_STATUS          ((uint8_t)offsetof(stCpu_state, status))
+#define OFF_INSTRUCTION     ((uint8_t)offsetof(stCpu_state, instruction))
+#define OFF_MEMORY          ((uint8_t)offsetof(stCpu_state, memory))
+
+// Where the current value of ZF comes from, while compiling a block
+#define ZF_STATUS           (0)     // unchanged, still in cpu->status
+#define ZF_REG              (1)     // guest register zf_reg is zero
+#define ZF_SHADOW           (2)     // dl is zero (copy taken before a shift)
+
+// Flag state at some point of the block
+typedef struct jit_flags{
+    uint8_t zf_kind;
+    uint8_t zf_reg;
+    bool of_cleared;
+} stJit_flags;
+
+// Side exit: leave the block before the instruction "index" (at "pc")
+typedef struct jit_exit{
+    size_t patch;           // position of the rel32 to patch
+    uint8_t index;
+    uint8_t pc;
+    uint8_t last_instruction;
+    stJit_flags flags;
+} stJit_exit;
+
+typedef struct jit_emitter{
+    uint8_t *p;
+    stJit_exit exits[JIT_BLOCK_MAX];
+    int n_exits;
+} stJit_emitter;
+
+// guest register rg lives in host register r8b + g (encoded as g with REX)
+static void emit(stJit_emitter *e, int n, ...) {
+    va_list args;
+    va_start(args, n);
+    for (int i = 0; i < n; i++) {
+        *e->p++ = (uint8_t)va_arg(args, int);
+    }
+    va_end(args);
+}
+
+static void emit_u32(stJit_emitter *e, uint32_t value) {
+    memcpy(e->p, &value, 4);
+    e->p += 4;
+}
+
+// jcc rel32 to a side exit, patched once the exit stubs are emitted
+static void emit_side_exit(stJit_emitter *e, uint8_t *base, uint8_t cc, uint8_t index,
+                           uint8_t pc, uint8_t last_instruction, stJit_flags flags) {
+    emit(e, 2, 0x0F, cc);
+    stJit_exit *exit = &e->exits[e->n_exits++];
+    exit->patch = (size_t)(e->p - base);
+    exit->index = index;
+    exit->pc = pc;
+    exit->last_instruction = last_instruction;
+    exit->flags = flags;
+    emit_u32(e, 0);
+}
+
+// write ZF/OF back into cpu->status
+static void emit_flags(stJit_emitter *e, stJit_flags flags) {
+    if (flags.zf_kind != ZF_STATUS) {
+        if (flags.zf_kind == ZF_REG) {
+            emit(e, 3, 0x45, 0x84, 0xC0 | flags.zf_reg << 3 | flags.zf_reg);   // test rg, rg
+        }
+        else {
+            emit(e, 2, 0x84, 0xD2);                                             // test dl, dl
+        }
+        emit(e, 3, 0x0F, 0x94, 0xC0);                                           // setz al
+        emit(e, 4, 0x80, 0x67, OFF_STATUS, (uint8_t)~STATUS_ZERO);              // and [status], ~ZF
+        emit(e, 3, 0x08, 0x47, OFF_STATUS);                                     // or [status], al
+    }
+    if (flags.of_cleared) {
+        emit(e, 4, 0x80, 0x67, OFF_STATUS, (uint8_t)~STATUS_OF);                // and [status], ~OF
+    }
+}
+
+// write registers, flags and instruction register back
+static void emit_writeback(stJit_emitter *e, stJit_flags flags, bool has_last, uint8_t last_instruction) {
+    emit_flags(e, flags);
+    for (int g = 0; g < 4; g++) {
+        emit(e, 4, 0x44, 0x88, 0x47 | g << 3, OFF_R0 + g);                     // mov [rg], r8b+g
+    }
+    if (has_last) {
+        emit(e, 4, 0xC6, 0x47, OFF_INSTRUCTION, last_instruction);              // mov [instruction], imm
+    }
+}
+
+// set PC to a constant, return the step count
+static void emit_return(stJit_emitter *e, uint8_t pc, uint32_t steps) {
+    emit(e, 4, 0xC6, 0x47, OFF_PC, pc);                                         // mov [PC], imm
+    emit(e, 1, 0xB8);                                                           // mov eax, steps
+    emit_u32(e, steps);
+    emit(e, 1, 0xC3);                                                           // ret
+}
+
+// Compile the block starting at pc, return its length (0 if the first
+// instruction has to be interpreted)
+static int jit_compile(stJit_emitter *e, uint8_t *base, const uint8_t *memory, uint8_t pc) {
+    stJit_flags flags = { ZF_STATUS, 0, false };
+    int count = 0;
+    bool ended = false;
+    bool jumped = false;
+
+    e->n_exits = 0;
+
+    // prologue: load r0-r3, rsi = memory
+    for (int g = 0; g < 4; g++) {
+        emit(e, 4, 0x44, 0x8A, 0x47 | g << 3, OFF_R0 + g);                     // mov r8b+g, [rg]
+    }
+    emit(e, 4, 0x48, 0x8D, 0x77, OFF_MEMORY);                                   // lea rsi, [memory]
+
+    while (!ended && count < JIT_BLOCK_MAX && pc < ROM_SIZE) {
+        uint8_t instruction = memory[pc];
+        uint8_t opcode = instruction >> 4;
+        uint8_t H = (instruction >> 2) & 0x03;
+        uint8_t L = instruction & 0x03;
+        uint8_t last = (count > 0) ? memory[pc - 1] : 0;
+
+        // a shift overwrites the register ZF is read from: keep a copy
+        if ((opcode == shift_left || opcode == shift_right)
+            && flags.zf_kind == ZF_REG && flags.zf_reg == H) {
+            emit(e, 3, 0x44, 0x88, 0xC0 | H << 3 | 2);                          // mov dl, rH
+            flags.zf_kind = ZF_SHADOW;
+        }
+
+        switch (opcode) {
+            case mem_to_r0_1:
+            case mem_to_r0_2:
+                emit(e, 3, 0x41, 0x80, 0xF8 | L);                               // cmp rL, 0x80
+                emit(e, 1, 0x80);
+                // out of bounds: the interpreter reports the fault
+                emit_side_exit(e, base, (instruction & 0x04) ? 0x82 : 0x83,      // jb / jae
+                               (uint8_t)count, pc, last, flags);
+                emit(e, 4, 0x41, 0x0F, 0xB6, 0xC0 | L);                         // movzx eax, rL
+                emit(e, 4, 0x44, 0x8A, 0x04, 0x06);                             // mov r8b, [rsi + rax]
+                flags.zf_kind = ZF_REG;
+                flags.zf_reg = 0;
+                break;
+            case r0_to_ram_1:
+            case r0_to_ram_2:
+                emit(e, 4, 0x41, 0x0F, 0xB6, 0xC0 | L);                         // movzx eax, rL
+                emit(e, 2, 0x0C, 0x80);                                         // or al, 0x80
+                emit(e, 4, 0x44, 0x88, 0x04, 0x06);                             // mov [rsi + rax], r8b
+                flags.zf_kind = ZF_REG;
+                flags.zf_reg = 0;
+                break;
+            case rx_to_ry:
+                if (H != L) {
+                    emit(e, 3, 0x45, 0x88, 0xC0 | H << 3 | L);                  // mov rL, rH
+                }
+                flags.zf_kind = ZF_REG;
+                flags.zf_reg = L;
+                break;
+            case set_value_r0:
+                emit(e, 3, 0x41, 0xB0, instruction & 0x0F);                     // mov r8b, imm
+                flags.zf_kind = ZF_REG;
+                flags.zf_reg = 0;
+                break;
+            case add_ry_to_rx:
+            case substract_ry_by_rx:
+                emit(e, 3, 0x44, 0x88, 0xC0 | H << 3);                          // mov al, rH
+                emit(e, 3, 0x44, (opcode == add_ry_to_rx) ? 0x00 : 0x28,        // add/sub al, rL
+                     0xC0 | L << 3);
+                // overflow: the interpreter sets OF and prints the message
+                emit_side_exit(e, base, 0x82, (uint8_t)count, pc, last, flags);  // jc
+                emit(e, 3, 0x41, 0x88, 0xC0 | H);                               // mov rH, al
+                flags.zf_kind = ZF_REG;
+                flags.zf_reg = H;
+                flags.of_cleared = true;
+                break;
+            case shift_left:
+                emit(e, 4, 0x41, 0xC0, 0xE0 | H, 4);                            // shl rH, 4
+                break;
+            case shift_right:
+                emit(e, 4, 0x41, 0xC0, 0xE8 | H, 4);                            // shr rH, 4
+                break;
+            case compare_rx_with_zero_1:
+            case compare_rx_with_zero_2:
+                flags.zf_kind = ZF_REG;
+                flags.zf_reg = H;
+                break;
+            case condition_jump: {
+                emit_writeback(e, flags, true, instruction);
+                emit(e, 4, 0xF6, 0x47, OFF_STATUS, STATUS_ZERO);                // test [status], ZF
+                emit(e, 2, 0x74, 0);                                            // jz not_taken
+                uint8_t *not_taken = e->p;
+                emit(e, 4, 0x44, 0x88, 0x47 | H << 3, OFF_PC);                  // mov [PC], rH
+                emit(e, 1, 0xB8);
+                emit_u32(e, (uint32_t)count + 1);
+                emit(e, 1, 0xC3);
+                not_taken[-1] = (uint8_t)(e->p - not_taken);
+                emit_return(e, (uint8_t)(pc + 1), (uint32_t)count + 1);
+                ended = true;
+                jumped = true;
+                break;
+            }
+            case uncondition_jump:
+                emit_writeback(e, flags, true, instruction);
+                emit(e, 4, 0x44, 0x88, 0x47 | H << 3, OFF_PC);                  // mov [PC], rH
+                emit(e, 1, 0xB8);
+                emit_u32(e, (uint32_t)count + 1);
+                emit(e, 1, 0xC3);
+                ended = true;
+                jumped = true;
+                break;
+            default:
+                // input/output: end the block before it
+                ended = true;
+                continue;
+        }
+        if (!jumped) {
+            pc++;
+        }
+        count++;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    // fell through the end of the block
+    if (!jumped) {
+        emit_writeback(e, flags, true, memory[pc - 1]);
+        emit_return(e, pc, (uint32_t)count);
+    }
+    // side exit stubs
+    for (int i = 0; i < e->n_exits; i++) {
+        stJit_exit *exit = &e->exits[i];
+        int32_t rel = (int32_t)((e->p - base) - (exit->patch + 4));
+        memcpy(base + exit->patch, &rel, 4);
+        emit_writeback(e, exit->flags, exit->index > 0, exit->last_instruction);
+        emit_return(e, exit->pc, exit->index);
+    }
+    return count;
+}
+
+int jit_init(stCpu_jit *jit) {
+    memset(jit, 0, sizeof(*jit));
+    void *code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        return -1;
+    }
+    jit->code = (uint8_t *)code;
+    jit->code_size = JIT_CODE_SIZE;
+    return 0;
+}
+
+void jit_free(stCpu_jit *jit) {
+    if (jit->code != NULL) {
+        munmap(jit->code, jit->code_size);
+    }
+    memset(jit, 0, sizeof(*jit));
+}
+
+static void jit_flush(stCpu_jit *jit) {
+    memset(jit->block, 0, sizeof(jit->block));
+    jit->code_used = 0;
+}
+
+void jit_sync(stCpu_jit *jit, const stCpu_state *cpu) {
+    if (memcmp(jit->rom, cpu->memory, ROM_SIZE) != 0) {
+        memcpy(jit->rom, cpu->memory, ROM_SIZE);
+        jit_flush(jit);
+    }
+}
+
+// Compile the block at pc (ROM only)
+static void jit_compile_block(stCpu_jit *jit, uint8_t pc) {
+    stJit_emitter e;
+    if (jit->code_used + JIT_BLOCK_BYTES > jit->code_size) {
+        jit_flush(jit);
+    }
+    // W^X: only the pages the block may be emitted to are writable, and
+    // only while it is emitted
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+    uint8_t *base = jit->code + jit->code_used;
+    uint8_t *first = (uint8_t *)((uintptr_t)base & ~page);
+    size_t span = (((uintptr_t)base + JIT_BLOCK_BYTES + page) & ~page) - (uintptr_t)first;
+
+    // until the block is in place, the instruction at pc is interpreted
+    stJit_block *block = &jit->block[pc];
+    block->compiled = true;
+    block->code = NULL;
+    if (mprotect(first, span, PROT_READ | PROT_WRITE) != 0) {
+        return;
+    }
+    e.p = base;
+    int length = jit_compile(&e, base, jit->rom, pc);
+    if (mprotect(first, span, PROT_READ | PROT_EXEC) != 0) {
+        // the blocks already on these pages cannot run either
+        jit_flush(jit);
+        block->compiled = true;
+        return;
+    }
+    block->length = (uint8_t)length;
+    if (length > 0) {
+        block->code = (jit_block_fn)(void *)base;
+        jit->code_used += (size_t)(e.p - base);
+        jit->code_used = (jit->code_used + 15) & ~(size_t)15;
+    }
+}
+
+uint64_t run_cpu_jit(stCpu_state *cpu, stCpu_jit *jit, const stCpu_io *io, uint64_t max_steps) {
+    uint64_t steps = 0;
+    uint64_t limit = (max_steps != 0) ? max_steps : UINT64_MAX;
+
+    if (jit->code == NULL) {
+        return run_cpu(cpu, io, max_steps);
+    }
+    // the blocks are compiled from this ROM image
+    jit_sync(jit, cpu);
+
+    while (cpu->halt == HALT_NONE) {
+        if (steps == limit) {
+            cpu->halt = HALT_STEP_LIMIT;
+            break;
+        }
+        uint8_t pc = cpu->PC;
+        if (pc < ROM_SIZE) {
+            stJit_block *block = &jit->block[pc];
+            if (!block->compiled) {
+                jit_compile_block(jit, pc);
+            }
+            if (block->code != NULL && block->length <= limit - steps) {
+                uint32_t done = block->code(cpu);
+                if (done > 0) {
+                    steps += done;
+                    continue;
+                }
+            }
+        }
+        // instruction left to the interpreter
+        step_cpu(cpu, io);
+        steps++;
+    }
+    return steps;
+}
+
+#else
+
+int jit_init(stCpu_jit *jit) {
+    memset(jit, 0, sizeof(*jit));
+    return 0;
+}
+
+void jit_free(stCpu_jit *jit) {
+    memset(jit, 0, sizeof(*jit));
+}
+
+void jit_sync(stCpu_jit *jit, const stCpu_state *cpu) {
+    (void)jit;
+    (void)cpu;
+}
+
+// no JIT on this host: run the switch interpreter
+uint64_t run_cpu_jit(stCpu_state *cpu, stCpu_jit *jit, const stCpu_io *io, uint64_t max_steps) {
+    (void)jit;
+    return run_cpu(cpu, io, max_steps);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef CPU_JIT_H
+#define CPU_JIT_H
+
+#include "cpu_core.h"
+
+// Basic-block JIT for x86-64 Linux: blocks of ROM code are translated to
+// native code the first time PC reaches them, with r0-r3 pinned to host
+// registers and ZF/OF written back to status only when the block exits.
+// A block ends at condition_jump/uncondition_jump, before input/output
+// (those stay in the interpreter) and at the end of ROM. Add/sub overflow
+// and out-of-bounds loads leave the block and run in the interpreter, so
+// diagnostics and faults are exactly those of run_cpu().
+//
+// Only ROM is compiled: stores are masked into RAM, so compiled code can
+// never be overwritten, and code running from RAM (the only place a
+// program can modify itself) always goes through the interpreter.
+//
+// On other hosts run_cpu_jit() is the switch interpreter.
+
+#define JIT_BLOCK_MAX       (64)        // instructions per block
+
+typedef uint32_t (*jit_block_fn)(stCpu_state *cpu);
+
+typedef struct jit_block{
+    jit_block_fn code;      // NULL: the instruction at this PC is interpreted
+    uint8_t length;         // instructions in the block
+    bool compiled;
+} stJit_block;
+
+typedef struct cpu_jit{
+    uint8_t *code;          // executable buffer
+    size_t code_size;
+    size_t code_used;
+    stJit_block block[ROM_SIZE];
+    uint8_t rom[ROM_SIZE];  // ROM image the blocks were compiled from
+} stCpu_jit;
+
+// Allocate the code buffer, return 0 on success
+int jit_init(stCpu_jit *jit);
+void jit_free(stCpu_jit *jit);
+// Drop the compiled blocks if the ROM of cpu differs from the compiled one
+void jit_sync(stCpu_jit *jit, const stCpu_state *cpu);
+
+// Same as run_cpu, executing compiled blocks where possible
+uint64_t run_cpu_jit(stCpu_state *cpu, stCpu_jit *jit, const stCpu_io *io, uint64_t max_steps);
+
+#endif // CPU_JIT_H
@@ -0,0 +1,246 @@
+#include "cpu_memo.h"
+#include <stdlib.h>
+#include <string.h>
+
+int memo_init(stCpu_memo *memo, uint32_t capacity) {
+    memset(memo, 0, sizeof(*memo));
+    if (capacity == 0 || capacity >= MEMO_NONE / 2) {
+        return -1;
+    }
+    uint32_t buckets = 1;
+    while (buckets < capacity * 2) {
+        buckets <<= 1;
+    }
+    memo->entry = malloc((size_t)capacity * sizeof(*memo->entry));
+    memo->bucket = malloc((size_t)buckets * sizeof(*memo->bucket));
+    if (memo->entry == NULL || memo->bucket == NULL) {
+        memo_free(memo);
+        return -1;
+    }
+    for (uint32_t i = 0; i < buckets; i++) {
+        memo->bucket[i] = MEMO_NONE;
+    }
+    memo->bucket_mask = buckets - 1;
+    memo->capacity = capacity;
+    memo->newest = MEMO_NONE;
+    memo->oldest = MEMO_NONE;
+    return 0;
+}
+
+void memo_free(stCpu_memo *memo) {
+    free(memo->entry);
+    free(memo->bucket);
+    memset(memo, 0, sizeof(*memo));
+}
+
+static uint64_t memo_mix(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+
+static uint64_t memo_rom_hash(const stCpu_state *cpu) {
+    uint64_t hash = 0;
+    for (int i = 0; i < ROM_SIZE; i += 8) {
+        uint64_t word;
+        memcpy(&word, cpu->memory + i, 8);
+        hash = memo_mix(hash, word);
+    }
+    return hash;
+}
+
+// ---- LRU list and hash chains ----
+
+static void memo_unlink(stCpu_memo *memo, uint32_t index) {
+    stMemo_entry *entry = &memo->entry[index];
+    if (entry->newer != MEMO_NONE) memo->entry[entry->newer].older = entry->older;
+    else memo->newest = entry->older;
+    if (entry->older != MEMO_NONE) memo->entry[entry->older].newer = entry->newer;
+    else memo->oldest = entry->newer;
+}
+
+static void memo_push_newest(stCpu_memo *memo, uint32_t index) {
+    stMemo_entry *entry = &memo->entry[index];
+    entry->newer = MEMO_NONE;
+    entry->older = memo->newest;
+    if (memo->newest != MEMO_NONE) memo->entry[memo->newest].newer = index;
+    else memo->oldest = index;
+    memo->newest = index;
+}
+
+static void memo_unchain(stCpu_memo *memo, uint32_t index) {
+    uint32_t *link = &memo->bucket[memo->entry[index].hash & memo->bucket_mask];
+    while (*link != index) {
+        link = &memo->entry[*link].chain;
+    }
+    *link = memo->entry[index].chain;
+}
+
+// Entry for a new result: a free one, or the least recently used
+static uint32_t memo_allocate(stCpu_memo *memo) {
+    if (memo->count < memo->capacity) {
+        return memo->count++;
+    }
+    uint32_t index = memo->oldest;
+    memo_unlink(memo, index);
+    memo_unchain(memo, index);
+    memo->evictions++;
+    return index;
+}
+
+static uint32_t memo_find(const stCpu_memo *memo, const stMemo_entry *key) {
+    uint32_t index = memo->bucket[key->hash & memo->bucket_mask];
+    while (index != MEMO_NONE) {
+        const stMemo_entry *entry = &memo->entry[index];
+        if (entry->hash == key->hash && entry->rom_hash == key->rom_hash
+            && memcmp(entry->start, key->start, sizeof(key->start)) == 0
+            && entry->n_inputs == key->n_inputs
+            && memcmp(entry->inputs, key->inputs, key->n_inputs) == 0) {
+            return index;
+        }
+        index = entry->chain;
+    }
+    return MEMO_NONE;
+}
+
+// ---- runs ----
+
+#define MEMO_WRITTEN(written, i)    (((written)[(i) / 8] >> ((i) % 8)) & 1)
+
+// run_cpu that tracks the RAM bytes written by the run, and clears *pure
+// on a read or fetch of one it did not write
+static uint64_t memo_run_tracked(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps,
+                                 uint8_t written[RAM_SIZE / 8], bool *pure) {
+    uint64_t steps = 0;
+    while (cpu->halt == HALT_NONE) {
+        if (max_steps != 0 && steps >= max_steps) {
+            cpu->halt = HALT_STEP_LIMIT;
+            break;
+        }
+        uint8_t pc = cpu->PC;
+        uint8_t instruction = cpu->memory[pc];
+        uint8_t address = get_register_value(cpu, (Register)(instruction & 0x03));
+        switch (instruction >> 4) {
+        case mem_to_r0_1:
+        case mem_to_r0_2:
+            if ((instruction & 0x04) && address >= ROM_SIZE
+                && !MEMO_WRITTEN(written, address - ROM_SIZE)) {
+                *pure = false;
+            }
+            break;
+        case r0_to_ram_1:
+        case r0_to_ram_2:
+            written[address % RAM_SIZE / 8] |= (uint8_t)(1 << (address % 8));
+            break;
+        }
+        if (pc >= ROM_SIZE && !MEMO_WRITTEN(written, pc - ROM_SIZE)) {
+            *pure = false;
+        }
+        fetch_instruction(cpu);
+        execute_instruction(cpu, decode_instruction(cpu), io);
+        steps++;
+    }
+    return steps;
+}
+
+uint64_t memo_run(stCpu_memo *memo, stCpu_state *cpu, const uint8_t *in, size_t in_len,
+                  uint8_t *out, size_t out_cap, size_t *out_len, uint64_t max_steps) {
+    stCpu_buffer buffer;
+    stCpu_io io;
+    cpu_buffer_io(&io, &buffer, in, in_len, out, out_cap);
+
+    if (in_len > MEMO_INPUT_CAP || cpu->halt != HALT_NONE) {
+        memo->misses++;
+        memo->uncached++;
+        uint64_t steps = run_cpu(cpu, &io, max_steps);
+        *out_len = buffer.out_len;
+        return steps;
+    }
+
+    stMemo_entry key;
+    key.rom_hash = memo_rom_hash(cpu);
+    key.start[0] = cpu->PC;
+    key.start[1] = cpu->r0;
+    key.start[2] = cpu->r1;
+    key.start[3] = cpu->r2;
+    key.start[4] = cpu->r3;
+    key.start[5] = cpu->status;
+    key.n_inputs = (uint8_t)in_len;
+    memcpy(key.inputs, in, in_len);
+    uint64_t hash = key.rom_hash;
+    for (int i = 0; i < 6; i++) {
+        hash = memo_mix(hash, key.start[i]);
+    }
+    for (size_t i = 0; i < in_len; i++) {
+        hash = memo_mix(hash, in[i] | (uint64_t)(i + 1) << 8);
+    }
+    key.hash = hash;
+
+    // a result that took more steps than the budget allows is not replayed:
+    // the real run stops at the budget
+    uint32_t index = memo_find(memo, &key);
+    if (index != MEMO_NONE && (max_steps == 0 || memo->entry[index].steps <= max_steps)) {
+        // replay the result: registers, RAM bytes written, output
+        const stMemo_entry *entry = &memo->entry[index];
+        cpu->PC = entry->end[0];
+        cpu->r0 = entry->end[1];
+        cpu->r1 = entry->end[2];
+        cpu->r2 = entry->end[3];
+        cpu->r3 = entry->end[4];
+        cpu->status = entry->end[5];
+        cpu->instruction = entry->end[6];
+        cpu->halt = entry->end[7];
+        for (int i = 0; i < RAM_SIZE; i++) {
+            if (MEMO_WRITTEN(entry->written, i)) {
+                cpu->memory[ROM_SIZE + i] = entry->ram[i];
+            }
+        }
+        if (entry->out_len != 0 && out_cap != 0) {
+            out[0] = entry->output;
+        }
+        *out_len = entry->out_len;
+        memo_unlink(memo, index);
+        memo_push_newest(memo, index);
+        memo->hits++;
+        return entry->steps;
+    }
+
+    memo->misses++;
+    uint8_t written[RAM_SIZE / 8] = { 0 };
+    bool pure = true;
+    uint64_t steps = memo_run_tracked(cpu, &io, max_steps, written, &pure);
+    *out_len = buffer.out_len;
+    if (!pure) {
+        memo->impure++;
+        return steps;
+    }
+    if (cpu->halt == HALT_STEP_LIMIT || buffer.out_len > 1
+        || (buffer.out_len != 0 && out_cap == 0)) {
+        memo->uncached++;
+        return steps;
+    }
+
+    index = memo_allocate(memo);
+    stMemo_entry *entry = &memo->entry[index];
+    entry->hash = hash;
+    entry->rom_hash = key.rom_hash;
+    memcpy(entry->start, key.start, sizeof(key.start));
+    entry->n_inputs = key.n_inputs;
+    memcpy(entry->inputs, key.inputs, in_len);
+    entry->steps = steps;
+    entry->end[0] = cpu->PC;
+    entry->end[1] = cpu->r0;
+    entry->end[2] = cpu->r1;
+    entry->end[3] = cpu->r2;
+    entry->end[4] = cpu->r3;
+    entry->end[5] = cpu->status;
+    entry->end[6] = cpu->instruction;
+    entry->end[7] = cpu->halt;
+    entry->out_len = (uint8_t)buffer.out_len;
+    entry->output = buffer.out_len != 0 ? out[0] : 0;
+    memcpy(entry->written, written, sizeof(written));
+    memcpy(entry->ram, cpu->memory + ROM_SIZE, RAM_SIZE);
+    entry->chain = memo->bucket[hash & memo->bucket_mask];
+    memo->bucket[hash & memo->bucket_mask] = index;
+    memo_push_newest(memo, index);
+    return steps;
+}
@@ -0,0 +1,72 @@
+#ifndef CPU_MEMO_H
+#define CPU_MEMO_H
+
+#include "cpu_core.h"
+
+// Result cache for programs that are pure functions of their inputs.
+//
+// A run is keyed by a hash of the ROM image, the registers it starts from
+// and the input bytes fed to input_external (0 once they are exhausted, as
+// with the buffer backend). A miss runs the program on an interpreter that
+// watches every RAM read: reading a RAM byte (or fetching an instruction
+// from RAM) that the run has not written itself makes the run impure, as
+// its result then depends on memory left by an earlier run, and it is not
+// cached. A pure run stores its step count, final registers, output and the
+// RAM bytes it wrote; a hit replays those onto the state without emulating.
+//
+// Runs stopped by the step budget and runs with more than MEMO_INPUT_CAP
+// inputs are not cached, and a result is only replayed when it fits in
+// the step budget of the call. Diagnostics (overflow, out of bounds) are not
+// reported. The cache holds "capacity" entries and evicts the least
+// recently used. Two ROMs with the same 64-bit hash would share entries.
+
+#define MEMO_INPUT_CAP  (32)
+#define MEMO_NONE       (UINT32_MAX)
+
+typedef struct memo_entry{
+    uint64_t hash;                      // of everything below up to inputs
+    uint64_t rom_hash;
+    uint8_t start[6];                   // PC, r0..r3, status at the start
+    uint8_t n_inputs;
+    uint8_t inputs[MEMO_INPUT_CAP];
+    // result
+    uint64_t steps;
+    uint8_t end[8];                     // PC, r0..r3, status, instruction, halt
+    uint8_t out_len;                    // output_external halts: 0 or 1
+    uint8_t output;
+    uint8_t written[RAM_SIZE / 8];      // RAM bytes the run wrote
+    uint8_t ram[RAM_SIZE];
+    // hash chain and LRU list
+    uint32_t chain;
+    uint32_t newer;
+    uint32_t older;
+} stMemo_entry;
+
+typedef struct cpu_memo{
+    stMemo_entry *entry;
+    uint32_t *bucket;
+    uint32_t bucket_mask;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t newest;
+    uint32_t oldest;
+    // statistics
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t impure;                    // misses not cached: impure run
+    uint64_t uncached;                  // misses not cached: step limit, inputs
+    uint64_t evictions;
+} stCpu_memo;
+
+// Allocate "capacity" entries, return 0 on success
+int memo_init(stCpu_memo *memo, uint32_t capacity);
+void memo_free(stCpu_memo *memo);
+
+// Run cpu on the inputs to halt or to max_steps instructions (0 = no limit)
+// like run_cpu on the buffer backend, from the cache when possible. The
+// output goes to out[0] when out_cap != 0 and the number of outputs to
+// *out_len. Return the number of executed instructions.
+uint64_t memo_run(stCpu_memo *memo, stCpu_state *cpu, const uint8_t *in, size_t in_len,
+                  uint8_t *out, size_t out_cap, size_t *out_len, uint64_t max_steps);
+
+#endif // CPU_MEMO_H
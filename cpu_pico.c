@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "cpu_core.h"
+#include "cpu_timing.h"
+#include "cpu_dual.h"
+
+// Pico adapter of the emulator core: USB stdio backend and paced main loop
+//
+// Build with the Pico SDK (and pico_multicore) together with cpu_core.c,
+// cpu_timing.c and cpu_dual.c
+
+// Virtual clock of the emulated CPU, paced to real time; 0 runs it as fast
+// as possible
+#ifndef PICO_CPU_HZ
+#define PICO_CPU_HZ     (10)
+#endif
+
+// 0 runs everything on core 0, DUAL_IO moves the console to core 1 and
+// DUAL_PAIR runs a second CPU (the factorial program) on core 1
+#ifndef PICO_DUAL_MODE
+#define PICO_DUAL_MODE  (0)
+#endif
+
+// Input of the factorial program in DUAL_PAIR. The console belongs to the
+// CPU on core 0, so core 1 runs on a buffer backend and core 0 prints its
+// output once both have halted.
+#ifndef PICO_PAIR_INPUT
+#define PICO_PAIR_INPUT (5)
+#endif
+
+// external input: one decimal digit typed on the USB console
+static uint8_t pico_input(void *ctx) {
+    (void)ctx;
+    int c = getchar();
+    printf("?");
+    putchar(c);
+    if (c >= '0' && c <= '9') {
+        return (uint8_t)(c - '0');
+    }
+    return 0;
+}
+
+// external output
+static void pico_output(void *ctx, uint8_t value) {
+    (void)ctx;
+    printf("\n%d\n", value);
+}
+
+static void pico_message(void *ctx, const char *text) {
+    (void)ctx;
+    printf("%s", text);
+}
+
+// the same digit on the I/O core, without blocking
+static int pico_poll(void *ctx) {
+    (void)ctx;
+    int c = getchar_timeout_us(0);
+    if (c == PICO_ERROR_TIMEOUT) {
+        return -1;
+    }
+    printf("?");
+    putchar(c);
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    return 0;
+}
+
+static const stCpu_io gPico_io = {
+    .ctx = NULL,
+    .input = pico_input,
+    .output = pico_output,
+    .message = pico_message,
+};
+
+static const stDual_device gPico_device = {
+    .ctx = NULL,
+    .poll = pico_poll,
+    .output = pico_output,
+    .message = pico_message,
+};
+
+stCpu_state gCpu_instance;
+stCpu_timing gCpu_timing;
+stDual_io gDual_io;
+stCpu_state gCpu_core1;
+stCpu_timing gTiming_core1;
+stDual_core gDual_core1;
+stCpu_io gPair_io;
+stCpu_buffer gPair_buffer;
+uint8_t gPair_input = PICO_PAIR_INPUT;
+uint8_t gPair_output;
+
+static uint64_t pico_now_us(void) {
+    return time_us_64();
+}
+
+static void pico_sleep_us(uint64_t us) {
+    sleep_us(us);
+}
+
+static void pico_idle(void) {
+    tight_loop_contents();
+}
+
+// core 1 of DUAL_IO: the console
+static void pico_io_core(void) {
+    while (dual_io_service(&gDual_io, &gPico_device)) {
+        tight_loop_contents();
+    }
+}
+
+// core 1 of DUAL_PAIR: its own CPU
+static void pico_pair_core(void) {
+    dual_core_run(&gDual_core1);
+}
+
+// ------------------------------------
+// Main function
+int main() {
+    // PICO stdio initialization
+    stdio_usb_init();
+    while(!stdio_usb_connected());
+
+    sleep_ms(100);
+    initialize_cpu(&gCpu_instance);             // initilization components of cpu
+    load_addition_program(&gCpu_instance);      // load the program into ROM
+    printf("CPU is initialized!\n");
+
+    timing_init(&gCpu_timing, PICO_CPU_HZ != 0 ? TIMING_CYCLES : TIMING_FAST, PICO_CPU_HZ);
+    timing_pace(&gCpu_timing, 0, pico_now_us, pico_sleep_us);
+    if (PICO_DUAL_MODE == DUAL_IO) {
+        stCpu_io io;
+        dual_io_init(&gDual_io, &io, pico_idle);
+        multicore_launch_core1(pico_io_core);
+        run_cpu_timed(&gCpu_instance, &io, &gCpu_timing, 0);
+        dual_io_finish(&gDual_io);
+    }
+    else {
+        if (PICO_DUAL_MODE == DUAL_PAIR) {
+            initialize_cpu(&gCpu_core1);
+            load_factorial_program(&gCpu_core1);
+            gTiming_core1 = gCpu_timing;
+            cpu_buffer_io(&gPair_io, &gPair_buffer, &gPair_input, 1, &gPair_output, 1);
+            gDual_core1.cpu = &gCpu_core1;
+            gDual_core1.io = &gPair_io;
+            gDual_core1.timing = &gTiming_core1;
+            multicore_launch_core1(pico_pair_core);
+        }
+        run_cpu_timed(&gCpu_instance, &gPico_io, &gCpu_timing, 0);
+        if (PICO_DUAL_MODE == DUAL_PAIR) {
+            while (!atomic_load(&gDual_core1.done)) {
+                tight_loop_contents();
+            }
+            printf("core 1: factorial(%d)", gPair_input);
+            if (gPair_buffer.out_len != 0) {
+                printf(" = %d\n", gPair_output);
+            }
+            else {
+                printf(" stopped without output\n");
+            }
+        }
+    }
+
+    // once halted, drive cpu into an infinite loop
+    while (1) {
+        tight_loop_contents();
+    }
+    return 0;
+}
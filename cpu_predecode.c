@@ -0,0 +1,230 @@
+#include "cpu_predecode.h"
+#include <string.h>
+
+// Turn one instruction byte into a micro-op
+stMicro_op predecode_instruction(uint8_t instruction) {
+    static const uint8_t handler_of_opcode[16] = {
+        UOP_LOAD_ROM,    UOP_LOAD_ROM,     UOP_STORE,   UOP_STORE,
+        UOP_TRANSFER,    UOP_SET,          UOP_ADD,     UOP_SUB,
+        UOP_SHIFT_LEFT,  UOP_SHIFT_RIGHT,  UOP_COMPARE, UOP_COMPARE,
+        UOP_OUTPUT,      UOP_INPUT,        UOP_COND_JUMP, UOP_UNCOND_JUMP,
+    };
+    stMicro_op op;
+    memset(&op, 0, sizeof(op));
+    op.handler = handler_of_opcode[instruction >> 4];
+    if (op.handler == UOP_LOAD_ROM && (instruction & 0x04)) {
+        op.handler = UOP_LOAD_RAM;                  // select bit = 1
+    }
+    op.reg_h = (instruction >> 2) & 0x03;
+    op.reg_l = instruction & 0x03;
+    op.imm = instruction & 0x0F;
+    op.instruction = instruction;
+    return op;
+}
+
+// drop the decoded RAM entries, they are decoded again on first execution
+static void predecode_clear_ram(stCpu_predecode *cache) {
+    memset(&(cache->op[ROM_SIZE]), 0, RAM_SIZE * sizeof(stMicro_op));
+    cache->ram_decoded = false;
+}
+
+// Build the cache for the program in cpu->memory
+void predecode_program(stCpu_predecode *cache, const stCpu_state *cpu) {
+    for (int address = 0; address < ROM_SIZE; address++) {
+        cache->op[address] = predecode_instruction(cpu->memory[address]);
+    }
+    memcpy(cache->rom, cpu->memory, ROM_SIZE);
+    predecode_clear_ram(cache);
+}
+
+// Make the cache valid for cpu
+void predecode_sync(stCpu_predecode *cache, const stCpu_state *cpu) {
+    if (memcmp(cache->rom, cpu->memory, ROM_SIZE) != 0) {
+        predecode_program(cache, cpu);
+    }
+    else if (cache->ram_decoded) {
+        predecode_clear_ram(cache);
+    }
+}
+
+#if defined(__GNUC__)
+
+#define ZERO_BIT(value)    (((value) == 0) ? STATUS_ZERO : 0)
+
+uint64_t run_cpu_predecoded(stCpu_state *cpu, stCpu_predecode *cache,
+                            const stCpu_io *io, uint64_t max_steps) {
+    static void *const dispatch_table[] = {
+        [UOP_DECODE]       = &&op_decode,
+        [UOP_LOAD_ROM]     = &&op_load_rom,
+        [UOP_LOAD_RAM]     = &&op_load_ram,
+        [UOP_STORE]        = &&op_store,
+        [UOP_TRANSFER]     = &&op_transfer,
+        [UOP_SET]          = &&op_set,
+        [UOP_ADD]          = &&op_add,
+        [UOP_SUB]          = &&op_sub,
+        [UOP_SHIFT_LEFT]   = &&op_shift_left,
+        [UOP_SHIFT_RIGHT]  = &&op_shift_right,
+        [UOP_COMPARE]      = &&op_compare,
+        [UOP_OUTPUT]       = &&op_output,
+        [UOP_INPUT]        = &&op_input,
+        [UOP_COND_JUMP]    = &&op_cond_jump,
+        [UOP_UNCOND_JUMP]  = &&op_uncond_jump,
+    };
+    uint8_t *memory = cpu->memory;
+    stMicro_op *ops = cache->op;
+    const stMicro_op *op = NULL;
+    uint8_t reg[4] = { cpu->r0, cpu->r1, cpu->r2, cpu->r3 };
+    uint8_t PC = cpu->PC;
+    uint8_t at = 0;                 // address of the current micro-op
+    uint8_t status = cpu->status;
+    uint8_t halt = cpu->halt;
+    uint64_t steps = 0;
+    uint64_t limit = (max_steps != 0) ? max_steps : UINT64_MAX;
+
+    if (halt != HALT_NONE) {
+        return 0;
+    }
+
+// take the micro-op at PC and jump to its handler
+#define DISPATCH()                                          \
+    do {                                                    \
+        if (steps == limit) {                               \
+            halt = HALT_STEP_LIMIT;                         \
+            goto done;                                      \
+        }                                                   \
+        at = PC;                                            \
+        op = &ops[at];                                      \
+        PC += 1;                                            \
+        steps++;                                            \
+        goto *dispatch_table[op->handler];                  \
+    } while (0)
+
+#define REG_H   reg[op->reg_h]
+#define REG_L   reg[op->reg_l]
+#define SET_ZF(value)   (status = (status & ~STATUS_ZERO) | ZERO_BIT(value))
+
+    DISPATCH();
+
+op_decode:
+    // only RAM entries are left undecoded
+    ops[at] = predecode_instruction(memory[at]);
+    cache->ram_decoded = true;
+    goto *dispatch_table[op->handler];
+op_load_rom: {
+        uint8_t address = REG_L;
+        if (address >= ROM_SIZE) {
+            if (io->message != NULL) io->message(io->ctx, "ROM access out of bounds.\n");
+            halt = HALT_ROM_READ;
+            goto done;
+        }
+        reg[0] = memory[address];
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_load_ram: {
+        uint8_t address = REG_L;
+        if (address < ROM_SIZE) {
+            if (io->message != NULL) io->message(io->ctx, "RAM access out of bounds.\n");
+            halt = HALT_RAM_READ;
+            goto done;
+        }
+        reg[0] = memory[address];
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_store: {
+        uint8_t address = REG_L % 128 + 0x80;
+        memory[address] = reg[0];
+        ops[address].handler = UOP_DECODE;      // invalidate the decoded entry
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_transfer: {
+        uint8_t value = REG_H;
+        REG_L = value;
+        SET_ZF(value);
+        DISPATCH();
+    }
+op_set:
+    reg[0] = op->imm;
+    SET_ZF(reg[0]);
+    DISPATCH();
+op_add: {
+        int16_t result = REG_H + REG_L;
+        REG_H = (uint8_t)result;
+        if (result > 0xFF) {
+            status |= STATUS_OF;
+            if (io->message != NULL) io->message(io->ctx, "\nOverflow occurs in addition operation!\n");
+        }
+        else {
+            SET_ZF((uint8_t)result);
+            status &= ~STATUS_OF;
+        }
+        DISPATCH();
+    }
+op_sub: {
+        int16_t result = REG_H - REG_L;
+        REG_H = (uint8_t)result;
+        if (result < 0) {
+            status |= STATUS_OF;
+            if (io->message != NULL) io->message(io->ctx, "\nOverflow occurs in subtraction operation!\n");
+        }
+        else {
+            SET_ZF((uint8_t)result);
+            status &= ~STATUS_OF;
+        }
+        DISPATCH();
+    }
+op_shift_left:
+    REG_H = (uint8_t)(REG_H << 4);
+    DISPATCH();
+op_shift_right:
+    REG_H = REG_H >> 4;
+    DISPATCH();
+op_compare:
+    SET_ZF(REG_H);
+    DISPATCH();
+op_output:
+    io->output(io->ctx, REG_H);
+    halt = HALT_OUTPUT;
+    goto done;
+op_input:
+    REG_H = io->input(io->ctx);
+    DISPATCH();
+op_cond_jump:
+    if (status & STATUS_ZERO) {
+        PC = REG_H;
+    }
+    DISPATCH();
+op_uncond_jump:
+    PC = REG_H;
+    DISPATCH();
+
+done:
+#undef DISPATCH
+#undef REG_H
+#undef REG_L
+#undef SET_ZF
+    cpu->PC = PC;
+    cpu->r0 = reg[0];
+    cpu->r1 = reg[1];
+    cpu->r2 = reg[2];
+    cpu->r3 = reg[3];
+    cpu->status = status;
+    if (op != NULL) {
+        cpu->instruction = op->instruction;
+    }
+    cpu->halt = halt;
+    return steps;
+}
+
+#else
+
+// no computed goto on this compiler: fall back to the switch interpreter
+uint64_t run_cpu_predecoded(stCpu_state *cpu, stCpu_predecode *cache,
+                            const stCpu_io *io, uint64_t max_steps) {
+    (void)cache;
+    return run_cpu(cpu, io, max_steps);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CPU_PREDECODE_H
+#define CPU_PREDECODE_H
+
+#include "cpu_core.h"
+
+// Predecoded instruction cache: every memory byte is turned once into a
+// ready-to-run micro-op (handler, resolved registers, immediate), so the
+// interpreter loop does not extract opcode/reg_H/reg_L/select_bit again on
+// every step. The ROM half is decoded up front; the RAM half is decoded the
+// first time PC reaches it, and a store into RAM drops the decoded entry.
+
+// Handlers of a micro-op
+#define UOP_DECODE          (0)     // not decoded yet
+#define UOP_LOAD_ROM        (1)
+#define UOP_LOAD_RAM        (2)
+#define UOP_STORE           (3)
+#define UOP_TRANSFER        (4)
+#define UOP_SET             (5)
+#define UOP_ADD             (6)
+#define UOP_SUB             (7)
+#define UOP_SHIFT_LEFT      (8)
+#define UOP_SHIFT_RIGHT     (9)
+#define UOP_COMPARE         (10)
+#define UOP_OUTPUT          (11)
+#define UOP_INPUT           (12)
+#define UOP_COND_JUMP       (13)
+#define UOP_UNCOND_JUMP     (14)
+
+typedef struct micro_op{
+    uint8_t handler;
+    uint8_t reg_h;          // register index of bits 3:2
+    uint8_t reg_l;          // register index of bits 1:0
+    uint8_t imm;            // immediate of set_value_r0
+    uint8_t instruction;    // raw byte, kept for the instruction register
+    uint8_t reserved[3];
+} stMicro_op;
+
+typedef struct cpu_predecode{
+    stMicro_op op[MEM_SIZE];
+    uint8_t rom[ROM_SIZE];  // ROM image the cache was built from
+    bool ram_decoded;       // some RAM entries were decoded since the last sync
+} stCpu_predecode;
+
+// Turn one instruction byte into a micro-op
+stMicro_op predecode_instruction(uint8_t instruction);
+// Build the cache for the program in cpu->memory
+void predecode_program(stCpu_predecode *cache, const stCpu_state *cpu);
+// Make the cache valid for cpu: rebuild it if the ROM differs, otherwise
+// only drop the RAM entries decoded by the previous run
+void predecode_sync(stCpu_predecode *cache, const stCpu_state *cpu);
+
+// Same as run_cpu, executing from the predecoded cache. The cache must be
+// valid for cpu (predecode_program or predecode_sync).
+uint64_t run_cpu_predecoded(stCpu_state *cpu, stCpu_predecode *cache,
+                            const stCpu_io *io, uint64_t max_steps);
+
+#endif // CPU_PREDECODE_H
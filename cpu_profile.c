@@ -0,0 +1,77 @@
+#include "cpu_profile.h"
+
+#if defined(CPU_PROFILE)
+_Thread_local stCpu_profile *gCpu_profile = NULL;
+#endif
+
+static const char *const gOpcode_names[16] = {
+    "mem_to_r0", "mem_to_r0", "r0_to_ram", "r0_to_ram",
+    "rx_to_ry", "set_value_r0", "add_ry_to_rx", "substract_ry_by_rx",
+    "shift_left", "shift_right", "compare_rx_with_zero", "compare_rx_with_zero",
+    "output_external", "input_external", "condition_jump", "uncondition_jump",
+};
+
+void cpu_profile_attach(stCpu_profile *profile) {
+#if defined(CPU_PROFILE)
+    gCpu_profile = profile;
+#else
+    (void)profile;
+#endif
+}
+
+int cpu_profile_write_json(const stCpu_profile *profile, const stCpu_state *cpu, FILE *f) {
+    uint64_t steps = 0;
+    const char *separator = "";
+
+    for (int pc = 0; pc < MEM_SIZE; pc++) {
+        steps += profile->pc[pc];
+    }
+    fprintf(f, "{\n  \"steps\": %llu,\n  \"opcodes\": {", (unsigned long long)steps);
+    for (int opcode = 0; opcode < 16; opcode++) {
+        if (profile->opcode[opcode] != 0) {
+            fprintf(f, "%s\n    \"0x%X %s\": %llu", separator, opcode, gOpcode_names[opcode],
+                    (unsigned long long)profile->opcode[opcode]);
+            separator = ",";
+        }
+    }
+    fprintf(f, "\n  },\n  \"pcs\": [");
+    separator = "";
+    for (int pc = 0; pc < MEM_SIZE; pc++) {
+        if (profile->pc[pc] == 0) {
+            continue;
+        }
+        uint8_t instruction = cpu->memory[pc];
+        fprintf(f, "%s\n    { \"pc\": %d, \"instruction\": \"0x%02X\", \"op\": \"%s\", \"count\": %llu",
+                separator, pc, instruction, gOpcode_names[instruction >> 4],
+                (unsigned long long)profile->pc[pc]);
+        if ((instruction >> 4) == condition_jump) {
+            fprintf(f, ", \"taken\": %llu, \"not_taken\": %llu",
+                    (unsigned long long)profile->taken[pc], (unsigned long long)profile->not_taken[pc]);
+        }
+        fprintf(f, " }");
+        separator = ",";
+    }
+    fprintf(f, "\n  ],\n  \"memory\": [");
+    separator = "";
+    for (int address = 0; address < MEM_SIZE; address++) {
+        if (profile->read[address] != 0 || profile->write[address] != 0) {
+            fprintf(f, "%s\n    { \"address\": %d, \"reads\": %llu, \"writes\": %llu }",
+                    separator, address, (unsigned long long)profile->read[address],
+                    (unsigned long long)profile->write[address]);
+            separator = ",";
+        }
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return ferror(f) ? -1 : 0;
+}
+
+int cpu_profile_write_folded(const stCpu_profile *profile, const stCpu_state *cpu,
+                             const char *name, FILE *f) {
+    for (int pc = 0; pc < MEM_SIZE; pc++) {
+        if (profile->pc[pc] != 0) {
+            fprintf(f, "%s;%s;0x%02X %s %llu\n", name, (pc < ROM_SIZE) ? "ROM" : "RAM",
+                    pc, gOpcode_names[cpu->memory[pc] >> 4], (unsigned long long)profile->pc[pc]);
+        }
+    }
+    return ferror(f) ? -1 : 0;
+}
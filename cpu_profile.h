@@ -0,0 +1,70 @@
+#ifndef CPU_PROFILE_H
+#define CPU_PROFILE_H
+
+#include <stdio.h>
+#include "cpu_core.h"
+
+// Optional hot-spot profiler of the interpreters in cpu_core.c (run_cpu,
+// step_cpu) and cpu_threaded.c. Build with -DCPU_PROFILE to compile the
+// hooks in; without it they expand to nothing and the interpreters are
+// unchanged. A thread attaches a stCpu_profile and every step it runs
+// bumps flat counters: executions per PC and per opcode, taken and not
+// taken condition_jump per PC, and memory reads and writes per address.
+// Each instruction takes one cycle, so the PC counts are the cycle counts.
+
+typedef struct cpu_profile{
+    uint64_t pc[MEM_SIZE];          // executions per PC
+    uint64_t opcode[16];            // executions per opcode
+    uint64_t taken[MEM_SIZE];       // condition_jump per PC
+    uint64_t not_taken[MEM_SIZE];
+    uint64_t read[MEM_SIZE];        // mem_to_r0 per address
+    uint64_t write[MEM_SIZE];       // r0_to_ram per address
+} stCpu_profile;
+
+// Profile that the calling thread's interpreters count into (NULL = none)
+void cpu_profile_attach(stCpu_profile *profile);
+
+// Dump the non-zero counters as JSON; "cpu" gives the instruction bytes
+int cpu_profile_write_json(const stCpu_profile *profile, const stCpu_state *cpu, FILE *f);
+// Dump the PC counts as folded stacks ("name;ROM;0x04 set_value_r0 count")
+// for flamegraph.pl and similar tools
+int cpu_profile_write_folded(const stCpu_profile *profile, const stCpu_state *cpu,
+                             const char *name, FILE *f);
+
+#if defined(CPU_PROFILE)
+
+extern _Thread_local stCpu_profile *gCpu_profile;
+
+#define PROFILE_STEP(profile, at, instruction)              \
+    do {                                                    \
+        if ((profile) != NULL) {                            \
+            (profile)->pc[(uint8_t)(at)]++;                 \
+            (profile)->opcode[(instruction) >> 4]++;        \
+        }                                                   \
+    } while (0)
+#define PROFILE_BRANCH(profile, at, jumps)                  \
+    do {                                                    \
+        if ((profile) != NULL) {                            \
+            if (jumps) (profile)->taken[(uint8_t)(at)]++;   \
+            else (profile)->not_taken[(uint8_t)(at)]++;     \
+        }                                                   \
+    } while (0)
+#define PROFILE_READ(profile, address)                      \
+    do {                                                    \
+        if ((profile) != NULL) (profile)->read[(uint8_t)(address)]++;  \
+    } while (0)
+#define PROFILE_WRITE(profile, address)                     \
+    do {                                                    \
+        if ((profile) != NULL) (profile)->write[(uint8_t)(address)]++; \
+    } while (0)
+
+#else
+
+#define PROFILE_STEP(profile, at, instruction)  ((void)0)
+#define PROFILE_BRANCH(profile, at, jumps)      ((void)0)
+#define PROFILE_READ(profile, address)          ((void)0)
+#define PROFILE_WRITE(profile, address)         ((void)0)
+
+#endif
+
+#endif // CPU_PROFILE_H
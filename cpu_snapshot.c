@@ -0,0 +1,105 @@
+#include "cpu_snapshot.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the eight state bytes in front of stCpu_state.memory
+#define STATE_BYTES     (offsetof(stCpu_state, memory))
+
+_Static_assert(sizeof(stCpu_snapshot) == 64, "a snapshot is one cache line");
+_Static_assert(STATE_BYTES == sizeof(((stCpu_snapshot *)0)->reg), "register block layout");
+
+int snapshot_arena_init(stSnapshot_arena *arena, uint32_t capacity) {
+    memset(arena, 0, sizeof(*arena));
+    if (capacity == 0 || capacity == SNAPSHOT_NONE) {
+        return -1;
+    }
+    arena->snapshot = aligned_alloc(64, (size_t)capacity * sizeof(stCpu_snapshot));
+    arena->page = aligned_alloc(64, (size_t)capacity * sizeof(stSnapshot_page));
+    if (arena->snapshot == NULL || arena->page == NULL) {
+        snapshot_arena_free(arena);
+        return -1;
+    }
+    arena->capacity = capacity;
+    return 0;
+}
+
+void snapshot_arena_free(stSnapshot_arena *arena) {
+    free(arena->snapshot);
+    free(arena->page);
+    memset(arena, 0, sizeof(*arena));
+}
+
+void snapshot_arena_reset(stSnapshot_arena *arena) {
+    arena->snapshots = 0;
+    arena->pages = 0;
+}
+
+// copy the memory into a new page, return its index
+static uint32_t snapshot_new_page(stSnapshot_arena *arena, const stCpu_state *cpu) {
+    if (arena->pages == arena->capacity) {
+        return SNAPSHOT_NONE;
+    }
+    memcpy(arena->page[arena->pages].memory, cpu->memory, MEM_SIZE);
+    return arena->pages++;
+}
+
+uint32_t snapshot_take(stSnapshot_arena *arena, const stCpu_state *cpu) {
+    if (arena->snapshots == arena->capacity) {
+        return SNAPSHOT_NONE;
+    }
+    uint32_t page = snapshot_new_page(arena, cpu);
+    if (page == SNAPSHOT_NONE) {
+        return SNAPSHOT_NONE;
+    }
+    stCpu_snapshot *snapshot = &arena->snapshot[arena->snapshots];
+    snapshot->page = page;
+    snapshot->parent = SNAPSHOT_NONE;
+    memcpy(snapshot->reg, cpu, STATE_BYTES);
+    return arena->snapshots++;
+}
+
+uint32_t snapshot_fork(stSnapshot_arena *arena, uint32_t parent) {
+    if (parent >= arena->snapshots || arena->snapshots == arena->capacity) {
+        return SNAPSHOT_NONE;
+    }
+    stCpu_snapshot *snapshot = &arena->snapshot[arena->snapshots];
+    *snapshot = arena->snapshot[parent];
+    snapshot->parent = parent;
+    return arena->snapshots++;
+}
+
+int snapshot_update(stSnapshot_arena *arena, uint32_t index, const stCpu_state *cpu) {
+    stCpu_snapshot *snapshot = &arena->snapshot[index];
+    // pages may be shared: write a new one instead of the old one
+    if (memcmp(arena->page[snapshot->page].memory, cpu->memory, MEM_SIZE) != 0) {
+        uint32_t page = snapshot_new_page(arena, cpu);
+        if (page == SNAPSHOT_NONE) {
+            return -1;
+        }
+        snapshot->page = page;
+    }
+    memcpy(snapshot->reg, cpu, STATE_BYTES);
+    return 0;
+}
+
+void snapshot_restore(stCpu_state *cpu, const stSnapshot_arena *arena, uint32_t index) {
+    const stCpu_snapshot *snapshot = &arena->snapshot[index];
+    memcpy(cpu, snapshot->reg, STATE_BYTES);
+    memcpy(cpu->memory, arena->page[snapshot->page].memory, MEM_SIZE);
+}
+
+uint64_t run_cpu_to_input(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps) {
+    uint64_t steps = 0;
+    while (cpu->halt == HALT_NONE) {
+        if ((cpu->memory[cpu->PC] >> 4) == input_external) {
+            break;
+        }
+        if (max_steps != 0 && steps >= max_steps) {
+            cpu->halt = HALT_STEP_LIMIT;
+            break;
+        }
+        step_cpu(cpu, io);
+        steps++;
+    }
+    return steps;
+}
@@ -0,0 +1,58 @@
+#ifndef CPU_SNAPSHOT_H
+#define CPU_SNAPSHOT_H
+
+#include "cpu_core.h"
+
+// Snapshots of stCpu_state kept in a contiguous arena. A snapshot is one
+// 64-byte cache line holding the registers, status, instruction and halt
+// reason, plus the index of a 256-byte memory page (four cache lines).
+// Pages are never written after they are taken, so forks share the page of
+// their parent and a new page is only made when a saved continuation's
+// memory actually differs (copy on write).
+//
+// Typical use: run the common prefix up to the first input_external once
+// (run_cpu_to_input), take a snapshot, fork it for every continuation, and
+// restore a fork before running it with its own input.
+
+#define SNAPSHOT_NONE   (UINT32_MAX)
+
+typedef struct cpu_snapshot{
+    _Alignas(64) uint32_t page;         // index of the memory page
+    uint32_t parent;                    // snapshot forked from, or SNAPSHOT_NONE
+    uint8_t reg[8];                     // PC, r0..r3, status, instruction, halt
+    uint8_t reserved[48];
+} stCpu_snapshot;
+
+typedef struct snapshot_page{
+    _Alignas(64) uint8_t memory[MEM_SIZE];
+} stSnapshot_page;
+
+typedef struct snapshot_arena{
+    stCpu_snapshot *snapshot;
+    stSnapshot_page *page;
+    uint32_t snapshots;                 // in use
+    uint32_t pages;
+    uint32_t capacity;                  // of both tables
+} stSnapshot_arena;
+
+// Allocate room for "capacity" snapshots and pages, return 0 on success
+int snapshot_arena_init(stSnapshot_arena *arena, uint32_t capacity);
+void snapshot_arena_free(stSnapshot_arena *arena);
+// Drop every snapshot, keeping the memory
+void snapshot_arena_reset(stSnapshot_arena *arena);
+
+// Save cpu, return the snapshot index or SNAPSHOT_NONE when the arena is full
+uint32_t snapshot_take(stSnapshot_arena *arena, const stCpu_state *cpu);
+// New snapshot equal to "parent", sharing its memory page
+uint32_t snapshot_fork(stSnapshot_arena *arena, uint32_t parent);
+// Store cpu into an existing snapshot; the memory page is replaced only if
+// the memory differs. Return 0, or -1 when no page is left.
+int snapshot_update(stSnapshot_arena *arena, uint32_t index, const stCpu_state *cpu);
+// Load a snapshot into cpu
+void snapshot_restore(stCpu_state *cpu, const stSnapshot_arena *arena, uint32_t index);
+
+// Run like run_cpu but stop before executing an input_external (halt stays
+// HALT_NONE), so the state can be snapshot and forked per input value
+uint64_t run_cpu_to_input(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps);
+
+#endif // CPU_SNAPSHOT_H
@@ -0,0 +1,154 @@
+#include "cpu_stream.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int stream_init(stCpu_stream *stream, size_t ring_capacity, size_t out_cap, int out_fd) {
+    memset(stream, 0, sizeof(*stream));
+    stream->out_fd = out_fd;
+    if (ring_capacity != 0) {
+        size_t capacity = 1;
+        while (capacity < ring_capacity) {
+            capacity <<= 1;
+        }
+        stream->ring = malloc(capacity);
+        if (stream->ring == NULL) {
+            return -1;
+        }
+        stream->ring_mask = capacity - 1;
+    }
+    stream->out = malloc(out_cap != 0 ? out_cap : 1);
+    if (stream->out == NULL) {
+        stream_free(stream);
+        return -1;
+    }
+    stream->out_cap = out_cap;
+    return 0;
+}
+
+void stream_free(stCpu_stream *stream) {
+    if (stream->map != NULL && stream->map_len != 0) {
+        munmap((void *)stream->map, stream->map_len);
+    }
+    free(stream->ring);
+    free(stream->out);
+    memset(stream, 0, sizeof(*stream));
+    stream->out_fd = -1;
+}
+
+int stream_map_input(stCpu_stream *stream, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    void *map = NULL;
+    if (st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    if (stream->map != NULL && stream->map_len != 0) {
+        munmap((void *)stream->map, stream->map_len);
+    }
+    // an empty file maps to nothing but still replaces the ring
+    stream->map = (map != NULL) ? map : (const uint8_t *)"";
+    stream->map_len = (size_t)st.st_size;
+    stream->map_pos = 0;
+    return 0;
+}
+
+size_t stream_push(stCpu_stream *stream, const uint8_t *data, size_t len) {
+    size_t head = atomic_load_explicit(&stream->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&stream->tail, memory_order_acquire);
+    size_t room = (stream->ring != NULL) ? stream->ring_mask + 1 - (head - tail) : 0;
+    if (len > room) {
+        len = room;
+    }
+    for (size_t i = 0; i < len; i++) {
+        stream->ring[(head + i) & stream->ring_mask] = data[i];
+    }
+    atomic_store_explicit(&stream->head, head + len, memory_order_release);
+    return len;
+}
+
+size_t stream_input_left(const stCpu_stream *stream) {
+    if (stream->map != NULL) {
+        return stream->map_len - stream->map_pos;
+    }
+    return atomic_load_explicit(&stream->head, memory_order_acquire)
+           - atomic_load_explicit(&stream->tail, memory_order_relaxed);
+}
+
+int stream_flush(stCpu_stream *stream) {
+    size_t done = 0;
+    if (stream->out_fd < 0) {
+        return stream->error ? -1 : 0;
+    }
+    while (done < stream->out_len) {
+        ssize_t n = write(stream->out_fd, stream->out + done, stream->out_len - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            stream->error = true;
+            break;
+        }
+        done += (size_t)n;
+    }
+    stream->out_len = 0;
+    return stream->error ? -1 : 0;
+}
+
+static uint8_t cpu_stream_input_map(void *ctx) {
+    stCpu_stream *stream = (stCpu_stream *)ctx;
+    if (stream->map_pos >= stream->map_len) {
+        stream->underruns++;
+        return 0;
+    }
+    return stream->map[stream->map_pos++];
+}
+
+static uint8_t cpu_stream_input_ring(void *ctx) {
+    stCpu_stream *stream = (stCpu_stream *)ctx;
+    size_t tail = atomic_load_explicit(&stream->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&stream->head, memory_order_acquire)) {
+        stream->underruns++;
+        return 0;
+    }
+    uint8_t value = stream->ring[tail & stream->ring_mask];
+    atomic_store_explicit(&stream->tail, tail + 1, memory_order_release);
+    return value;
+}
+
+static void cpu_stream_output(void *ctx, uint8_t value) {
+    stCpu_stream *stream = (stCpu_stream *)ctx;
+    if (stream->out_len == stream->out_cap) {
+        // in memory only: the buffer is full, the byte is dropped
+        if (stream->out_fd < 0 || stream_flush(stream) != 0 || stream->out_cap == 0) {
+            stream->out_total++;
+            return;
+        }
+    }
+    stream->out[stream->out_len++] = value;
+    stream->out_total++;
+}
+
+void cpu_stream_io(stCpu_io *io, stCpu_stream *stream) {
+    io->ctx = stream;
+    io->input = (stream->map != NULL) ? cpu_stream_input_map : cpu_stream_input_ring;
+    io->output = cpu_stream_output;
+    io->message = NULL;
+}
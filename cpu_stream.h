@@ -0,0 +1,56 @@
+#ifndef CPU_STREAM_H
+#define CPU_STREAM_H
+
+#include <stdatomic.h>
+#include "cpu_core.h"
+
+// Streaming I/O backend for long batch runs. input_external reads the next
+// byte of a memory-mapped input file, or of a byte ring that another thread
+// (or the caller between runs) keeps filling. output_external appends the
+// raw byte to an output buffer that is written to a file descriptor in one
+// write() per "out_cap" bytes. There is no stdio and no per-value
+// formatting on the hot path.
+//
+// The ring is single producer / single consumer: stream_push may run on
+// another thread while the CPU runs.
+
+typedef struct cpu_stream{
+    // input: byte ring (capacity is a power of two) or mapped file
+    uint8_t *ring;
+    size_t ring_mask;
+    _Atomic size_t head;        // next byte stream_push writes
+    _Atomic size_t tail;        // next byte input_external reads
+    const uint8_t *map;
+    size_t map_len;
+    size_t map_pos;
+    uint64_t underruns;         // input_external with nothing to read (got 0)
+    // output
+    uint8_t *out;
+    size_t out_len;
+    size_t out_cap;
+    int out_fd;                 // flushed there when full, -1 = keep in memory
+    uint64_t out_total;         // bytes output, including flushed and dropped
+    bool error;                 // a write failed
+} stCpu_stream;
+
+// Allocate a ring of "ring_capacity" bytes (rounded up to a power of two,
+// 0 for none) and an output buffer of "out_cap" bytes flushed to "out_fd".
+// Return 0 on success.
+int stream_init(stCpu_stream *stream, size_t ring_capacity, size_t out_cap, int out_fd);
+// Unmap the input and free the buffers (does not flush)
+void stream_free(stCpu_stream *stream);
+
+// Take the input from the mapped file instead of the ring, return 0 on success
+int stream_map_input(stCpu_stream *stream, const char *path);
+// Append bytes to the ring, return how many fitted
+size_t stream_push(stCpu_stream *stream, const uint8_t *data, size_t len);
+// Input bytes not read yet
+size_t stream_input_left(const stCpu_stream *stream);
+
+// Write the buffered output to out_fd, return 0 on success
+int stream_flush(stCpu_stream *stream);
+
+// Set up "io" on the stream; messages are dropped
+void cpu_stream_io(stCpu_io *io, stCpu_stream *stream);
+
+#endif // CPU_STREAM_H
@@ -0,0 +1,50 @@
+#include "cpu_core.hpp"
+
+// C entry points of the templated core (cpu_core.hpp) for the Original8,
+// Masked8 and Lazy8 configurations, so the C host can run and compare them like
+// any other engine. The other configurations are instantiated here to keep
+// them compiling.
+
+namespace cpu {
+
+template struct State<Trusted8>;
+template struct State<Wide16>;
+
+struct NullIo {
+    std::uint16_t input() { return 0; }
+    void output(std::uint16_t) {}
+    void message(const char *) {}
+};
+
+template std::uint64_t run<Trusted8, CIo>(State<Trusted8> &, CIo &, std::uint64_t);
+template std::uint64_t run<Wide16, NullIo>(State<Wide16> &, NullIo &, std::uint64_t);
+
+} // namespace cpu
+
+// State of the 8-bit configurations has the layout of stCpu_state
+static_assert(sizeof(cpu::State<cpu::Original8>) == sizeof(stCpu_state), "state layout");
+static_assert(offsetof(cpu::State<cpu::Original8>, memory) == offsetof(stCpu_state, memory),
+              "state layout");
+
+template <class C>
+static uint64_t run_state(stCpu_state *state, const stCpu_io *io, uint64_t max_steps) {
+    cpu::State<C> cpu;
+    cpu::CIo backend{ io };
+
+    std::memcpy(&cpu, state, sizeof(cpu));
+    std::uint64_t steps = cpu::run(cpu, backend, max_steps);
+    std::memcpy(state, &cpu, sizeof(cpu));
+    return steps;
+}
+
+extern "C" uint64_t run_cpu_template(stCpu_state *state, const stCpu_io *io, uint64_t max_steps) {
+    return run_state<cpu::Original8>(state, io, max_steps);
+}
+
+extern "C" uint64_t run_cpu_masked(stCpu_state *state, const stCpu_io *io, uint64_t max_steps) {
+    return run_state<cpu::Masked8>(state, io, max_steps);
+}
+
+extern "C" uint64_t run_cpu_lazy(stCpu_state *state, const stCpu_io *io, uint64_t max_steps) {
+    return run_state<cpu::Lazy8>(state, io, max_steps);
+}
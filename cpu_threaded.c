@@ -0,0 +1,168 @@
+#include "cpu_core.h"
+#include "cpu_profile.h"
+
+// Threaded-code interpreter: same semantics as run_cpu(), but every opcode
+// handler is inlined in one function and jumps straight to the handler of
+// the next instruction (computed goto), instead of going through the
+// fetch/decode/execute calls and the switch. Registers, PC and status are
+// kept in locals and written back when the CPU stops.
+
+#if defined(__GNUC__)
+
+#define ZERO_BIT(value)    (((value) == 0) ? STATUS_ZERO : 0)
+
+uint64_t run_cpu_threaded(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps) {
+    static void *const dispatch_table[16] = {
+        &&op_mem_to_r0,  &&op_mem_to_r0,  &&op_r0_to_ram,  &&op_r0_to_ram,
+        &&op_rx_to_ry,   &&op_set_r0,     &&op_add,        &&op_sub,
+        &&op_shift_left, &&op_shift_right, &&op_compare,   &&op_compare,
+        &&op_output,     &&op_input,      &&op_cond_jump,  &&op_uncond_jump,
+    };
+    uint8_t *memory = cpu->memory;
+    uint8_t reg[4] = { cpu->r0, cpu->r1, cpu->r2, cpu->r3 };
+    uint8_t PC = cpu->PC;
+    uint8_t status = cpu->status;
+    uint8_t instruction = cpu->instruction;
+    uint8_t halt = cpu->halt;
+    uint64_t steps = 0;
+    uint64_t limit = (max_steps != 0) ? max_steps : UINT64_MAX;
+#if defined(CPU_PROFILE)
+    stCpu_profile *profile = gCpu_profile;
+#endif
+
+    if (halt != HALT_NONE) {
+        return 0;
+    }
+
+// fetch the next instruction and jump to its handler
+#define DISPATCH()                                          \
+    do {                                                    \
+        if (steps == limit) {                               \
+            halt = HALT_STEP_LIMIT;                         \
+            goto done;                                      \
+        }                                                   \
+        instruction = memory[PC];                           \
+        PROFILE_STEP(profile, PC, instruction);             \
+        PC += 1;                                            \
+        steps++;                                            \
+        goto *dispatch_table[instruction >> 4];             \
+    } while (0)
+
+#define REG_H   reg[(instruction >> 2) & 0x03]
+#define REG_L   reg[instruction & 0x03]
+#define SET_ZF(value)   (status = (status & ~STATUS_ZERO) | ZERO_BIT(value))
+
+    DISPATCH();
+
+op_mem_to_r0: {
+        uint8_t address = REG_L;
+        if ((instruction & 0x04) == 0) {
+            if (address >= ROM_SIZE) {
+                if (io->message != NULL) io->message(io->ctx, "ROM access out of bounds.\n");
+                halt = HALT_ROM_READ;
+                goto done;
+            }
+        }
+        else if (address < ROM_SIZE) {
+            if (io->message != NULL) io->message(io->ctx, "RAM access out of bounds.\n");
+            halt = HALT_RAM_READ;
+            goto done;
+        }
+        PROFILE_READ(profile, address);
+        reg[0] = memory[address];
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_r0_to_ram: {
+        PROFILE_WRITE(profile, REG_L % 128 + 0x80);
+        memory[REG_L % 128 + 0x80] = reg[0];
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_rx_to_ry: {
+        uint8_t value = REG_H;
+        REG_L = value;
+        SET_ZF(value);
+        DISPATCH();
+    }
+op_set_r0: {
+        reg[0] = instruction & 0x0F;
+        SET_ZF(reg[0]);
+        DISPATCH();
+    }
+op_add: {
+        int16_t result = REG_H + REG_L;
+        REG_H = (uint8_t)result;
+        if (result > 0xFF) {
+            status |= STATUS_OF;
+            if (io->message != NULL) io->message(io->ctx, "\nOverflow occurs in addition operation!\n");
+        }
+        else {
+            SET_ZF((uint8_t)result);
+            status &= ~STATUS_OF;
+        }
+        DISPATCH();
+    }
+op_sub: {
+        int16_t result = REG_H - REG_L;
+        REG_H = (uint8_t)result;
+        if (result < 0) {
+            status |= STATUS_OF;
+            if (io->message != NULL) io->message(io->ctx, "\nOverflow occurs in subtraction operation!\n");
+        }
+        else {
+            SET_ZF((uint8_t)result);
+            status &= ~STATUS_OF;
+        }
+        DISPATCH();
+    }
+op_shift_left:
+    REG_H = (uint8_t)(REG_H << 4);
+    DISPATCH();
+op_shift_right:
+    REG_H = REG_H >> 4;
+    DISPATCH();
+op_compare:
+    SET_ZF(REG_H);
+    DISPATCH();
+op_output:
+    io->output(io->ctx, REG_H);
+    halt = HALT_OUTPUT;
+    goto done;
+op_input:
+    REG_H = io->input(io->ctx);
+    DISPATCH();
+op_cond_jump:
+    PROFILE_BRANCH(profile, PC - 1, status & STATUS_ZERO);
+    if (status & STATUS_ZERO) {
+        PC = REG_H;
+    }
+    DISPATCH();
+op_uncond_jump:
+    PC = REG_H;
+    DISPATCH();
+
+done:
+#undef DISPATCH
+#undef REG_H
+#undef REG_L
+#undef SET_ZF
+    cpu->PC = PC;
+    cpu->r0 = reg[0];
+    cpu->r1 = reg[1];
+    cpu->r2 = reg[2];
+    cpu->r3 = reg[3];
+    cpu->status = status;
+    cpu->instruction = instruction;
+    cpu->halt = halt;
+    return steps;
+}
+
+#else
+
+// no computed goto on this compiler: fall back to the switch interpreter
+uint64_t run_cpu_threaded(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps) {
+    return run_cpu(cpu, io, max_steps);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include "cpu_timing.h"
+#include <string.h>
+
+void timing_init(stCpu_timing *timing, int mode, uint32_t hz) {
+    memset(timing, 0, sizeof(*timing));
+    timing->mode = mode;
+    timing->hz = hz;
+    for (int opcode = 0; opcode < 16; opcode++) {
+        timing->cycles[opcode] = 1;
+    }
+    timing->cycles[mem_to_r0_1] = 2;
+    timing->cycles[mem_to_r0_2] = 2;
+    timing->cycles[r0_to_ram_1] = 2;
+    timing->cycles[r0_to_ram_2] = 2;
+    timing->cycles[condition_jump] = 2;
+    timing->cycles[uncondition_jump] = 2;
+}
+
+void timing_pace(stCpu_timing *timing, uint32_t quantum,
+                 uint64_t (*now_us)(void), void (*sleep_us)(uint64_t us)) {
+    if (quantum == 0) {
+        quantum = timing->hz / 100;
+    }
+    timing->quantum = quantum != 0 ? quantum : 1;
+    timing->now_us = now_us;
+    timing->sleep_us = sleep_us;
+}
+
+// cycles to microseconds without overflowing for long runs
+static uint64_t timing_cycles_us(const stCpu_timing *timing, uint64_t cycles) {
+    return cycles / timing->hz * 1000000 + cycles % timing->hz * 1000000 / timing->hz;
+}
+
+uint64_t timing_virtual_us(const stCpu_timing *timing) {
+    if (timing->hz == 0) {
+        return 0;
+    }
+    return timing_cycles_us(timing, timing->cycle);
+}
+
+// Sleep until the real time catches up with the virtual time
+static void timing_sync(stCpu_timing *timing) {
+    uint64_t target = timing->epoch_us + timing_cycles_us(timing, timing->cycle - timing->epoch_cycle);
+    uint64_t now = timing->now_us();
+    if (now < target) {
+        timing->sleep_us(target - now);
+        timing->sleeps++;
+    }
+    else if (now - target > timing_cycles_us(timing, timing->quantum)) {
+        // more than a quantum late: restart the pacing from now
+        timing->epoch_us = now;
+        timing->epoch_cycle = timing->cycle;
+        timing->resyncs++;
+    }
+}
+
+uint64_t run_cpu_timed(stCpu_state *cpu, const stCpu_io *io, stCpu_timing *timing,
+                       uint64_t max_steps) {
+    if (timing->mode == TIMING_FAST || timing->hz == 0) {
+        uint64_t steps = run_cpu(cpu, io, max_steps);
+        timing->cycle += steps;
+        return steps;
+    }
+
+    // the next synchronization, never without pacing
+    uint64_t sync = UINT64_MAX;
+    if (timing->now_us != NULL) {
+        timing->epoch_us = timing->now_us();
+        timing->epoch_cycle = timing->cycle;
+        sync = timing->cycle + timing->quantum;
+    }
+
+    uint64_t steps = 0;
+    while (cpu->halt == HALT_NONE) {
+        if (max_steps != 0 && steps >= max_steps) {
+            cpu->halt = HALT_STEP_LIMIT;
+            break;
+        }
+        fetch_instruction(cpu);
+        execute_instruction(cpu, decode_instruction(cpu), io);
+        timing->cycle += timing->cycles[cpu->instruction >> 4];
+        steps++;
+        if (timing->cycle >= sync) {
+            timing_sync(timing);
+            sync = timing->cycle + timing->quantum;
+        }
+    }
+    // the last partial quantum, so the run never ends ahead of real time
+    if (timing->now_us != NULL) {
+        timing_sync(timing);
+    }
+    return steps;
+}
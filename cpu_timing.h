@@ -0,0 +1,54 @@
+#ifndef CPU_TIMING_H
+#define CPU_TIMING_H
+
+#include "cpu_core.h"
+
+// Execution timing of the emulator, replacing the sleep_ms(100) after every
+// instruction of the original main loop.
+//
+// TIMING_FAST runs as fast as the interpreter goes and counts one cycle per
+// instruction. TIMING_CYCLES advances a virtual clock by the cycle count of
+// every executed opcode (cycles[], configurable), so the simulated time is
+// cycle / hz whatever the host speed.
+//
+// Real-time pacing is optional and only applies to TIMING_CYCLES: every
+// "quantum" cycles the runner compares the virtual time with the real time
+// and sleeps once for the difference. A run that falls behind (slow host,
+// blocking input) is not replayed in a burst, the pacing restarts from now.
+// The platform provides the time source and the sleep, so this file does
+// not depend on the Pico SDK.
+
+#define TIMING_FAST     (0)     // as fast as possible
+#define TIMING_CYCLES   (1)     // cycle-counted virtual clock
+
+typedef struct cpu_timing{
+    int mode;
+    uint32_t hz;                        // virtual clock frequency
+    uint8_t cycles[16];                 // cycles of each opcode
+    uint64_t cycle;                     // virtual time, in cycles
+    // real-time pacing (timing_pace), off while now_us is NULL
+    uint32_t quantum;                   // cycles between two synchronizations
+    uint64_t (*now_us)(void);
+    void (*sleep_us)(uint64_t us);
+    uint64_t epoch_us;                  // real time of epoch_cycle
+    uint64_t epoch_cycle;
+    uint64_t sleeps;
+    uint64_t resyncs;                   // times the pacing fell behind
+} stCpu_timing;
+
+// Set the mode and the virtual clock (hz must not be 0 for TIMING_CYCLES),
+// with the default cycle table: 2 cycles for the memory accesses and the
+// jumps, 1 for the rest. The virtual time starts at 0.
+void timing_init(stCpu_timing *timing, int mode, uint32_t hz);
+// Pace the virtual clock to real time, sleeping once per "quantum" cycles
+// (0 = hz / 100, i.e. every 10 ms of virtual time)
+void timing_pace(stCpu_timing *timing, uint32_t quantum,
+                 uint64_t (*now_us)(void), void (*sleep_us)(uint64_t us));
+// Virtual time in microseconds
+uint64_t timing_virtual_us(const stCpu_timing *timing);
+
+// Same as run_cpu, advancing the virtual clock (and pacing it)
+uint64_t run_cpu_timed(stCpu_state *cpu, const stCpu_io *io, stCpu_timing *timing,
+                       uint64_t max_steps);
+
+#endif // CPU_TIMING_H
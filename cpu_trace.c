@@ -0,0 +1,565 @@
+#include "cpu_trace.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// register written by each opcode: 0 none, 1 r0, 2 reg_H, 3 reg_L
+static const uint8_t gWrites[16] = {
+    1, 1, 0, 0,     // mem_to_r0, r0_to_ram
+    3, 1, 2, 2,     // rx_to_ry, set_value_r0, add, sub
+    2, 2, 0, 0,     // shifts, compare
+    0, 2, 0, 0,     // output, input, jumps
+};
+
+static const char gMagic[8] = { 'C', 'P', 'U', 'T', 'R', 'A', 'C', 'E' };
+
+// Tag of the step that ran "instruction" at "pc" and left "cpu"
+static inline uint8_t trace_tag(uint8_t pc, uint8_t instruction, const stCpu_state *cpu) {
+    uint8_t tag = 0;
+    switch (gWrites[instruction >> 4]) {
+    case 1: tag = TRACE_REG_WRITE | REG_0; break;
+    case 2: tag = TRACE_REG_WRITE | ((instruction >> 2) & 0x03); break;
+    case 3: tag = TRACE_REG_WRITE | (instruction & 0x03); break;
+    default: break;
+    }
+    if (cpu->status & STATUS_ZERO) {
+        tag |= TRACE_ZF;
+    }
+    if (cpu->status & STATUS_OF) {
+        tag |= TRACE_OF;
+    }
+    if (cpu->PC != (uint8_t)(pc + 1)) {
+        tag |= TRACE_JUMP;
+    }
+    if (cpu->halt != HALT_NONE) {
+        tag |= TRACE_HALT;
+    }
+    return tag;
+}
+
+void trace_init(stCpu_trace *trace) {
+    memset(trace, 0, sizeof(*trace));
+}
+
+void trace_free(stCpu_trace *trace) {
+    free(trace->data);
+    free(trace->checkpoint);
+    memset(trace, 0, sizeof(*trace));
+}
+
+void trace_reset(stCpu_trace *trace) {
+    trace->length = 0;
+    trace->checkpoints = 0;
+    trace->steps = 0;
+    trace->overflow = false;
+}
+
+// make room for "bytes" more stream bytes
+static bool trace_reserve(stCpu_trace *trace, uint64_t bytes) {
+    if (trace->length + bytes <= trace->capacity) {
+        return true;
+    }
+    uint64_t capacity = (trace->capacity != 0) ? trace->capacity * 2 : 65536;
+    while (capacity < trace->length + bytes) {
+        capacity *= 2;
+    }
+    uint8_t *data = realloc(trace->data, capacity);
+    if (data == NULL) {
+        trace->overflow = true;
+        return false;
+    }
+    trace->data = data;
+    trace->capacity = capacity;
+    return true;
+}
+
+static bool trace_checkpoint(stCpu_trace *trace, const stCpu_state *cpu) {
+    if (trace->checkpoints == trace->checkpoint_capacity) {
+        uint64_t capacity = (trace->checkpoint_capacity != 0) ? trace->checkpoint_capacity * 2 : 64;
+        stTrace_checkpoint *checkpoint = realloc(trace->checkpoint, capacity * sizeof(*checkpoint));
+        if (checkpoint == NULL) {
+            trace->overflow = true;
+            return false;
+        }
+        trace->checkpoint = checkpoint;
+        trace->checkpoint_capacity = capacity;
+    }
+    stTrace_checkpoint *checkpoint = &trace->checkpoint[trace->checkpoints++];
+    checkpoint->step = trace->steps;
+    checkpoint->offset = trace->length;
+    checkpoint->cpu = *cpu;
+    return true;
+}
+
+// write cpu's register block back into cpu before a checkpoint
+#define TRACE_SYNC()                                        \
+    do {                                                    \
+        cpu->PC = PC;                                       \
+        cpu->r0 = reg[0];                                   \
+        cpu->r1 = reg[1];                                   \
+        cpu->r2 = reg[2];                                   \
+        cpu->r3 = reg[3];                                   \
+        cpu->status = status;                               \
+        cpu->instruction = instruction;                     \
+        cpu->halt = halt;                                   \
+    } while (0)
+
+#if defined(__GNUC__)
+
+#define ZERO_BIT(value)    (((value) == 0) ? STATUS_ZERO : 0)
+
+// GCC merges the identical dispatch tails of the handlers, which leaves one
+// shared indirect jump that predicts badly; keep one per handler
+#if !defined(__clang__)
+#define TRACE_DISPATCH_TAILS    __attribute__((optimize("no-crossjumping")))
+#else
+#define TRACE_DISPATCH_TAILS
+#endif
+
+// Threaded interpreter (see cpu_threaded.c) that appends the tag of every
+// step. The stream is reserved one chunk at a time, chunks end at the
+// checkpoints, so the handlers write without bounds checks.
+TRACE_DISPATCH_TAILS
+uint64_t run_cpu_recorded(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps,
+                          stCpu_trace *trace) {
+    static void *const dispatch_table[16] = {
+        &&op_mem_to_r0,  &&op_mem_to_r0,  &&op_r0_to_ram,  &&op_r0_to_ram,
+        &&op_rx_to_ry,   &&op_set_r0,     &&op_add,        &&op_sub,
+        &&op_shift_left, &&op_shift_right, &&op_compare,   &&op_compare,
+        &&op_output,     &&op_input,      &&op_cond_jump,  &&op_uncond_jump,
+    };
+    uint8_t *memory = cpu->memory;
+    uint8_t reg[4] = { cpu->r0, cpu->r1, cpu->r2, cpu->r3 };
+    uint8_t PC = cpu->PC;
+    uint8_t at = PC;                // address of the current instruction
+    uint8_t status = cpu->status;
+    uint8_t instruction = cpu->instruction;
+    uint8_t halt = cpu->halt;
+    uint64_t steps = 0;
+    uint64_t stop = 0;              // end of the reserved chunk
+    uint64_t limit = (max_steps != 0) ? max_steps : UINT64_MAX;
+    uint64_t first = trace->steps;  // trace steps before this call
+    uint8_t *out = NULL;
+
+    if (halt != HALT_NONE) {
+        return 0;
+    }
+    if (trace->checkpoints == 0 && !trace_checkpoint(trace, cpu)) {
+        return 0;
+    }
+
+#define DISPATCH()                                          \
+    do {                                                    \
+        if (steps == stop) {                                \
+            goto refill;                                    \
+        }                                                   \
+        at = PC;                                            \
+        instruction = memory[PC];                           \
+        PC += 1;                                            \
+        steps++;                                            \
+        goto *dispatch_table[instruction >> 4];             \
+    } while (0)
+
+// tag of the step that just ran, "bits" are the register written; only
+// the jumps can leave PC anywhere else than at + 1
+#define RECORD(bits)    (*out++ = (bits) | ((status & 0x03) << 3))
+#define RECORD_JUMP()                                       \
+    do {                                                    \
+        uint8_t jumped = (PC != (uint8_t)(at + 1));         \
+        out[0] = (status & 0x03) << 3 | (jumped ? TRACE_JUMP : 0); \
+        out[1] = PC;                                        \
+        out += 1 + jumped;                                  \
+    } while (0)
+
+#define NEXT(bits)      do { RECORD(bits); DISPATCH(); } while (0)
+#define H_BITS          (TRACE_REG_WRITE | ((instruction >> 2) & 0x03))
+#define L_BITS          (TRACE_REG_WRITE | (instruction & 0x03))
+#define R0_BITS         (TRACE_REG_WRITE | REG_0)
+#define REG_H   reg[(instruction >> 2) & 0x03]
+#define REG_L   reg[instruction & 0x03]
+#define SET_ZF(value)   (status = (status & ~STATUS_ZERO) | ZERO_BIT(value))
+
+    DISPATCH();
+
+refill:
+    if (out != NULL) {
+        trace->length = (uint64_t)(out - trace->data);
+        trace->steps = first + steps;
+    }
+    if (steps == limit) {
+        halt = HALT_STEP_LIMIT;
+        goto done;
+    }
+    // a call that resumes on a boundary still owes its checkpoint: the
+    // previous one stopped there at its step limit
+    if (trace->steps % TRACE_CHECKPOINT == 0
+        && trace->checkpoint[trace->checkpoints - 1].step != trace->steps) {
+        TRACE_SYNC();
+        if (!trace_checkpoint(trace, cpu)) {
+            goto done;
+        }
+    }
+    {
+        uint64_t chunk = TRACE_CHECKPOINT - trace->steps % TRACE_CHECKPOINT;
+        if (chunk > limit - steps) {
+            chunk = limit - steps;
+        }
+        // tag, input, PC and halt bytes at most
+        if (!trace_reserve(trace, chunk * 4)) {
+            goto done;
+        }
+        out = &trace->data[trace->length];
+        stop = steps + chunk;
+    }
+    DISPATCH();
+
+op_mem_to_r0: {
+        uint8_t address = REG_L;
+        if ((instruction & 0x04) == 0) {
+            if (address >= ROM_SIZE) {
+                if (io->message != NULL) io->message(io->ctx, "ROM access out of bounds.\n");
+                halt = HALT_ROM_READ;
+                goto halted;
+            }
+        }
+        else if (address < ROM_SIZE) {
+            if (io->message != NULL) io->message(io->ctx, "RAM access out of bounds.\n");
+            halt = HALT_RAM_READ;
+            goto halted;
+        }
+        reg[0] = memory[address];
+        SET_ZF(reg[0]);
+        NEXT(R0_BITS);
+    }
+op_r0_to_ram: {
+        memory[REG_L % 128 + 0x80] = reg[0];
+        SET_ZF(reg[0]);
+        NEXT(0);
+    }
+op_rx_to_ry: {
+        uint8_t value = REG_H;
+        REG_L = value;
+        SET_ZF(value);
+        NEXT(L_BITS);
+    }
+op_set_r0: {
+        reg[0] = instruction & 0x0F;
+        SET_ZF(reg[0]);
+        NEXT(R0_BITS);
+    }
+op_add: {
+        int16_t result = REG_H + REG_L;
+        REG_H = (uint8_t)result;
+        if (result > 0xFF) {
+            status |= STATUS_OF;
+            if (io->message != NULL) io->message(io->ctx, "\nOverflow occurs in addition operation!\n");
+        }
+        else {
+            SET_ZF((uint8_t)result);
+            status &= ~STATUS_OF;
+        }
+        NEXT(H_BITS);
+    }
+op_sub: {
+        int16_t result = REG_H - REG_L;
+        REG_H = (uint8_t)result;
+        if (result < 0) {
+            status |= STATUS_OF;
+            if (io->message != NULL) io->message(io->ctx, "\nOverflow occurs in subtraction operation!\n");
+        }
+        else {
+            SET_ZF((uint8_t)result);
+            status &= ~STATUS_OF;
+        }
+        NEXT(H_BITS);
+    }
+op_shift_left:
+    REG_H = (uint8_t)(REG_H << 4);
+    NEXT(H_BITS);
+op_shift_right:
+    REG_H = REG_H >> 4;
+    NEXT(H_BITS);
+op_compare:
+    SET_ZF(REG_H);
+    NEXT(0);
+op_output:
+    io->output(io->ctx, REG_H);
+    halt = HALT_OUTPUT;
+    goto halted;
+op_input:
+    REG_H = io->input(io->ctx);
+    // input never jumps: tag and input byte
+    out[0] = H_BITS | TRACE_INPUT | ((status & 0x03) << 3);
+    out[1] = REG_H;
+    out += 2;
+    DISPATCH();
+op_cond_jump:
+    if (status & STATUS_ZERO) {
+        PC = REG_H;
+    }
+    RECORD_JUMP();
+    DISPATCH();
+op_uncond_jump:
+    PC = REG_H;
+    RECORD_JUMP();
+    DISPATCH();
+
+halted:
+    // the step that stopped the CPU, with its halt byte
+    TRACE_SYNC();
+    *out = trace_tag(at, instruction, cpu);
+    if (*out++ & TRACE_JUMP) {
+        *out++ = PC;
+    }
+    *out++ = halt;
+    trace->length = (uint64_t)(out - trace->data);
+    trace->steps = first + steps;
+
+done:
+#undef DISPATCH
+#undef RECORD
+#undef RECORD_JUMP
+#undef NEXT
+#undef H_BITS
+#undef L_BITS
+#undef R0_BITS
+#undef REG_H
+#undef REG_L
+#undef SET_ZF
+    TRACE_SYNC();
+    return steps;
+}
+
+#else
+
+// input backend of the recorder: forward to the real one and keep the value
+typedef struct trace_input{
+    const stCpu_io *io;
+    bool taken;
+    uint8_t value;
+} stTrace_input;
+
+static uint8_t trace_input(void *ctx) {
+    stTrace_input *input = (stTrace_input *)ctx;
+    input->value = input->io->input(input->io->ctx);
+    input->taken = true;
+    return input->value;
+}
+
+// the other callbacks get the context of the real backend back
+static void trace_output(void *ctx, uint8_t value) {
+    const stCpu_io *io = ((stTrace_input *)ctx)->io;
+    io->output(io->ctx, value);
+}
+
+static void trace_message(void *ctx, const char *text) {
+    const stCpu_io *io = ((stTrace_input *)ctx)->io;
+    if (io->message != NULL) {
+        io->message(io->ctx, text);
+    }
+}
+
+// no computed goto on this compiler: record around the switch interpreter
+uint64_t run_cpu_recorded(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps,
+                          stCpu_trace *trace) {
+    stTrace_input input = { io, false, 0 };
+    stCpu_io recorder = { &input, trace_input, trace_output, trace_message };
+    uint64_t steps = 0;
+
+    if (trace->checkpoints == 0 && !trace_checkpoint(trace, cpu)) {
+        return 0;
+    }
+    while (cpu->halt == HALT_NONE) {
+        if (max_steps != 0 && steps >= max_steps) {
+            cpu->halt = HALT_STEP_LIMIT;
+            break;
+        }
+        if (!trace_reserve(trace, 4)) {
+            break;
+        }
+        uint8_t pc = cpu->PC;
+        fetch_instruction(cpu);
+        execute_instruction(cpu, decode_instruction(cpu), &recorder);
+        steps++;
+
+        uint8_t *out = &trace->data[trace->length];
+        uint8_t *tag = out++;
+        *tag = trace_tag(pc, cpu->instruction, cpu);
+        if (input.taken) {
+            *tag |= TRACE_INPUT;
+            *out++ = input.value;
+            input.taken = false;
+        }
+        if (*tag & TRACE_JUMP) {
+            *out++ = cpu->PC;
+        }
+        if (*tag & TRACE_HALT) {
+            *out++ = cpu->halt;
+        }
+        trace->length = (uint64_t)(out - trace->data);
+        trace->steps++;
+        if (trace->steps % TRACE_CHECKPOINT == 0 && !trace_checkpoint(trace, cpu)) {
+            break;
+        }
+    }
+    return steps;
+}
+
+#endif
+
+int trace_write(const stCpu_trace *trace, FILE *f) {
+    // header: magic, steps, stream length, checkpoint count (host byte order)
+    uint64_t header[3] = { trace->steps, trace->length, trace->checkpoints };
+    if (fwrite(gMagic, 1, sizeof(gMagic), f) != sizeof(gMagic)
+        || fwrite(header, sizeof(header), 1, f) != 1
+        || fwrite(trace->checkpoint, sizeof(stTrace_checkpoint), trace->checkpoints, f) != trace->checkpoints
+        || fwrite(trace->data, 1, trace->length, f) != trace->length) {
+        return -1;
+    }
+    return 0;
+}
+
+int trace_read(stCpu_trace *trace, FILE *f) {
+    char magic[sizeof(gMagic)];
+    uint64_t header[3];
+
+    trace_init(trace);
+    if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) || memcmp(magic, gMagic, sizeof(gMagic)) != 0
+        || fread(header, sizeof(header), 1, f) != 1) {
+        return -1;
+    }
+    // the lengths come from the file: bound them before they size anything
+    if (header[1] > SIZE_MAX || header[2] > SIZE_MAX / sizeof(stTrace_checkpoint)) {
+        return -1;
+    }
+    struct stat st;
+    long at = ftell(f);
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && at >= 0) {
+        uint64_t left = (uint64_t)st.st_size > (uint64_t)at ? (uint64_t)st.st_size - (uint64_t)at : 0;
+        if (header[2] > left / sizeof(stTrace_checkpoint)
+            || header[1] > left - header[2] * sizeof(stTrace_checkpoint)) {
+            return -1;
+        }
+    }
+    trace->steps = header[0];
+    trace->length = trace->capacity = header[1];
+    trace->checkpoints = trace->checkpoint_capacity = header[2];
+    trace->data = malloc(trace->length != 0 ? trace->length : 1);
+    trace->checkpoint = malloc(trace->checkpoints != 0 ? trace->checkpoints * sizeof(stTrace_checkpoint) : 1);
+    if (trace->data == NULL || trace->checkpoint == NULL
+        || fread(trace->checkpoint, sizeof(stTrace_checkpoint), trace->checkpoints, f) != trace->checkpoints
+        || fread(trace->data, 1, trace->length, f) != trace->length) {
+        trace_free(trace);
+        return -1;
+    }
+    for (size_t i = 0; i < trace->checkpoints; i++) {
+        if (trace->checkpoint[i].offset > trace->length) {
+            trace_free(trace);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int trace_seek(stTrace_replay *replay, const stCpu_trace *trace, uint64_t step) {
+    if (step > trace->steps || trace->checkpoints == 0) {
+        return -1;
+    }
+    // last checkpoint at or before "step", by the step it was taken at
+    uint64_t low = 0, high = trace->checkpoints;
+    while (high - low > 1) {
+        uint64_t middle = low + (high - low) / 2;
+        if (trace->checkpoint[middle].step <= step) {
+            low = middle;
+        }
+        else {
+            high = middle;
+        }
+    }
+    uint64_t index = low;
+    replay->trace = trace;
+    replay->cpu = trace->checkpoint[index].cpu;
+    replay->step = trace->checkpoint[index].step;
+    replay->offset = trace->checkpoint[index].offset;
+
+    stCpu_io quiet = { NULL, NULL, NULL, NULL };
+    while (replay->step < step) {
+        if (trace_replay_step(replay, &quiet) != 1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// backend of the replayer: inputs come from the trace, the rest goes to
+// the caller's backend
+typedef struct trace_player{
+    const stCpu_io *io;
+    bool taken;
+    uint8_t value;
+} stTrace_player;
+
+static uint8_t replay_input(void *ctx) {
+    stTrace_player *player = (stTrace_player *)ctx;
+    player->taken = true;
+    return player->value;
+}
+
+static void replay_output(void *ctx, uint8_t value) {
+    const stCpu_io *io = ((stTrace_player *)ctx)->io;
+    if (io->output != NULL) {
+        io->output(io->ctx, value);
+    }
+}
+
+static void replay_message(void *ctx, const char *text) {
+    const stCpu_io *io = ((stTrace_player *)ctx)->io;
+    if (io->message != NULL) {
+        io->message(io->ctx, text);
+    }
+}
+
+int trace_replay_step(stTrace_replay *replay, const stCpu_io *io) {
+    const stCpu_trace *trace = replay->trace;
+    const uint8_t *in = &trace->data[replay->offset];
+    const uint8_t *end = &trace->data[trace->length];
+
+    if (replay->step >= trace->steps || in >= end) {
+        return 0;
+    }
+    uint8_t tag = *in++;
+    // input, jump and halt each carry one more byte; a cut trace is a mismatch
+    ptrdiff_t extra = !!(tag & TRACE_INPUT) + !!(tag & TRACE_JUMP) + !!(tag & TRACE_HALT);
+    if (end - in < extra) {
+        return -1;
+    }
+    stTrace_player player = { io, false, 0 };
+    if (tag & TRACE_INPUT) {
+        player.value = *in++;
+    }
+    stCpu_io player_io = { &player, replay_input, replay_output, replay_message };
+    stCpu_state *cpu = &replay->cpu;
+    uint8_t pc = cpu->PC;
+
+    fetch_instruction(cpu);
+    execute_instruction(cpu, decode_instruction(cpu), &player_io);
+
+    uint8_t expect = trace_tag(pc, cpu->instruction, cpu);
+    if (player.taken) {
+        expect |= TRACE_INPUT;
+    }
+    if (expect != tag) {
+        return -1;
+    }
+    if ((tag & TRACE_JUMP) && *in++ != cpu->PC) {
+        return -1;
+    }
+    if ((tag & TRACE_HALT) && *in++ != cpu->halt) {
+        return -1;
+    }
+    replay->offset = (uint64_t)(in - trace->data);
+    replay->step++;
+    return 1;
+}
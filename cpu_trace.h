@@ -0,0 +1,80 @@
+#ifndef CPU_TRACE_H
+#define CPU_TRACE_H
+
+#include <stdio.h>
+#include "cpu_core.h"
+
+// Deterministic record/replay. The recorder writes one tag byte per step:
+//
+//   bits 1:0  register written by the instruction
+//   bit 2     a register was written
+//   bit 3     ZF after the step
+//   bit 4     OF after the step
+//   bit 5     a PC byte follows (the next PC is not PC + 1)
+//   bit 6     an input byte follows (value returned by input_external)
+//   bit 7     a halt byte follows (the step stopped the CPU)
+//
+// The instruction byte is memory[PC] and register values are functions of
+// the previous state, so they are not stored: the replayer recomputes them
+// and checks every tag, which stops it at the first step that diverges.
+// Straight-line code costs one byte per step, jumps and inputs two.
+// A full state checkpoint every TRACE_CHECKPOINT steps lets the replayer
+// seek to any step.
+
+#define TRACE_CHECKPOINT    (4096)
+
+#define TRACE_REG_MASK      (0x03)
+#define TRACE_REG_WRITE     (0x04)
+#define TRACE_ZF            (0x08)
+#define TRACE_OF            (0x10)
+#define TRACE_JUMP          (0x20)
+#define TRACE_INPUT         (0x40)
+#define TRACE_HALT          (0x80)
+
+typedef struct trace_checkpoint{
+    uint64_t step;          // steps executed before this state
+    uint64_t offset;        // position of that step in the stream
+    stCpu_state cpu;
+} stTrace_checkpoint;
+
+typedef struct cpu_trace{
+    uint8_t *data;          // tag stream
+    uint64_t length;
+    uint64_t capacity;
+    stTrace_checkpoint *checkpoint;
+    uint64_t checkpoints;
+    uint64_t checkpoint_capacity;
+    uint64_t steps;         // steps recorded
+    bool overflow;          // out of memory, recording stopped
+} stCpu_trace;
+
+typedef struct trace_replay{
+    const stCpu_trace *trace;
+    stCpu_state cpu;
+    uint64_t step;          // steps replayed
+    uint64_t offset;        // position in the stream
+} stTrace_replay;
+
+void trace_init(stCpu_trace *trace);
+void trace_free(stCpu_trace *trace);
+// Empty the trace for a new recording, keeping its buffers
+void trace_reset(stCpu_trace *trace);
+
+// Same as run_cpu, appending every step to the trace. The first call
+// records the start state as checkpoint 0.
+uint64_t run_cpu_recorded(stCpu_state *cpu, const stCpu_io *io, uint64_t max_steps,
+                          stCpu_trace *trace);
+
+// Save / load a trace as a binary file, return 0 on success
+int trace_write(const stCpu_trace *trace, FILE *f);
+int trace_read(stCpu_trace *trace, FILE *f);
+
+// Position the replayer after "step" steps of the trace, return 0 on
+// success, -1 if the step is past the end or the replay diverges
+int trace_seek(stTrace_replay *replay, const stCpu_trace *trace, uint64_t step);
+// Replay one step; io receives the output and the diagnostics, inputs come
+// from the trace. Return 1 after a step, 0 at the end of the trace, -1 if
+// the step does not match the recorded one.
+int trace_replay_step(stTrace_replay *replay, const stCpu_io *io);
+
+#endif // CPU_TRACE_H
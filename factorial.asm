@@ -0,0 +1,37 @@
+; r1 = N! (mod 256), the algorithm of load_factorial_program written
+; straight: N is kept in RAM[0x80], every factor is applied by repeated
+; addition.
+;
+;   ./cpu_host asm factorial.asm factorial.bin
+
+        in    r0
+        store r3            ; RAM[0x80] = N (r3 is 0)
+        set   1
+        mov   r0, r1        ; r1 = 1
+outer:
+        li    0x80
+        load  ram, r0       ; r0 = N
+        mov   r0, r3
+        cmp   r3
+        jz    end           ; N == 0: done
+        set   1
+        sub   r3, r0        ; r3 = N - 1 additions
+        mov   r1, r2        ; r2 = r1
+inner:
+        cmp   r3
+        jz    next
+        add   r1, r2        ; r1 += r2
+        set   1
+        sub   r3, r0
+        jmp   inner
+next:
+        li    0x80
+        load  ram, r0       ; r0 = N
+        mov   r0, r2
+        set   1
+        sub   r2, r0
+        mov   r2, r0        ; r0 = N - 1
+        store r3            ; RAM[0x80] = N - 1 (r3 is 0 again)
+        jmp   outer
+end:
+        out   r1
@@ -0,0 +1,14 @@
+; Regression case for li through the .scratch register: "li 35" expands to
+; five instructions that overwrite r1, so the optimizer must not keep the
+; second "mov r2, r1" as if r1 still held the input. Outputs the input.
+;
+;   ./cpu_host asm scratch.asm
+
+        .scratch r1
+        in    r2
+        mov   r2, r1        ; r1 = input
+        add   r3, r1
+        li    35            ; clobbers r1
+        store r3
+        mov   r2, r1        ; r1 = input again
+        out   r1
@@ -0,0 +1,503 @@
+#ifndef SOSEMANUK_HPP
+#define SOSEMANUK_HPP
+
+// Native C++ port of the Sosemanuk stream cipher (the Java SosemanukSlow in
+// "Sosemanuk"), producing the same stream byte for byte.
+//
+// The Java engine shifts all ten LFSR words on every step and outputs 16
+// bytes per makeStreamBlock call. Here one block is 20 steps (80 bytes)
+// unrolled at compile time: step K sees lfsr[i] in slot (i + K) % 10 of a
+// local array, so the LFSR rotates by renaming the slots instead of copying
+// them, and after 20 steps every word is back in its slot. The slot indices
+// are constants, so the compiler keeps the words in registers.
+//
+// Serpent24 (setKey / setIV) is written once over a generic word type W with
+// the bit operations, shifts and rotl, so the same rounds serve plain
+// 32-bit words and SIMD lanes. The mulAlpha / divAlpha tables are built at
+// compile time.
+//
+// Unlike the Java engine, the subkeys live apart from the running state: a
+// KeySchedule is set once per key and only read afterwards, and each Stream
+// is a small fixed-size object initialized from it by set_iv. Sosemanuk
+// pairs the two for callers that want the one-object interface.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace sosemanuk {
+
+inline std::uint32_t rotl(std::uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+inline std::uint32_t load_le32(const std::uint8_t *p) {
+    return std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]) << 16
+           | std::uint32_t(p[3]) << 24;
+}
+
+inline void store_le32(std::uint8_t *p, std::uint32_t x) {
+    p[0] = std::uint8_t(x);
+    p[1] = std::uint8_t(x >> 8);
+    p[2] = std::uint8_t(x >> 16);
+    p[3] = std::uint8_t(x >> 24);
+}
+
+// ---- multiplication and division by alpha in F_{2^32} ----
+
+struct AlphaTables {
+    std::uint32_t mul[256];     // x * alpha^4
+    std::uint32_t div[256];     // x / alpha
+};
+
+// Built from exponentials and logarithms relative to beta in F_{2^8}
+constexpr AlphaTables make_alpha_tables() {
+    AlphaTables t{};
+    std::uint32_t expb[256] = {};
+    std::uint32_t logb[256] = {};
+    for (std::uint32_t i = 0, x = 1; i < 0xFF; i++) {
+        expb[i] = x;
+        x <<= 1;
+        if (x > 0xFF) {
+            x ^= 0x1A9;
+        }
+    }
+    expb[0xFF] = 0;
+    for (std::uint32_t i = 0; i < 0x100; i++) {
+        logb[expb[i]] = i;
+    }
+    for (std::uint32_t x = 1; x < 0x100; x++) {
+        std::uint32_t ex = logb[x];
+        t.mul[x] = expb[(ex + 23) % 255] << 24 | expb[(ex + 245) % 255] << 16
+                   | expb[(ex + 48) % 255] << 8 | expb[(ex + 239) % 255];
+        t.div[x] = expb[(ex + 16) % 255] << 24 | expb[(ex + 39) % 255] << 16
+                   | expb[(ex + 6) % 255] << 8 | expb[(ex + 64) % 255];
+    }
+    return t;
+}
+
+inline constexpr AlphaTables alpha = make_alpha_tables();
+
+// ---- Serpent S-boxes (bitsliced: bit i of the four inputs is one nibble) ----
+//
+// Each S-box works in place on (r0, r1, r2, r3) with r4 as scratch and
+// leaves its output in the registers named in the comment.
+
+// S-box 0, output in (r1, r4, r2, r0)
+template <class W>
+inline void s0(W &r0, W &r1, W &r2, W &r3, W &r4) {
+    r3 ^= r0; r4 = r1; r1 &= r3; r4 ^= r2;
+    r1 ^= r0; r0 |= r3; r0 ^= r4; r4 ^= r3;
+    r3 ^= r2; r2 |= r1; r2 ^= r4; r4 = ~r4;
+    r4 |= r1; r1 ^= r3; r1 ^= r4; r3 |= r0;
+    r1 ^= r3; r4 ^= r3;
+}
+
+// S-box 1, output in (r2, r0, r3, r1)
+template <class W>
+inline void s1(W &r0, W &r1, W &r2, W &r3, W &r4) {
+    r0 = ~r0; r2 = ~r2; r4 = r0; r0 &= r1;
+    r2 ^= r0; r0 |= r3; r3 ^= r2; r1 ^= r0;
+    r0 ^= r4; r4 |= r1; r1 ^= r3; r2 |= r0;
+    r2 &= r4; r0 ^= r1; r1 &= r2; r1 ^= r0;
+    r0 &= r2; r0 ^= r4;
+}
+
+// S-box 2, output in (r2, r3, r1, r4)
+template <class W>
+inline void s2(W &r0, W &r1, W &r2, W &r3, W &r4) {
+    r4 = r0; r0 &= r2; r0 ^= r3; r2 ^= r1;
+    r2 ^= r0; r3 |= r4; r3 ^= r1; r4 ^= r2;
+    r1 = r3; r3 |= r4; r3 ^= r0; r0 &= r1;
+    r4 ^= r0; r1 ^= r3; r1 ^= r4; r4 = ~r4;
+}
+
+// S-box 3, output in (r1, r2, r3, r4)
+template <class W>
+inline void s3(W &r0, W &r1, W &r2, W &r3, W &r4) {
+    r4 = r0; r0 |= r3; r3 ^= r1; r1 &= r4;
+    r4 ^= r2; r2 ^= r3; r3 &= r0; r4 |= r1;
+    r3 ^= r4; r0 ^= r1; r4 &= r0; r1 ^= r3;
+    r4 ^= r2; r1 |= r0; r1 ^= r2; r0 ^= r3;
+    r2 = r1; r1 |= r3; r1 ^= r0;
+}
+
+// S-box 4, output in (r1, r4, r0, r3)
+template <class W>
+inline void s4(W &r0, W &r1, W &r2, W &r3, W &r4) {
+    r1 ^= r3; r3 = ~r3; r2 ^= r3; r3 ^= r0;
+    r4 = r1; r1 &= r3; r1 ^= r2; r4 ^= r3;
+    r0 ^= r4; r2 &= r4; r2 ^= r0; r0 &= r1;
+    r3 ^= r0; r4 |= r1; r4 ^= r0; r0 |= r3;
+    r0 ^= r2; r2 &= r3; r0 = ~r0; r4 ^= r2;
+}
+
+// S-box 5, output in (r1, r3, r0, r2)
+template <class W>
+inline void s5(W &r0, W &r1, W &r2, W &r3, W &r4) {
+    r0 ^= r1; r1 ^= r3; r3 = ~r3; r4 = r1;
+    r1 &= r0; r2 ^= r3; r1 ^= r2; r2 |= r4;
+    r4 ^= r3; r3 &= r1; r3 ^= r0; r4 ^= r1;
+    r4 ^= r2; r2 ^= r0; r0 &= r3; r2 = ~r2;
+    r0 ^= r4; r4 |= r3; r2 ^= r4;
+}
+
+// S-box 6, output in (r0, r1, r4, r2)
+template <class W>
+inline void s6(W &r0, W &r1, W &r2, W &r3, W &r4) {
+    r2 = ~r2; r4 = r3; r3 &= r0; r0 ^= r4;
+    r3 ^= r2; r2 |= r4; r1 ^= r3; r2 ^= r0;
+    r0 |= r1; r2 ^= r1; r4 ^= r0; r0 |= r3;
+    r0 ^= r2; r4 ^= r3; r4 ^= r0; r3 = ~r3;
+    r2 &= r4; r2 ^= r3;
+}
+
+// S-box 7, output in (r4, r3, r1, r0)
+template <class W>
+inline void s7(W &r0, W &r1, W &r2, W &r3, W &r4) {
+    r4 = r1; r1 |= r2; r1 ^= r3; r4 ^= r2;
+    r2 ^= r1; r3 |= r4; r3 &= r0; r4 ^= r2;
+    r3 ^= r1; r1 |= r4; r1 ^= r0; r0 |= r4;
+    r0 ^= r2; r1 ^= r4; r2 ^= r1; r1 &= r0;
+    r1 ^= r4; r2 = ~r2; r2 |= r0; r4 ^= r2;
+}
+
+// Serpent linear transformation
+template <class W>
+inline void transform(W &x0, W &x1, W &x2, W &x3) {
+    x0 = rotl(x0, 13);
+    x2 = rotl(x2, 3);
+    x1 = x1 ^ x0 ^ x2;
+    x3 = x3 ^ x2 ^ (x0 << 3);
+    x1 = rotl(x1, 1);
+    x3 = rotl(x3, 7);
+    x0 = x0 ^ x1 ^ x3;
+    x2 = x2 ^ x3 ^ (x1 << 7);
+    x0 = rotl(x0, 5);
+    x2 = rotl(x2, 22);
+}
+
+template <class W>
+inline void key_mix(const std::uint32_t *sk, W &x0, W &x1, W &x2, W &x3) {
+    x0 ^= sk[0];
+    x1 ^= sk[1];
+    x2 ^= sk[2];
+    x3 ^= sk[3];
+}
+
+// Serpent24 key schedule: 100 subkeys from a key of 1 to 32 bytes (shorter
+// keys are padded with 0x01 then zeros). Return false on a bad length.
+inline bool serpent24_key(std::uint32_t sk[100], const std::uint8_t *key, std::size_t len) {
+    // output registers of each S-box
+    static constexpr int out[8][4] = {
+        { 1, 4, 2, 0 }, { 2, 0, 3, 1 }, { 2, 3, 1, 4 }, { 1, 2, 3, 4 },
+        { 1, 4, 0, 3 }, { 1, 3, 0, 2 }, { 0, 1, 4, 2 }, { 4, 3, 1, 0 },
+    };
+    std::uint8_t lkey[32] = {};
+    std::uint32_t w[8];
+
+    if (len < 1 || len > 32) {
+        return false;
+    }
+    std::memcpy(lkey, key, len);
+    if (len < 32) {
+        lkey[len] = 0x01;
+    }
+    for (int i = 0; i < 8; i++) {
+        w[i] = load_le32(lkey + 4 * i);
+    }
+    // 25 groups of 4 prekeys w_i = (w_i-8 ^ w_i-5 ^ w_i-3 ^ w_i-1 ^ phi ^ i) <<< 11,
+    // each through S-box 3, 2, 1, 0, 7, 6, 5, 4, 3, ...
+    for (int g = 0; g < 25; g++) {
+        std::uint32_t r[5];
+        for (int j = 0; j < 4; j++) {
+            int i = 4 * g + j;
+            std::uint32_t t = w[i % 8] ^ w[(i + 3) % 8] ^ w[(i + 5) % 8] ^ w[(i + 7) % 8]
+                              ^ 0x9E3779B9u ^ std::uint32_t(i);
+            w[i % 8] = rotl(t, 11);
+            r[j] = w[i % 8];
+        }
+        int box = (35 - g) % 8;
+        switch (box) {
+        case 0: s0(r[0], r[1], r[2], r[3], r[4]); break;
+        case 1: s1(r[0], r[1], r[2], r[3], r[4]); break;
+        case 2: s2(r[0], r[1], r[2], r[3], r[4]); break;
+        case 3: s3(r[0], r[1], r[2], r[3], r[4]); break;
+        case 4: s4(r[0], r[1], r[2], r[3], r[4]); break;
+        case 5: s5(r[0], r[1], r[2], r[3], r[4]); break;
+        case 6: s6(r[0], r[1], r[2], r[3], r[4]); break;
+        case 7: s7(r[0], r[1], r[2], r[3], r[4]); break;
+        }
+        for (int j = 0; j < 4; j++) {
+            sk[4 * g + j] = r[out[box][j]];
+        }
+    }
+    return true;
+}
+
+// Serpent24 on the IV words (r0..r3). The outputs of rounds 12, 18 and 24
+// initialize the cipher state: lfsr[9..6] = (r3, r1, r0, r2) after round 12,
+// (fsm_r1, lfsr[4], fsm_r2, lfsr[5]) = (r2, r1, r3, r0) after round 18 and
+// lfsr[3..0] = (r0, r1, r2, r3) after the last key mix.
+template <class W>
+inline void serpent24_iv(const std::uint32_t sk[100], W &r0, W &r1, W &r2, W &r3,
+                         W lfsr[10], W &fsm_r1, W &fsm_r2) {
+    W r4;
+
+    key_mix(sk + 0, r0, r1, r2, r3);    s0(r0, r1, r2, r3, r4);    transform(r1, r4, r2, r0);
+    key_mix(sk + 4, r1, r4, r2, r0);    s1(r1, r4, r2, r0, r3);    transform(r2, r1, r0, r4);
+    key_mix(sk + 8, r2, r1, r0, r4);    s2(r2, r1, r0, r4, r3);    transform(r0, r4, r1, r3);
+    key_mix(sk + 12, r0, r4, r1, r3);   s3(r0, r4, r1, r3, r2);    transform(r4, r1, r3, r2);
+    key_mix(sk + 16, r4, r1, r3, r2);   s4(r4, r1, r3, r2, r0);    transform(r1, r0, r4, r2);
+    key_mix(sk + 20, r1, r0, r4, r2);   s5(r1, r0, r4, r2, r3);    transform(r0, r2, r1, r4);
+    key_mix(sk + 24, r0, r2, r1, r4);   s6(r0, r2, r1, r4, r3);    transform(r0, r2, r3, r1);
+    key_mix(sk + 28, r0, r2, r3, r1);   s7(r0, r2, r3, r1, r4);    transform(r4, r1, r2, r0);
+    key_mix(sk + 32, r4, r1, r2, r0);   s0(r4, r1, r2, r0, r3);    transform(r1, r3, r2, r4);
+    key_mix(sk + 36, r1, r3, r2, r4);   s1(r1, r3, r2, r4, r0);    transform(r2, r1, r4, r3);
+    key_mix(sk + 40, r2, r1, r4, r3);   s2(r2, r1, r4, r3, r0);    transform(r4, r3, r1, r0);
+    key_mix(sk + 44, r4, r3, r1, r0);   s3(r4, r3, r1, r0, r2);    transform(r3, r1, r0, r2);
+    lfsr[9] = r3;
+    lfsr[8] = r1;
+    lfsr[7] = r0;
+    lfsr[6] = r2;
+    key_mix(sk + 48, r3, r1, r0, r2);   s4(r3, r1, r0, r2, r4);    transform(r1, r4, r3, r2);
+    key_mix(sk + 52, r1, r4, r3, r2);   s5(r1, r4, r3, r2, r0);    transform(r4, r2, r1, r3);
+    key_mix(sk + 56, r4, r2, r1, r3);   s6(r4, r2, r1, r3, r0);    transform(r4, r2, r0, r1);
+    key_mix(sk + 60, r4, r2, r0, r1);   s7(r4, r2, r0, r1, r3);    transform(r3, r1, r2, r4);
+    key_mix(sk + 64, r3, r1, r2, r4);   s0(r3, r1, r2, r4, r0);    transform(r1, r0, r2, r3);
+    key_mix(sk + 68, r1, r0, r2, r3);   s1(r1, r0, r2, r3, r4);    transform(r2, r1, r3, r0);
+    fsm_r1 = r2;
+    lfsr[4] = r1;
+    fsm_r2 = r3;
+    lfsr[5] = r0;
+    key_mix(sk + 72, r2, r1, r3, r0);   s2(r2, r1, r3, r0, r4);    transform(r3, r0, r1, r4);
+    key_mix(sk + 76, r3, r0, r1, r4);   s3(r3, r0, r1, r4, r2);    transform(r0, r1, r4, r2);
+    key_mix(sk + 80, r0, r1, r4, r2);   s4(r0, r1, r4, r2, r3);    transform(r1, r3, r0, r2);
+    key_mix(sk + 84, r1, r3, r0, r2);   s5(r1, r3, r0, r2, r4);    transform(r3, r2, r1, r0);
+    key_mix(sk + 88, r3, r2, r1, r0);   s6(r3, r2, r1, r0, r4);    transform(r3, r2, r4, r1);
+    key_mix(sk + 92, r3, r2, r4, r1);   s7(r3, r2, r4, r1, r0);    transform(r0, r1, r2, r3);
+    key_mix(sk + 96, r0, r1, r2, r3);
+    lfsr[3] = r0;
+    lfsr[2] = r1;
+    lfsr[1] = r2;
+    lfsr[0] = r3;
+}
+
+// ---- keystream ----
+
+// s * alpha^4 term and s / alpha term of the LFSR feedback
+inline std::uint32_t mul_alpha(std::uint32_t s) {
+    return (s << 8) ^ alpha.mul[s >> 24];
+}
+
+inline std::uint32_t div_alpha(std::uint32_t s) {
+    return (s >> 8) ^ alpha.div[s & 0xFF];
+}
+
+// Step K of a block: update the FSM, compute f_t, drop s_t (returned in
+// "dropped") and put the new LFSR word in the slot s_t leaves
+template <int K, class W>
+inline void step(W (&s)[10], W &r1, W &r2, W &f, W &dropped) {
+    constexpr int s0 = K % 10, s1 = (K + 1) % 10, s3 = (K + 3) % 10;
+    constexpr int s8 = (K + 8) % 10, s9 = (K + 9) % 10;
+
+    W old = r1;
+    r1 = r2 + (s[s1] ^ (s[s8] & (W(0) - (old & 1))));
+    r2 = rotl(old * 0x54655307u, 7);
+    f = (s[s9] + r1) ^ r2;
+    dropped = s[s0];
+    s[s0] = s[s9] ^ div_alpha(s[s3]) ^ mul_alpha(s[s0]);
+}
+
+// Steps K..K+3 and the four output words (16 bytes) of them
+template <int K, class W>
+inline void quad(W (&s)[10], W &r1, W &r2, W *out) {
+    W f0, f1, f2, f3, f4, v0, v1, v2, v3;
+    step<K>(s, r1, r2, f0, v0);
+    step<K + 1>(s, r1, r2, f1, v1);
+    step<K + 2>(s, r1, r2, f2, v2);
+    step<K + 3>(s, r1, r2, f3, v3);
+    s2(f0, f1, f2, f3, f4);
+    out[0] = f2 ^ v0;
+    out[1] = f3 ^ v1;
+    out[2] = f1 ^ v2;
+    out[3] = f4 ^ v3;
+}
+
+// The 20 output words of one block
+template <class W>
+inline void block(W (&s)[10], W &r1, W &r2, W (&out)[20]) {
+    quad<0>(s, r1, r2, out);
+    quad<4>(s, r1, r2, out + 4);
+    quad<8>(s, r1, r2, out + 8);
+    quad<12>(s, r1, r2, out + 12);
+    quad<16>(s, r1, r2, out + 16);
+}
+
+// Serpent24 key schedule. Once set_key has returned it is only read, so one
+// schedule can be shared (as const) by any number of streams and threads.
+class KeySchedule {
+public:
+    // Key of 1 to 32 bytes, return false on a bad length
+    bool set_key(const std::uint8_t *key, std::size_t len) {
+        return serpent24_key(subkeys_, key, len);
+    }
+
+    const std::uint32_t *subkeys() const { return subkeys_; }
+
+private:
+    std::uint32_t subkeys_[100];
+};
+
+// State of one stream: LFSR, FSM and the unread bytes of the last block,
+// 132 bytes with no heap and no reference to the key, set up from a
+// KeySchedule by set_iv.
+class Stream {
+public:
+    static constexpr std::size_t block_size = 80;
+
+    // IV of 0 to 16 bytes (zero-padded), return false on a bad length
+    bool set_iv(const KeySchedule &key, const std::uint8_t *iv, std::size_t len) {
+        std::uint8_t piv[16] = {};
+        if (len > 16) {
+            return false;
+        }
+        if (len != 0) {
+            std::memcpy(piv, iv, len);
+        }
+        std::uint32_t r0 = load_le32(piv), r1 = load_le32(piv + 4);
+        std::uint32_t r2 = load_le32(piv + 8), r3 = load_le32(piv + 12);
+        serpent24_iv(key.subkeys(), r0, r1, r2, r3, lfsr_, fsm_r1_, fsm_r2_);
+        ptr_ = block_size;
+        return true;
+    }
+
+    // Write the next "len" stream bytes to "out"
+    void make_stream(std::uint8_t *out, std::size_t len) {
+        if (ptr_ < block_size) {
+            std::size_t n = block_size - ptr_ < len ? block_size - ptr_ : len;
+            std::memcpy(out, buf_ + ptr_, n);
+            ptr_ += std::uint32_t(n);
+            out += n;
+            len -= n;
+        }
+        while (len >= block_size) {
+            make_block(out);
+            out += block_size;
+            len -= block_size;
+        }
+        if (len != 0) {
+            make_block(buf_);
+            std::memcpy(out, buf_, len);
+            ptr_ = std::uint32_t(len);
+        }
+    }
+
+    // XOR the next "len" stream bytes with "in" into "out", which may be
+    // "in" itself. Mixes freely with make_stream: both read the same stream.
+    void xor_stream(const std::uint8_t *in, std::uint8_t *out, std::size_t len) {
+        if (ptr_ < block_size) {
+            std::size_t n = block_size - ptr_ < len ? block_size - ptr_ : len;
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = in[i] ^ buf_[ptr_ + i];
+            }
+            ptr_ += std::uint32_t(n);
+            in += n;
+            out += n;
+            len -= n;
+        }
+        while (len >= block_size) {
+            xor_block(in, out);
+            in += block_size;
+            out += block_size;
+            len -= block_size;
+        }
+        if (len != 0) {
+            make_block(buf_);
+            for (std::size_t i = 0; i < len; i++) {
+                out[i] = in[i] ^ buf_[i];
+            }
+            ptr_ = std::uint32_t(len);
+        }
+    }
+
+    // Encrypt or decrypt "len" bytes of "buf" in place
+    void xor_stream(std::uint8_t *buf, std::size_t len) {
+        xor_stream(buf, buf, len);
+    }
+
+private:
+    // 20 steps, 80 bytes. Private: it skips the unread bytes of buf_, so
+    // callers go through make_stream, which writes whole blocks in place.
+    void make_block(std::uint8_t *out) {
+        std::uint32_t words[20];
+        next_block(words);
+        for (int i = 0; i < 20; i++) {
+            store_le32(out + 4 * i, words[i]);
+        }
+    }
+
+    // 20 steps, XOR 80 bytes of "in" into "out" without storing the stream.
+    // Private for the same reason as make_block.
+    void xor_block(const std::uint8_t *in, std::uint8_t *out) {
+        std::uint32_t words[20];
+        next_block(words);
+        for (int i = 0; i < 20; i++) {
+            store_le32(out + 4 * i, load_le32(in + 4 * i) ^ words[i]);
+        }
+    }
+
+    void next_block(std::uint32_t (&words)[20]) {
+        std::uint32_t s[10];
+        std::uint32_t r1 = fsm_r1_, r2 = fsm_r2_;
+        std::memcpy(s, lfsr_, sizeof(s));
+        block(s, r1, r2, words);
+        std::memcpy(lfsr_, s, sizeof(s));
+        fsm_r1_ = r1;
+        fsm_r2_ = r2;
+    }
+
+    std::uint32_t lfsr_[10];
+    std::uint32_t fsm_r1_, fsm_r2_;
+    std::uint8_t buf_[block_size];          // unread bytes of the last block
+    std::uint32_t ptr_ = block_size;        // first unread byte of buf_
+};
+
+// Key schedule and one stream in one object, like the Java engine
+class Sosemanuk {
+public:
+    static constexpr std::size_t block_size = Stream::block_size;
+
+    // Key of 1 to 32 bytes, return false on a bad length
+    bool set_key(const std::uint8_t *key, std::size_t len) {
+        return key_.set_key(key, len);
+    }
+
+    // IV of 0 to 16 bytes (zero-padded), return false on a bad length
+    bool set_iv(const std::uint8_t *iv, std::size_t len) {
+        return stream_.set_iv(key_, iv, len);
+    }
+
+    // Write the next "len" stream bytes to "out"
+    void make_stream(std::uint8_t *out, std::size_t len) {
+        stream_.make_stream(out, len);
+    }
+
+    // XOR the next "len" stream bytes with "in" into "out" (may be "in")
+    void xor_stream(const std::uint8_t *in, std::uint8_t *out, std::size_t len) {
+        stream_.xor_stream(in, out, len);
+    }
+
+    // Encrypt or decrypt "len" bytes of "buf" in place
+    void xor_stream(std::uint8_t *buf, std::size_t len) {
+        stream_.xor_stream(buf, len);
+    }
+
+private:
+    KeySchedule key_;
+    Stream stream_;
+};
+
+} // namespace sosemanuk
+
+#endif // SOSEMANUK_HPP
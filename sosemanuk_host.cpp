@@ -0,0 +1,443 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "sosemanuk.hpp"
+#include "sosemanuk_lanes.hpp"
+
+// Host driver of the native Sosemanuk engine (sosemanuk.hpp)
+//
+// usage: sosemanuk_host [test]
+//        sosemanuk_host bench [megabytes]
+//        sosemanuk_host lanes [megabytes]
+//        sosemanuk_host iv [thousands]
+// "test" prints the stream of the test vector of the Java main() (key
+// A7 C0 83 FE B7, IV 00 11 .. FF), checks it against the expected bytes
+// and checks that make_stream gives the same stream for any split of the
+// requested lengths, that xor_stream (in place or not) XORs that stream,
+// and that streams sharing one KeySchedule match separate engines.
+// "bench" generates the stream in 80-byte blocks, then encrypts in place
+// with xor_stream, and reports the speed of each.
+// "lanes" checks every stream of the 4-lane (SSE4.1), 8-lane (AVX2) and
+// 16-lane (AVX-512) engines of sosemanuk_lanes.hpp against the scalar engine
+// with the same IV, then compares the total speed of 1, 4, 8 and 16 streams.
+// "iv" reports IV setups per second in batches of 1, 4, 8 and 16 IVs.
+//
+// Build: g++ -O2 -march=native -std=c++17 -fno-exceptions -o sosemanuk_host sosemanuk_host.cpp
+
+static const std::uint8_t test_key[] = { 0xA7, 0xC0, 0x83, 0xFE, 0xB7 };
+static const std::uint8_t test_iv[] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+};
+static const std::uint8_t test_stream[160] = {
+    0xFE, 0x81, 0xD2, 0x16, 0x2C, 0x9A, 0x10, 0x0D, 0x04, 0x89, 0x5C, 0x45, 0x4A, 0x77, 0x51, 0x5B,
+    0xBE, 0x6A, 0x43, 0x1A, 0x93, 0x5C, 0xB9, 0x0E, 0x22, 0x21, 0xEB, 0xB7, 0xEF, 0x50, 0x23, 0x28,
+    0x94, 0x35, 0x39, 0x49, 0x2E, 0xFF, 0x63, 0x10, 0xC8, 0x71, 0x05, 0x4C, 0x28, 0x89, 0xCC, 0x72,
+    0x8F, 0x82, 0xE8, 0x6B, 0x1A, 0xFF, 0xF4, 0x33, 0x4B, 0x61, 0x27, 0xA1, 0x3A, 0x15, 0x5C, 0x75,
+    0x15, 0x16, 0x30, 0xBD, 0x48, 0x2E, 0xB6, 0x73, 0xFF, 0x5D, 0xB4, 0x77, 0xFA, 0x6C, 0x53, 0xEB,
+    0xE1, 0xA4, 0xEC, 0x38, 0xC2, 0x3C, 0x54, 0x00, 0xC3, 0x15, 0x45, 0x5D, 0x93, 0xA2, 0xAC, 0xED,
+    0x95, 0x98, 0x60, 0x47, 0x27, 0xFA, 0x34, 0x0D, 0x5F, 0x2A, 0x8B, 0xD7, 0x57, 0xB7, 0x78, 0x33,
+    0xF7, 0x4B, 0xD2, 0xBC, 0x04, 0x93, 0x13, 0xC8, 0x06, 0x16, 0xB4, 0xA0, 0x62, 0x68, 0xAE, 0x35,
+    0x0D, 0xB9, 0x2E, 0xEC, 0x4F, 0xA5, 0x6C, 0x17, 0x13, 0x74, 0xA6, 0x7A, 0x80, 0xC0, 0x06, 0xD0,
+    0xEA, 0xD0, 0x48, 0xCE, 0x7B, 0x64, 0x0F, 0x17, 0xD3, 0xD5, 0xA6, 0x2D, 0x1F, 0x25, 0x1C, 0x21,
+};
+
+static double host_seconds() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+static std::uint64_t host_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static const sosemanuk::KeySchedule &shared_key() {
+    static sosemanuk::KeySchedule key;
+    static bool set = key.set_key(test_key, sizeof(test_key));
+    (void)set;
+    return key;
+}
+
+static bool new_engine(sosemanuk::Sosemanuk &engine) {
+    return engine.set_key(test_key, sizeof(test_key)) && engine.set_iv(test_iv, sizeof(test_iv));
+}
+
+// Print the test vector like the Java main(), then check it
+static int host_test() {
+    sosemanuk::Sosemanuk engine;
+    std::uint8_t stream[160];
+    int failures = 0;
+
+    new_engine(engine);
+    engine.make_stream(stream, sizeof(stream));
+    for (int i = 0; i < 10; i++) {
+        for (int j = 0; j < 16; j++) {
+            std::printf(" %02X", stream[i * 16 + j]);
+        }
+        std::printf("\n");
+    }
+    if (std::memcmp(stream, test_stream, sizeof(stream)) != 0) {
+        std::printf("test vector: MISMATCH\n");
+        failures++;
+    }
+
+    // the same 1000 bytes requested in pieces of every length from 1 to 200
+    std::vector<std::uint8_t> whole(1000), split(1000);
+    new_engine(engine);
+    engine.make_stream(whole.data(), whole.size());
+    for (std::size_t piece = 1; piece <= 200; piece++) {
+        new_engine(engine);
+        for (std::size_t pos = 0; pos < split.size(); pos += piece) {
+            engine.make_stream(split.data() + pos, std::min(piece, split.size() - pos));
+        }
+        if (split != whole) {
+            std::printf("pieces of %zu bytes: MISMATCH\n", piece);
+            failures++;
+        }
+    }
+
+    // xor_stream, in place and not, in pieces of every length from 1 to 200
+    // mixed with make_stream, against the data XOR the whole stream
+    std::vector<std::uint8_t> data(whole.size()), sealed(whole.size()), opened(whole.size());
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = std::uint8_t(i * 7 + 3);
+    }
+    new_engine(engine);
+    engine.make_stream(whole.data(), whole.size());
+    for (std::size_t piece = 1; piece <= 200; piece++) {
+        new_engine(engine);
+        for (std::size_t pos = 0, n = 0; pos < data.size(); pos += n) {
+            n = std::min(piece, data.size() - pos);
+            if ((pos / piece) % 3 == 2) {
+                engine.make_stream(sealed.data() + pos, n);
+                for (std::size_t i = pos; i < pos + n; i++) {
+                    sealed[i] ^= data[i];
+                }
+            } else {
+                engine.xor_stream(data.data() + pos, sealed.data() + pos, n);
+            }
+        }
+        opened = sealed;
+        new_engine(engine);
+        for (std::size_t pos = 0, n = 0; pos < opened.size(); pos += n) {
+            n = std::min(piece + 13, opened.size() - pos);
+            engine.xor_stream(opened.data() + pos, n);
+        }
+        bool ok = opened == data;
+        for (std::size_t i = 0; ok && i < data.size(); i++) {
+            ok = sealed[i] == (data[i] ^ whole[i]);
+        }
+        if (!ok) {
+            std::printf("xor_stream in pieces of %zu bytes: MISMATCH\n", piece);
+            failures++;
+        }
+    }
+
+    // 64 streams of one shared key, the IV differing in byte 15, advanced
+    // in turn by a few bytes each
+    const sosemanuk::KeySchedule &shared = shared_key();
+    sosemanuk::Stream streams[64];
+    std::vector<std::uint8_t> interleaved[64];
+    std::uint8_t iv[16];
+    std::memcpy(iv, test_iv, 16);
+    for (std::size_t i = 0; i < 64; i++) {
+        iv[15] = std::uint8_t(i);
+        streams[i].set_iv(shared, iv, 16);
+        interleaved[i].resize(whole.size());
+    }
+    for (std::size_t pos = 0, piece = 1; pos < whole.size(); pos += piece, piece = piece % 97 + 1) {
+        piece = std::min(piece, whole.size() - pos);
+        for (std::size_t i = 0; i < 64; i++) {
+            streams[i].make_stream(interleaved[i].data() + pos, piece);
+        }
+    }
+    for (std::size_t i = 0; i < 64; i++) {
+        iv[15] = std::uint8_t(i);
+        engine.set_key(test_key, sizeof(test_key));
+        engine.set_iv(iv, 16);
+        engine.make_stream(whole.data(), whole.size());
+        if (interleaved[i] != whole) {
+            std::printf("stream %zu of a shared key: MISMATCH\n", i);
+            failures++;
+        }
+    }
+    std::printf("%s\n", failures == 0 ? "test vector, split requests, xor_stream and shared key: ok" : "FAILED");
+    return failures != 0;
+}
+
+static int host_bench(std::size_t megabytes) {
+    sosemanuk::Sosemanuk engine;
+    std::uint8_t block[16 * sosemanuk::Sosemanuk::block_size];
+    std::uint64_t blocks = (std::uint64_t)megabytes * 1000000 / sizeof(block);
+    unsigned checksum = 0;
+
+    new_engine(engine);
+    double start = host_seconds();
+    std::uint64_t cycles = host_cycles();
+    for (std::uint64_t i = 0; i < blocks; i++) {
+        engine.make_stream(block, sizeof(block));
+        checksum += block[i % sizeof(block)];
+    }
+    cycles = host_cycles() - cycles;
+    double elapsed = host_seconds() - start;
+    double bytes = double(blocks) * sizeof(block);
+    std::printf("keystream: %.0f MB in %.3f s, %.1f MB/s, %.2f cycles/byte (checksum %u)\n",
+                bytes / 1e6, elapsed, bytes / elapsed / 1e6, cycles / bytes, checksum);
+
+    // the same amount of data encrypted in place, 4 KB at a time
+    std::vector<std::uint8_t> data(4096);
+    std::uint64_t chunks = (std::uint64_t)megabytes * 1000000 / data.size();
+    new_engine(engine);
+    start = host_seconds();
+    cycles = host_cycles();
+    for (std::uint64_t i = 0; i < chunks; i++) {
+        engine.xor_stream(data.data(), data.size());
+        checksum += data[i % data.size()];
+    }
+    cycles = host_cycles() - cycles;
+    elapsed = host_seconds() - start;
+    bytes = double(chunks) * data.size();
+    std::printf("xor_stream in place: %.0f MB in %.3f s, %.1f MB/s, %.2f cycles/byte (checksum %u)\n",
+                bytes / 1e6, elapsed, bytes / elapsed / 1e6, cycles / bytes, checksum);
+    return 0;
+}
+
+// Lane i of the engine gets the test IV with byte 15 replaced by i
+template <class V>
+static int host_lanes_check(const char *name) {
+    constexpr std::size_t lanes = V::lanes;
+    sosemanuk::KeySchedule key;
+    sosemanuk::Lanes<V> wide;
+    sosemanuk::Sosemanuk engine;
+    std::uint8_t ivs[lanes][16];
+    const std::uint8_t *iv[lanes];
+    std::vector<std::uint8_t> stream[lanes], expected(1000);
+    std::uint8_t *out[lanes];
+    int failures = 0;
+
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        std::memcpy(ivs[lane], test_iv, 16);
+        ivs[lane][15] = std::uint8_t(lane);
+        iv[lane] = ivs[lane];
+        stream[lane].resize(expected.size());
+    }
+    key.set_key(test_key, sizeof(test_key));
+    // the 1000 bytes requested in pieces of 1, 2, .. bytes
+    wide.set_iv(key, iv, 16);
+    for (std::size_t pos = 0, piece = 1; pos < expected.size(); pos += piece, piece++) {
+        piece = std::min(piece, expected.size() - pos);
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            out[lane] = stream[lane].data() + pos;
+        }
+        wide.make_stream(out, piece);
+    }
+
+    // make_blocks only at a block boundary: block 0, then 10 bytes of
+    // block 1 that leave it refusing until the other 70 are read, block 2
+    static std::uint8_t first[lanes * 80], third[lanes * 80], skipped[lanes][80];
+    sosemanuk::Lanes<V> aligned;
+    aligned.set_iv(key, iv, 16);
+    bool refused = false;
+    if (aligned.make_blocks(first)) {
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            out[lane] = skipped[lane];
+        }
+        aligned.make_stream(out, 10);
+        refused = !aligned.make_blocks(third);
+        aligned.make_stream(out, 70);
+    }
+    if (!refused || !aligned.make_blocks(third)) {
+        std::printf("%s make_blocks: not refused inside a block\n", name);
+        failures++;
+    }
+
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        engine.set_key(test_key, sizeof(test_key));
+        engine.set_iv(ivs[lane], 16);
+        engine.make_stream(expected.data(), expected.size());
+        if (stream[lane] != expected) {
+            std::printf("%s lane %zu: MISMATCH\n", name, lane);
+            failures++;
+        }
+        if (std::memcmp(first + 80 * lane, expected.data(), 80) != 0
+            || std::memcmp(third + 80 * lane, expected.data() + 160, 80) != 0) {
+            std::printf("%s lane %zu: make_blocks MISMATCH\n", name, lane);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+template <class V>
+static void host_lanes_bench(const char *name, std::size_t megabytes) {
+    constexpr std::size_t lanes = V::lanes;
+    sosemanuk::KeySchedule key;
+    sosemanuk::Lanes<V> wide;
+    std::uint8_t ivs[lanes][16];
+    const std::uint8_t *iv[lanes];
+    alignas(64) std::uint8_t blocks[lanes * sosemanuk::Sosemanuk::block_size];
+    std::uint64_t rounds = (std::uint64_t)megabytes * 1000000 / sizeof(blocks);
+    unsigned checksum = 0;
+
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        std::memcpy(ivs[lane], test_iv, 16);
+        ivs[lane][15] = std::uint8_t(lane);
+        iv[lane] = ivs[lane];
+    }
+    key.set_key(test_key, sizeof(test_key));
+    wide.set_iv(key, iv, 16);
+    double start = host_seconds();
+    std::uint64_t cycles = host_cycles();
+    for (std::uint64_t i = 0; i < rounds; i++) {
+        if (!wide.make_blocks(blocks)) {
+            return;
+        }
+        checksum += blocks[i % sizeof(blocks)];
+    }
+    cycles = host_cycles() - cycles;
+    double elapsed = host_seconds() - start;
+    double bytes = double(rounds) * sizeof(blocks);
+    std::printf("%-8s %2zu streams: %.0f MB in %.3f s, %.1f MB/s, %.2f cycles/byte (checksum %u)\n",
+                name, lanes, bytes / 1e6, elapsed, bytes / elapsed / 1e6, cycles / bytes, checksum);
+}
+
+static int host_lanes(std::size_t megabytes) {
+    int failures = 0;
+#if defined(__SSE4_1__)
+    failures += host_lanes_check<sosemanuk::Sse>("sse");
+#endif
+#if defined(__AVX2__)
+    failures += host_lanes_check<sosemanuk::Avx2>("avx2");
+#endif
+#if defined(__AVX512F__)
+    failures += host_lanes_check<sosemanuk::Avx512>("avx512");
+#endif
+    std::printf("%s\n", failures == 0 ? "lanes match the scalar engine: ok" : "FAILED");
+    if (failures != 0) {
+        return 1;
+    }
+    host_bench(megabytes);
+#if defined(__SSE4_1__)
+    host_lanes_bench<sosemanuk::Sse>("sse", megabytes);
+#else
+    std::printf("sse: not compiled in (build with -msse4.1 or -march=native)\n");
+#endif
+#if defined(__AVX2__)
+    host_lanes_bench<sosemanuk::Avx2>("avx2", megabytes);
+#else
+    std::printf("avx2: not compiled in (build with -mavx2 or -march=native)\n");
+#endif
+#if defined(__AVX512F__)
+    host_lanes_bench<sosemanuk::Avx512>("avx512", megabytes);
+#else
+    std::printf("avx512: not compiled in (build with -mavx512f or -march=native)\n");
+#endif
+    return 0;
+}
+
+static void host_iv_report(const char *name, std::size_t batch, std::uint64_t ivs, double elapsed,
+                           std::uint64_t cycles, unsigned checksum) {
+    std::printf("%-8s batch %2zu: %llu IVs in %.3f s, %.0f IV setups/s, %.0f cycles/IV (checksum %u)\n",
+                name, batch, (unsigned long long)ivs, elapsed, ivs / elapsed, double(cycles) / ivs,
+                checksum);
+}
+
+// Set "thousands" * 1000 IVs one at a time, each followed by one block
+static void host_iv_scalar(std::size_t thousands) {
+    sosemanuk::KeySchedule key;
+    sosemanuk::Stream stream;
+    std::uint8_t iv[16], block[sosemanuk::Stream::block_size];
+    std::uint64_t ivs = (std::uint64_t)thousands * 1000;
+    unsigned checksum = 0;
+
+    std::memcpy(iv, test_iv, 16);
+    key.set_key(test_key, sizeof(test_key));
+    double start = host_seconds();
+    std::uint64_t cycles = host_cycles();
+    for (std::uint64_t i = 0; i < ivs; i++) {
+        iv[15] = std::uint8_t(i);
+        stream.set_iv(key, iv, 16);
+        stream.make_stream(block, 1);
+        checksum += block[0];
+    }
+    cycles = host_cycles() - cycles;
+    host_iv_report("scalar", 1, ivs, host_seconds() - start, cycles, checksum);
+}
+
+template <class V>
+static void host_iv_lanes(const char *name, std::size_t thousands) {
+    constexpr std::size_t lanes = V::lanes;
+    sosemanuk::KeySchedule key;
+    sosemanuk::Lanes<V> wide;
+    std::uint8_t ivs[lanes][16];
+    const std::uint8_t *iv[lanes];
+    std::uint8_t block[lanes];
+    std::uint8_t *out[lanes];
+    std::uint64_t batches = ((std::uint64_t)thousands * 1000 + lanes - 1) / lanes;
+    unsigned checksum = 0;
+
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        std::memcpy(ivs[lane], test_iv, 16);
+        ivs[lane][14] = std::uint8_t(lane);
+        iv[lane] = ivs[lane];
+        out[lane] = block + lane;
+    }
+    key.set_key(test_key, sizeof(test_key));
+    double start = host_seconds();
+    std::uint64_t cycles = host_cycles();
+    for (std::uint64_t i = 0; i < batches; i++) {
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            ivs[lane][15] = std::uint8_t(i);
+        }
+        wide.set_iv(key, iv, 16);
+        wide.make_stream(out, 1);
+        checksum += block[i % lanes];
+    }
+    cycles = host_cycles() - cycles;
+    host_iv_report(name, lanes, batches * lanes, host_seconds() - start, cycles, checksum);
+}
+
+// IV setup speed; every setup is followed by one byte of stream so that
+// the last step of set_iv is not left out
+static int host_iv(std::size_t thousands) {
+    host_iv_scalar(thousands);
+#if defined(__SSE4_1__)
+    host_iv_lanes<sosemanuk::Sse>("sse", thousands);
+#endif
+#if defined(__AVX2__)
+    host_iv_lanes<sosemanuk::Avx2>("avx2", thousands);
+#endif
+#if defined(__AVX512F__)
+    host_iv_lanes<sosemanuk::Avx512>("avx512", thousands);
+#endif
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && std::strcmp(argv[1], "bench") == 0) {
+        return host_bench((argc >= 3) ? std::strtoul(argv[2], nullptr, 10) : 256);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "lanes") == 0) {
+        return host_lanes((argc >= 3) ? std::strtoul(argv[2], nullptr, 10) : 256);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "iv") == 0) {
+        return host_iv((argc >= 3) ? std::strtoul(argv[2], nullptr, 10) : 1000);
+    }
+    if (argc < 2 || std::strcmp(argv[1], "test") == 0) {
+        return host_test();
+    }
+    std::fprintf(stderr, "usage: %s [test]\n"
+                         "       %s bench [megabytes]\n"
+                         "       %s lanes [megabytes]\n"
+                         "       %s iv [thousands]\n", argv[0], argv[0], argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,304 @@
+#ifndef SOSEMANUK_LANES_HPP
+#define SOSEMANUK_LANES_HPP
+
+// Multi-lane Sosemanuk: 4 (SSE4.1), 8 (AVX2) or 16 (AVX-512) independent
+// streams under one key, each with its own IV, one per 32-bit SIMD lane.
+//
+// The state is kept transposed: lfsr[i], fsm_r1 and fsm_r2 are vectors
+// holding that word of every stream, so the scalar rounds of sosemanuk.hpp
+// (Serpent24 for the IV, the FSM / LFSR steps, S-box 2 of the output) run
+// unchanged on the vector word types below. mul_alpha / div_alpha become
+// gathers from the same tables. Only the output is transposed back, so
+// that every stream gets its 80 bytes per block contiguously.
+//
+// Serpent24 is bitsliced within each 32-bit word already, so set_iv runs
+// the 24 rounds of all the IVs with the same instruction count as one IV:
+// for short messages, where a new IV is set every block or two, this is
+// where most of the time goes.
+
+#include <immintrin.h>
+#include "sosemanuk.hpp"
+
+namespace sosemanuk {
+
+#if defined(__SSE4_1__)
+
+// 4 lanes of 32 bits
+struct Sse {
+    static constexpr std::size_t lanes = 4;
+    __m128i v;
+
+    Sse() = default;
+    Sse(__m128i x) : v(x) {}
+    explicit Sse(std::uint32_t x) : v(_mm_set1_epi32(int(x))) {}
+
+    static Sse load(const std::uint32_t *p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+    void store(std::uint32_t *p) const {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+    }
+
+    Sse &operator^=(Sse x) { v = _mm_xor_si128(v, x.v); return *this; }
+    Sse &operator&=(Sse x) { v = _mm_and_si128(v, x.v); return *this; }
+    Sse &operator|=(Sse x) { v = _mm_or_si128(v, x.v); return *this; }
+    Sse &operator^=(std::uint32_t x) { return *this ^= Sse(x); }
+};
+
+inline Sse operator^(Sse a, Sse b) { return _mm_xor_si128(a.v, b.v); }
+inline Sse operator&(Sse a, Sse b) { return _mm_and_si128(a.v, b.v); }
+inline Sse operator|(Sse a, Sse b) { return _mm_or_si128(a.v, b.v); }
+inline Sse operator~(Sse a) { return _mm_xor_si128(a.v, _mm_set1_epi32(-1)); }
+inline Sse operator+(Sse a, Sse b) { return _mm_add_epi32(a.v, b.v); }
+inline Sse operator-(Sse a, Sse b) { return _mm_sub_epi32(a.v, b.v); }
+inline Sse operator&(Sse a, std::uint32_t b) { return a & Sse(b); }
+inline Sse operator*(Sse a, std::uint32_t b) { return _mm_mullo_epi32(a.v, Sse(b).v); }
+inline Sse operator<<(Sse a, int n) { return _mm_slli_epi32(a.v, n); }
+inline Sse operator>>(Sse a, int n) { return _mm_srli_epi32(a.v, n); }
+
+inline Sse rotl(Sse a, int n) {
+#if defined(__AVX512VL__)
+    return _mm_maskz_rolv_epi32(0xF, a.v, _mm_set1_epi32(n));
+#else
+    return (a << n) | (a >> (32 - n));
+#endif
+}
+
+// Without AVX2 there is no gather: four scalar loads
+inline Sse gather(const std::uint32_t *table, Sse index) {
+#if defined(__AVX2__)
+    return _mm_i32gather_epi32(reinterpret_cast<const int *>(table), index.v, 4);
+#else
+    return _mm_setr_epi32(int(table[_mm_cvtsi128_si32(index.v)]),
+                          int(table[_mm_extract_epi32(index.v, 1)]),
+                          int(table[_mm_extract_epi32(index.v, 2)]),
+                          int(table[_mm_extract_epi32(index.v, 3)]));
+#endif
+}
+
+inline Sse mul_alpha(Sse s) {
+    return (s << 8) ^ gather(alpha.mul, s >> 24);
+}
+
+inline Sse div_alpha(Sse s) {
+    return (s >> 8) ^ gather(alpha.div, s & 0xFF);
+}
+
+#endif // __SSE4_1__
+
+#if defined(__AVX2__)
+
+// 8 lanes of 32 bits
+struct Avx2 {
+    static constexpr std::size_t lanes = 8;
+    __m256i v;
+
+    Avx2() = default;
+    Avx2(__m256i x) : v(x) {}
+    explicit Avx2(std::uint32_t x) : v(_mm256_set1_epi32(int(x))) {}
+
+    static Avx2 load(const std::uint32_t *p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    void store(std::uint32_t *p) const {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+
+    Avx2 &operator^=(Avx2 x) { v = _mm256_xor_si256(v, x.v); return *this; }
+    Avx2 &operator&=(Avx2 x) { v = _mm256_and_si256(v, x.v); return *this; }
+    Avx2 &operator|=(Avx2 x) { v = _mm256_or_si256(v, x.v); return *this; }
+    Avx2 &operator^=(std::uint32_t x) { return *this ^= Avx2(x); }
+};
+
+inline Avx2 operator^(Avx2 a, Avx2 b) { return _mm256_xor_si256(a.v, b.v); }
+inline Avx2 operator&(Avx2 a, Avx2 b) { return _mm256_and_si256(a.v, b.v); }
+inline Avx2 operator|(Avx2 a, Avx2 b) { return _mm256_or_si256(a.v, b.v); }
+inline Avx2 operator~(Avx2 a) { return _mm256_xor_si256(a.v, _mm256_set1_epi32(-1)); }
+inline Avx2 operator+(Avx2 a, Avx2 b) { return _mm256_add_epi32(a.v, b.v); }
+inline Avx2 operator-(Avx2 a, Avx2 b) { return _mm256_sub_epi32(a.v, b.v); }
+inline Avx2 operator&(Avx2 a, std::uint32_t b) { return a & Avx2(b); }
+inline Avx2 operator*(Avx2 a, std::uint32_t b) { return _mm256_mullo_epi32(a.v, Avx2(b).v); }
+inline Avx2 operator<<(Avx2 a, int n) { return _mm256_slli_epi32(a.v, n); }
+inline Avx2 operator>>(Avx2 a, int n) { return _mm256_srli_epi32(a.v, n); }
+
+inline Avx2 rotl(Avx2 a, int n) {
+#if defined(__AVX512VL__)
+    return _mm256_maskz_rolv_epi32(0xFF, a.v, _mm256_set1_epi32(n));
+#else
+    return (a << n) | (a >> (32 - n));
+#endif
+}
+
+inline Avx2 gather(const std::uint32_t *table, Avx2 index) {
+    return _mm256_i32gather_epi32(reinterpret_cast<const int *>(table), index.v, 4);
+}
+
+inline Avx2 mul_alpha(Avx2 s) {
+    return (s << 8) ^ gather(alpha.mul, s >> 24);
+}
+
+inline Avx2 div_alpha(Avx2 s) {
+    return (s >> 8) ^ gather(alpha.div, s & 0xFF);
+}
+
+#endif // __AVX2__
+
+#if defined(__AVX512F__)
+
+// 16 lanes of 32 bits. Shifts, rotations and gathers use the masked forms
+// with all lanes set: the plain intrinsics of GCC 12 start from an
+// undefined vector and warn about it with -Wall.
+struct Avx512 {
+    static constexpr std::size_t lanes = 16;
+    __m512i v;
+
+    Avx512() = default;
+    Avx512(__m512i x) : v(x) {}
+    explicit Avx512(std::uint32_t x) : v(_mm512_set1_epi32(int(x))) {}
+
+    static Avx512 load(const std::uint32_t *p) {
+        return _mm512_loadu_si512(p);
+    }
+    void store(std::uint32_t *p) const {
+        _mm512_storeu_si512(p, v);
+    }
+
+    Avx512 &operator^=(Avx512 x) { v = _mm512_xor_si512(v, x.v); return *this; }
+    Avx512 &operator&=(Avx512 x) { v = _mm512_and_si512(v, x.v); return *this; }
+    Avx512 &operator|=(Avx512 x) { v = _mm512_or_si512(v, x.v); return *this; }
+    Avx512 &operator^=(std::uint32_t x) { return *this ^= Avx512(x); }
+};
+
+inline Avx512 operator^(Avx512 a, Avx512 b) { return _mm512_xor_si512(a.v, b.v); }
+inline Avx512 operator&(Avx512 a, Avx512 b) { return _mm512_and_si512(a.v, b.v); }
+inline Avx512 operator|(Avx512 a, Avx512 b) { return _mm512_or_si512(a.v, b.v); }
+inline Avx512 operator~(Avx512 a) { return _mm512_ternarylogic_epi32(a.v, a.v, a.v, 0x55); }
+inline Avx512 operator+(Avx512 a, Avx512 b) { return _mm512_add_epi32(a.v, b.v); }
+inline Avx512 operator-(Avx512 a, Avx512 b) { return _mm512_sub_epi32(a.v, b.v); }
+inline Avx512 operator&(Avx512 a, std::uint32_t b) { return a & Avx512(b); }
+inline Avx512 operator*(Avx512 a, std::uint32_t b) { return _mm512_mullo_epi32(a.v, Avx512(b).v); }
+inline Avx512 operator<<(Avx512 a, int n) { return _mm512_maskz_slli_epi32(0xFFFF, a.v, unsigned(n)); }
+inline Avx512 operator>>(Avx512 a, int n) { return _mm512_maskz_srli_epi32(0xFFFF, a.v, unsigned(n)); }
+
+inline Avx512 rotl(Avx512 a, int n) {
+    return _mm512_maskz_rolv_epi32(0xFFFF, a.v, _mm512_set1_epi32(n));
+}
+
+inline Avx512 gather(const std::uint32_t *table, Avx512 index) {
+    return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, index.v, table, 4);
+}
+
+inline Avx512 mul_alpha(Avx512 s) {
+    return (s << 8) ^ gather(alpha.mul, s >> 24);
+}
+
+inline Avx512 div_alpha(Avx512 s) {
+    return (s >> 8) ^ gather(alpha.div, s & 0xFF);
+}
+
+#endif // __AVX512F__
+
+// State of V::lanes streams under one KeySchedule, set up by set_iv
+template <class V>
+class Lanes {
+public:
+    static constexpr std::size_t lanes = V::lanes;
+    static constexpr std::size_t block_size = 80;      // per stream
+
+    // One IV of "len" bytes (0 to 16) per lane, return false on a bad length
+    bool set_iv(const KeySchedule &key, const std::uint8_t *const iv[], std::size_t len) {
+        alignas(64) std::uint32_t words[4][lanes];
+        if (len > 16) {
+            return false;
+        }
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            std::uint8_t piv[16] = {};
+            if (len != 0) {
+                std::memcpy(piv, iv[lane], len);
+            }
+            for (int j = 0; j < 4; j++) {
+                words[j][lane] = load_le32(piv + 4 * j);
+            }
+        }
+        V r0 = V::load(words[0]), r1 = V::load(words[1]);
+        V r2 = V::load(words[2]), r3 = V::load(words[3]);
+        serpent24_iv(key.subkeys(), r0, r1, r2, r3, lfsr_, fsm_r1_, fsm_r2_);
+        ptr_ = block_size;
+        return true;
+    }
+
+    // Write the next "len" bytes of every stream to out[lane]
+    void make_stream(std::uint8_t *const out[], std::size_t len) {
+        std::size_t pos = 0;
+        if (ptr_ < block_size) {
+            std::size_t n = block_size - ptr_ < len ? block_size - ptr_ : len;
+            for (std::size_t lane = 0; lane < lanes; lane++) {
+                std::memcpy(out[lane], buf_ + lane * block_size + ptr_, n);
+            }
+            ptr_ += n;
+            pos = n;
+        }
+        while (len - pos >= block_size) {
+            next_blocks(buf_);
+            for (std::size_t lane = 0; lane < lanes; lane++) {
+                std::memcpy(out[lane] + pos, buf_ + lane * block_size, block_size);
+            }
+            pos += block_size;
+        }
+        if (pos < len) {
+            next_blocks(buf_);
+            for (std::size_t lane = 0; lane < lanes; lane++) {
+                std::memcpy(out[lane] + pos, buf_ + lane * block_size, len - pos);
+            }
+            ptr_ = len - pos;
+        }
+    }
+
+    // Block-aligned entry point for callers that only take whole blocks:
+    // the next block of every stream, lanes * 80 bytes with stream i at
+    // out + 80 * i. Return false and write nothing when a partial
+    // make_stream left unread bytes, which must be read first.
+    bool make_blocks(std::uint8_t *out) {
+        if (ptr_ != block_size) {
+            return false;
+        }
+        next_blocks(out);
+        return true;
+    }
+
+private:
+    // 20 steps of every stream, transposed to lanes * 80 bytes at "out"
+    void next_blocks(std::uint8_t *out) {
+        V s[10];
+        V words[20];
+        alignas(64) std::uint32_t lane_words[20][lanes];
+        V r1 = fsm_r1_, r2 = fsm_r2_;
+        for (int i = 0; i < 10; i++) {
+            s[i] = lfsr_[i];
+        }
+        block(s, r1, r2, words);
+        for (int i = 0; i < 10; i++) {
+            lfsr_[i] = s[i];
+        }
+        fsm_r1_ = r1;
+        fsm_r2_ = r2;
+
+        for (int i = 0; i < 20; i++) {
+            words[i].store(lane_words[i]);
+        }
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            for (int i = 0; i < 20; i++) {
+                store_le32(out + lane * block_size + 4 * i, lane_words[i][lane]);
+            }
+        }
+    }
+
+    V lfsr_[10];
+    V fsm_r1_, fsm_r2_;
+    std::uint8_t buf_[lanes * block_size];  // unread bytes of the last blocks
+    std::size_t ptr_ = block_size;          // first unread byte of each stream
+};
+
+} // namespace sosemanuk
+
+#endif // SOSEMANUK_LANES_HPP